@@ -7,9 +7,19 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/transform.h>
+#include <learnopengl/score_zones.h>
+#include <learnopengl/scene_bvh.h>
+#include <learnopengl/target_grid.h>
+#include <learnopengl/state_history.h>
+#include <learnopengl/query_worker.h>
+#include <learnopengl/penetration.h>
+#include <learnopengl/id_picker.h>
+#include <learnopengl/thread_pool.h>
 #include <iostream>
 #include <vector>
 #include <random>
+#include <memory>
 
 #define STB_IMAGE_IMPLEMENTATION 
 #include <learnopengl/stb_image.h>
@@ -20,6 +30,7 @@ using namespace std;
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void processInput(GLFWwindow* window);
 
 unsigned int loadTexture(const char* path);
@@ -27,19 +38,31 @@ void drawM4(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& m4);
 void drawDeagle(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& deagle);
 void drawBayonet(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& bayonet);
 void drawReticle(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& reticle2d);
-void drawLogo(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& logo);
-void drawSkybox(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& skybox);
 void drawShootDeagle(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& shootD);
 void drawShootM4(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& shootM);
-void drawField(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& field);
-void drawLamp1(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& lamp1);
-void drawLamp2(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& lamp2);
-
-void shootRayFromCamera(Camera& camera, Model& target, glm::mat4& targetModelMatrix);
-bool intersectRayTriangle(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t);
-bool intersectsTargetRayTriangle(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const Model& model);
-void checkRayIntersection(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::mat4& targetModelMatrix, const Model& target);
-void repositionTarget(glm::mat4& modelMatrix, const glm::vec3& currentPosition);
+void drawWorld(Shader& shader);
+
+void initSceneTransforms();
+void setModelTransform(Shader& shader, unsigned int transformId);
+
+void shootRayFromCamera(Camera& camera, double time);
+int buildShotRays(Camera& camera, Ray* rays, int pellets, float spreadDegrees);
+float intersectTargetAt(const Model& target, const glm::mat4& world, const Ray& ray, float radius, float tMax, HitRecord& hit);
+float intersectTarget(const Model& target, const ObjectTransform& transform, const Ray& ray, float radius, float tMax, HitRecord& hit);
+void repositionTarget(unsigned int targetIndex, const glm::vec3& currentPosition, double time);
+void moveTargets(double time, float dt);
+void recordTargetMove(unsigned int targetIndex, const glm::mat4& world, const AABB& bounds, double from, double time, bool jump);
+void processClicks();
+bool pickFromCamera(Camera& camera, double time);
+void applyPickResults();
+void publishTargetMoves();
+bool flushTargetMoves();
+void applyShotResults();
+void recordCameraState(double time);
+Camera cameraAt(double time);
+void startEventClock();
+double eventTime();
+void loadTargetZones(const Model& target);
 
 // Settings FHD
 const unsigned int SCR_WIDTH = 1920; 
@@ -69,8 +92,157 @@ bool isShooting = false; // Estado del disparo
 float shootTime = 0.0f; // Tiempo desde que se disparó
 float shootDuration = 0.1f; // Duración visible del disparo
 
+// Dispersión del disparo: perdigones por disparo, cono base y apertura por retroceso (bloom), en grados. Cada arma
+// fija los suyos al elegirla en processInput; la bayoneta, el arma inicial, no se dispersa
+const int MAX_PELLETS = 64;
+int shotPellets = 1;
+float shotSpread = 0.0f;
+float bloomPerShot = 0.0f;
+float bloomMax = 5.0f;
+float bloomRecovery = 4.0f; // grados por segundo
+float currentBloom = 0.0f;
+
+// Poder de penetración del arma actual: se gasta en cada superficie que atraviesa la bala (ver penetration.h)
+float shotPenetration = 0.0f;
+
+// Modo de entrenamiento con asistencia de apuntado (tecla T): el disparo es una esfera de este radio barrida a lo
+// largo del rayo, así que cuenta como impacto en el blanco todo lo que pase a menos de AIM_ASSIST_RADIUS de él
+const float AIM_ASSIST_RADIUS = 0.15f;
+float aimAssistRadius = 0.0f;
+
+// Proxy de colisión del blanco (una caja, esfera, cápsula o disco ajustado al cargar): se prueba antes que la malla
+// y solo si el disparo lo alcanza se busca el impacto exacto, que da las coordenadas de textura del puntaje. Su
+// superficie se aleja de la malla a lo sumo esta fracción de la diagonal del modelo.
+const float PROXY_MAX_ERROR = 0.02f;
+
+// Transformaciones de los objetos: matriz de mundo, inversa y matriz normal (se recalculan solo al cambiar)
+TransformCache transforms;
+
+// Blancos: todos comparten el modelo `target` y cada uno tiene su propia transformación
 Model target;
-glm::mat4 targetModelMatrix = glm::mat4(1.0f);
+int targetCount = 1; // en escenarios de entrenamiento puede haber miles de blancos a la vez
+vector<unsigned int> targetTransforms;
+
+// Blancos en movimiento (tecla M): cada blanco se desplaza en z a TARGET_SPEED y rebota en los límites del área.
+// Entre dos cuadros el blanco ocupa todo el volumen barrido, así que la rejilla guarda la caja de ese barrido y el
+// disparo se prueba contra la pose interpolada en el instante del clic: el resultado no depende de los FPS.
+const float TARGET_SPEED = 6.0f;
+bool movingTargets = false;
+vector<float> targetDirections; // sentido del movimiento en z de cada blanco (+1 o -1)
+double sweptFrom = 0.0;         // instante desde el que las cajas de la rejilla cubren el recorrido de los blancos
+
+// Historial para resolver cada disparo en el instante del clic: la cámara se registra en cada evento del ratón y en
+// cada cuadro, los blancos cada vez que cambian (su historial lo lleva el hilo de colisiones, ver HitState)
+struct CameraState {
+    glm::vec3 Position;
+    float Yaw;
+    float Pitch;
+};
+StateHistory<CameraState, 256> cameraHistory;
+vector<double> pendingClicks; // instantes de los clics izquierdos aún sin resolver
+DWORD eventTickBase;          // GetTickCount() y glfwGetTime() tomados juntos: pasan los instantes de los mensajes
+double eventTimeBase;         // de Windows al reloj de glfwGetTime()
+
+// Escena estática para las consultas de disparo: el campo, las lámparas y el logo también detienen los disparos
+SceneBVH scene;
+// Material de cada instancia de la escena, en el orden de AddInstance: el campo no se atraviesa, las lámparas son
+// de metal y el logo es un cartel delgado
+vector<PenetrationMaterial> sceneMaterials;
+
+// Los disparos se resuelven en un hilo aparte. El hilo de render envía las consultas y lee los resultados en el
+// cuadro siguiente por colas sin bloqueo; el hilo de colisiones solo lee los modelos (no cambian tras la carga) y
+// su propia copia de los blancos y la escena. El render no vuelve a copiarla: por otra cola le manda solo los
+// cambios de los blancos (cuál, a qué pose y con qué caja), que el hilo aplica en orden antes de cada disparo
+// enviado después de ellos.
+struct ShotRequest {
+    Ray Rays[MAX_PELLETS];
+    int Count;
+    double Time;
+    float Penetration;
+    float Radius; // radio de la esfera barrida contra los blancos; 0 para rayos
+};
+struct ShotResult {
+    double Time;
+    int HitCount;
+    unsigned int HitTargets[MAX_PELLETS];
+    unsigned int HitVersions[MAX_PELLETS]; // versión del blanco en la copia con la que se resolvió
+    int HitScores[MAX_PELLETS];
+};
+// Cambio de un blanco, tal como el hilo de colisiones lo aplica a su copia
+struct TargetMove {
+    unsigned int Target;
+    glm::mat4 World;
+    AABB Bounds;          // caja en la rejilla: la de la pose nueva, o la barrida desde la anterior si el blanco avanza
+    double From;          // inicio del avance; la pose anterior se registra ahí si el historial no la tiene
+    double Time;
+    unsigned int Version; // versión del blanco tras el cambio
+    bool Jump;            // salto (reposición): corta el historial y queda en MoveLog
+};
+// Cambios de los blancos desde el envío anterior, con el estado del movimiento en ese momento
+struct TargetMoves {
+    vector<TargetMove> Moves;
+    bool Moving;
+    double SweptFrom;
+};
+// Estado de los blancos y la escena del hilo de colisiones; una vez arrancado el hilo, solo él lo toca
+struct HitState {
+    vector<ObjectTransform> Targets;
+    vector<unsigned int> Versions;
+    // Broadphase de los blancos: rejilla uniforme sobre el área de juego (cámara en x -20..40 y z 0..100, blancos
+    // en x 35..65 e y 2..8), con margen para el radio del blanco. Solo los blancos cuyas cajas cruza el rayo se
+    // prueban contra triángulos.
+    TargetGrid Grid = TargetGrid(AABB(glm::vec3(-20.0f, -5.0f, -5.0f), glm::vec3(70.0f, 15.0f, 105.0f)), 2.0f);
+    // Poses de cada blanco para rebobinar los disparos; MoveLog guarda qué blanco saltó y cuándo
+    vector<StateHistory<glm::mat4, 16> > History;
+    StateHistory<unsigned int, 256> MoveLog;
+    SceneBVH Scene; // la escena no se mueve: main la copia una vez, antes de arrancar el hilo
+    bool Moving = false;
+    double SweptFrom = 0.0;
+};
+HitState hitState;
+QueryWorker<ShotRequest, ShotResult, std::shared_ptr<const TargetMoves>, 64> hitWorker;
+vector<ShotRequest> queuedShots;   // disparos que no cupieron en la cola del hilo
+vector<TargetMove> pendingMoves;   // cambios de los blancos aún sin enviar
+vector<std::shared_ptr<const TargetMoves> > queuedMoves; // envíos que no cupieron en la cola
+vector<unsigned int> targetVersions; // aumenta cada vez que un blanco cambia de lugar
+void resolveShot(const ShotRequest& request, ShotResult& result);
+void walkPellets(const HitState& state, const ShotRequest& request, const vector<unsigned int>& moved, bool rewindAll,
+                 HitRecord* hits, unsigned int* hitTargets);
+void intersectPellets(const HitState& state, const ShotRequest& request, const vector<unsigned int>& moved, bool rewindAll,
+                      HitRecord* hits, unsigned int* hitTargets);
+void applyTargetMoves(const std::shared_ptr<const TargetMoves>& moves);
+
+// Lista de dibujo de los objetos del mundo, compartida por el render y por la pasada de ids de la selección por GPU.
+// Los objetos que siguen a la cámara (armas, mira y disparo) se dibujan aparte y no se pueden seleccionar.
+struct DrawItem {
+    Model* Source;
+    unsigned int Transform;
+    int Target;    // índice del blanco, o -1 si no es un blanco
+    bool Pickable; // el skybox no detiene disparos
+};
+vector<DrawItem> drawList;
+
+// Selección por GPU (tecla G): en lugar de lanzar rayos en la CPU, el disparo dibuja los ids de objeto y triángulo
+// en los píxeles de los perdigones y los lee uno o dos cuadros después sin detener al GPU. Solo ve la primera
+// superficie visible, así que no hay penetración ni asistencia de apuntado, y usa la pose de los blancos del cuadro
+// en que se dibuja. Pensada para escenas densas, donde dibujar unos pocos píxeles cuesta menos que recorrer los BVH.
+IdPicker picker;
+bool gpuPicking = false;
+struct PendingPick {
+    double Time;
+    vector<unsigned int> Versions; // versiones de los blancos al dibujar los ids
+};
+vector<PendingPick> pendingPicks; // en el orden en que el picker devuelve los resultados
+
+// Subida de texturas por partes: al cargar, cada textura muestra su color promedio y sus píxeles se copian unos pocos
+// megabytes por cuadro a través de buffers de píxeles, así que ningún cuadro espera por una textura
+TextureStreamer textureStreamer;
+
+// Puntaje por anillos: tabla de zonas calculada al cargar la textura del blanco
+ScoreZones targetZones;
+int totalScore = 0;
+unsigned int skyboxTransform, logoTransform, fieldTransform, lamp1Transform, lamp2Transform;
+unsigned int deagleTransform, m4Transform, bayonetTransform, reticleTransform, shootDeagleTransform, shootM4Transform;
 
 // posición de las lámparas
 glm::vec3 posLamp1 = glm::vec3(6.5f, -1.2f, 20.0f);
@@ -100,6 +272,8 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    startEventClock();
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -116,25 +290,95 @@ int main()
 
     // build and compile shaders
     Shader ourShader("shaders/shader_exercise16_mloading.vs", "shaders/shader_exercise16_mloading.fs");
+    if (!picker.Init("shaders/pick_id.vs", "shaders/pick_id.fs")) {
+        std::cout << "La selección por GPU no está disponible: los disparos usan rayos" << std::endl;
+    }
+    textureStreamer.Init();
+
+    // load models: la importación (assimp, vértices, texturas decodificadas y BVH) corre en paralelo en un grupo de
+    // hilos; los buffers y texturas de GL se crean después en este hilo, dueño del contexto. Los modelos más
+    // pesados van primero para que no queden solos al final.
+    Model deagle, m4, skybox, logo, bayonet, reticle2d, shootD, shootM, field, lamp;
+    struct ModelFile {
+        Model* Destination;
+        const char* Path;
+    };
+    const ModelFile modelFiles[] = {
+        { &field, "model/field/scene.gltf" },
+        { &m4, "model/m4/m4.gltf" },
+        { &deagle, "model/deagle/deagle.gltf" },
+        { &skybox, "model/skybox/skybox.gltf" },
+        { &logo, "model/logo/logo.gltf" },
+        { &bayonet, "model/bayonet/bayonet.gltf" },
+        { &lamp, "model/lamp/lamp.gltf" },
+        { &reticle2d, "model/mira4/miragreen.gltf" },
+        { &shootD, "model/shoot/shootD.gltf" },
+        { &shootM, "model/shoot/shootM.gltf" },
+    };
+    {
+        ThreadPool loaders;
+        // El blanco se importa una sola vez, directamente en la variable global; su tabla de puntaje y su proxy de
+        // colisión se calculan en la misma tarea, sin esperar a los demás modelos
+        loaders.Submit([]() {
+            target.Import("model/target/target.gltf");
+            loadTargetZones(target);
+            if (!target.FitProxy(PROXY_MAX_ERROR)) {
+                std::cout << "El blanco no tiene proxy de colisión: los disparos se prueban contra su malla" << std::endl;
+            }
+        });
+        for (const ModelFile& file : modelFiles) {
+            loaders.Submit([file]() { file.Destination->Import(file.Path); });
+        }
+        // Barrera: todas las importaciones terminan antes de subir nada a GL y del primer cuadro
+        loaders.Wait();
+    }
+    target.Upload(&textureStreamer);
+    for (const ModelFile& file : modelFiles) {
+        file.Destination->Upload(&textureStreamer);
+    }
 
-    // load models
-    Model deagle("model/deagle/deagle.gltf");
-    Model m4("model/m4/m4.gltf");
-    Model skybox("model/skybox/skybox.gltf");
-    Model target("model/target/target.gltf");
-    Model logo("model/logo/logo.gltf");
-    Model bayonet("model/bayonet/bayonet.gltf");
-    Model reticle2d("model/mira4/miragreen.gltf");
-    Model shootD("model/shoot/shootD.gltf");
-    Model shootM("model/shoot/shootM.gltf");
-    Model field("model/field/scene.gltf");
-    Model lamp("model/lamp/lamp.gltf");
-    target = Model("model/target/target.gltf");
-
+    glm::mat4 targetModelMatrix = glm::mat4(1.0f);
     targetModelMatrix = glm::translate(targetModelMatrix, glm::vec3(30.0f, 2.0f, 50.0f)); // Posición inicial
     targetModelMatrix = glm::rotate(targetModelMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     targetModelMatrix = glm::rotate(targetModelMatrix, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     targetModelMatrix = glm::scale(targetModelMatrix, glm::vec3(0.2f, 0.2f, 0.2f)); // Escala inicial
+    double startTime = glfwGetTime();
+    targetVersions.assign(targetCount, 0);
+    targetDirections.assign(targetCount, 1.0f);
+    targetTransforms.push_back(transforms.Add(targetModelMatrix));
+    recordTargetMove(0, targetModelMatrix, target.Bounds.Transformed(targetModelMatrix), startTime, startTime, true);
+    for (int i = 1; i < targetCount; i++) {
+        targetTransforms.push_back(transforms.Add());
+        repositionTarget(i, glm::vec3(30.0f, 2.0f, 50.0f), startTime);
+    }
+    recordCameraState(startTime);
+    initSceneTransforms();
+
+    // Instancias de la escena; las dos lámparas comparten los BVH del mismo modelo. El skybox no bloquea disparos.
+    scene.AddInstance(field, fieldTransform);
+    sceneMaterials.push_back(PenetrationMaterial(1000.0f, 1000.0f));
+    scene.AddInstance(lamp, lamp1Transform);
+    sceneMaterials.push_back(PenetrationMaterial(60.0f, 400.0f));
+    scene.AddInstance(lamp, lamp2Transform);
+    sceneMaterials.push_back(PenetrationMaterial(60.0f, 400.0f));
+    scene.AddInstance(logo, logoTransform);
+    sceneMaterials.push_back(PenetrationMaterial(10.0f, 50.0f));
+    scene.Update(transforms);
+
+    // Lista de dibujo del mundo: los blancos, el campo, las lámparas, el logo y el skybox
+    for (unsigned int i = 0; i < targetTransforms.size(); i++) {
+        drawList.push_back({ &target, targetTransforms[i], (int)i, true });
+    }
+    drawList.push_back({ &field, fieldTransform, -1, true });
+    drawList.push_back({ &lamp, lamp1Transform, -1, true });
+    drawList.push_back({ &lamp, lamp2Transform, -1, true });
+    drawList.push_back({ &logo, logoTransform, -1, true });
+    drawList.push_back({ &skybox, skyboxTransform, -1, false });
+
+    // El hilo de colisiones recibe su copia de la escena y, como primeros cambios, la posición inicial de los blancos
+    hitState.Scene = scene;
+    publishTargetMoves();
+    hitWorker.Start(resolveShot, applyTargetMoves);
 
     camera.MovementSpeed = 7;
 
@@ -146,6 +390,15 @@ int main()
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        // Siguiente tramo de las texturas que aún se están subiendo
+        textureStreamer.Update();
+
+        // El bloom del retroceso se cierra con el tiempo
+        currentBloom = glm::max(0.0f, currentBloom - bloomRecovery * deltaTime);
+
+        // Los blancos avanzan antes de procesar los clics de este cuadro, que ocurrieron durante el cuadro anterior
+        moveTargets(currentFrame, deltaTime);
+
         // input
         processInput(window);
 
@@ -188,27 +441,11 @@ int main()
         ourShader.setMat4("projection", projection);
         ourShader.setMat4("view", view);
 
-        // Target
-        ourShader.setMat4("model", targetModelMatrix);
-        target.Draw(ourShader);
-
-        // Sbybox
-        drawSkybox(ourShader, view, projection, skybox);
+        // Blancos, skybox, campo, lámparas y logo
+        drawWorld(ourShader);
  
         // Mira
         drawReticle(ourShader, view, projection, reticle2d);
-      
-        // Logo
-        drawLogo(ourShader, view, projection, logo);
-
-        // Field
-        drawField(ourShader, view, projection, field);
-
-        // Lampara 1
-        drawLamp1(ourShader, view, projection, lamp);
-
-        // Lampara 2
-        drawLamp2(ourShader, view, projection, lamp);
 
         // Dibujar el arma seleccionada
         if (showDeagle) {
@@ -248,18 +485,21 @@ int main()
             }
         }
 
-        // Verificar la acción de disparo
-        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-            shootRayFromCamera(camera, target, targetModelMatrix);
-        }
-        ourShader.setMat4("model", targetModelMatrix);
-        target.Draw(ourShader);
-
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    // El hilo de colisiones lee los modelos locales de main: se detiene antes de que se destruyan
+    hitWorker.Stop();
+
+    // Los modelos devuelven sus texturas al registro, que borra las que ya no usa ninguno; necesita el contexto de
+    // GL todavía. El streamer no vuelve a actualizarse, así que no escribe en las que aún se estaban subiendo.
+    target.ReleaseTextures();
+    for (const ModelFile& file : modelFiles) {
+        file.Destination->ReleaseTextures();
+    }
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     glfwTerminate();
     return 0;
@@ -300,94 +540,595 @@ void processInput(GLFWwindow* window) {
     // Mantener la altura constante
     camera.Position.y = currentCameraY; // Restablecer la posición Y de la cámara a su valor original
 
-    // Alternar entre las armas
+    // Alternar entre las armas: el M4 es preciso pero abre el cono al disparar seguido, la Deagle retrocede más, y con
+    // munición de perdigones (tecla 4) reparte 12 perdigones en un cono amplio que apenas penetran
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
         showDeagle = false;
         showM4 = true;
         showBayonet = false;
+        shotPenetration = 80.0f;
+        shotPellets = 1;
+        shotSpread = 0.1f;
+        bloomPerShot = 0.6f;
     }
     else if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
         showDeagle = true;
         showM4 = false;
         showBayonet = false;
+        shotPenetration = 50.0f;
+        shotPellets = 1;
+        shotSpread = 0.2f;
+        bloomPerShot = 1.5f;
     }
     else if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
         showDeagle = false;
         showM4 = false;
         showBayonet = true;
+        shotPenetration = 0.0f;
+        shotPellets = 1;
+        shotSpread = 0.0f;
+        bloomPerShot = 0.0f;
+    }
+    else if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) {
+        showDeagle = true;
+        showM4 = false;
+        showBayonet = false;
+        shotPenetration = 10.0f;
+        shotPellets = 12;
+        shotSpread = 2.5f;
+        bloomPerShot = 2.0f;
     }
 
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-        glm::mat4 targetModelMatrix;
-        shootRayFromCamera(camera, target, targetModelMatrix);
+    // Activar o desactivar la asistencia de apuntado al pulsar T
+    static bool aimAssistKeyDown = false;
+    bool aimAssistKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (aimAssistKey && !aimAssistKeyDown) {
+        aimAssistRadius = aimAssistRadius > 0.0f ? 0.0f : AIM_ASSIST_RADIUS;
+    }
+    aimAssistKeyDown = aimAssistKey;
+
+    // Activar o detener el movimiento de los blancos al pulsar M
+    static bool movingKeyDown = false;
+    bool movingKey = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (movingKey && !movingKeyDown) {
+        movingTargets = !movingTargets;
+        publishTargetMoves();
     }
+    movingKeyDown = movingKey;
 
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !isShooting) {
+    // Alternar entre los rayos y la selección por GPU al pulsar G
+    static bool pickingKeyDown = false;
+    bool pickingKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (pickingKey && !pickingKeyDown && picker.Ready()) {
+        gpuPicking = !gpuPicking;
+    }
+    pickingKeyDown = pickingKey;
+
+    // El movimiento con el teclado se integra por cuadro; se registra para poder rebobinar la cámara
+    recordCameraState(glfwGetTime());
+
+    // Resultados de los disparos que el hilo de colisiones terminó desde el cuadro anterior
+    applyShotResults();
+    applyPickResults();
+
+    // Los disparos salen de los clics registrados por el callback, no del estado del botón en este cuadro
+    processClicks();
+}
+
+// Resuelve los clics pendientes en orden, cada uno con la cámara y los blancos del instante en que ocurrió
+void processClicks() {
+    // Primero los cambios de los blancos y los disparos que quedaron esperando por las colas llenas, para no alterar
+    // el orden: un disparo solo sale cuando ya salieron todos los cambios anteriores a él
+    unsigned int sent = 0;
+    if (flushTargetMoves()) {
+        while (sent < queuedShots.size() && hitWorker.Submit(queuedShots[sent])) {
+            sent++;
+        }
+    }
+    queuedShots.erase(queuedShots.begin(), queuedShots.begin() + sent);
+
+    for (unsigned int i = 0; i < pendingClicks.size(); i++) {
         isShooting = true; // Establece el estado de disparo a verdadero
         shootTime = 0.0f; // Reinicia el contador de tiempo de disparo
 
-        // El resto de la lógica de disparo permanece igual
-        glm::mat4 targetModelMatrix;
-        shootRayFromCamera(camera, target, targetModelMatrix);
+        // Con todos los buffers de lectura ocupados, o con texturas todavía subiéndose, el disparo se resuelve con rayos
+        Camera shotCamera = cameraAt(pendingClicks[i]);
+        if (!gpuPicking || !pickFromCamera(shotCamera, pendingClicks[i])) {
+            shootRayFromCamera(shotCamera, pendingClicks[i]);
+        }
+        // El retroceso abre el cono de los disparos siguientes; el primero sale con el cono base
+        currentBloom = glm::min(bloomMax, currentBloom + bloomPerShot);
     }
+    pendingClicks.clear();
 }
 
-void shootRayFromCamera(Camera& camera, Model& target, glm::mat4& targetModelMatrix) {
-    glm::vec3 rayOrigin = camera.Position;
-    glm::vec3 rayDirection = camera.Front;
-    checkRayIntersection(rayOrigin, rayDirection, targetModelMatrix, target);
+void recordCameraState(double time) {
+    CameraState state;
+    state.Position = camera.Position;
+    state.Yaw = camera.Yaw;
+    state.Pitch = camera.Pitch;
+    cameraHistory.Push(time, state);
 }
 
-bool intersectRayTriangle(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t) {
-    const float EPSILON = 0.0000001f;
-    glm::vec3 edge1, edge2, h, s, q;
-    float a, f, u, v;
-    edge1 = v1 - v0;
-    edge2 = v2 - v0;
-    h = glm::cross(rayDir, edge2);
-    a = glm::dot(edge1, h);
-    if (a > -EPSILON && a < EPSILON)
-        return false;    // El rayo es paralelo al triángulo.
-    f = 1.0 / a;
-    s = rayOrigin - v0;
-    u = f * glm::dot(s, h);
-    if (u < 0.0 || u > 1.0)
-        return false;
-    q = glm::cross(s, edge1);
-    v = f * glm::dot(rayDir, q);
-    if (v < 0.0 || u + v > 1.0)
+// Cámara interpolada en el instante dado a partir del historial
+Camera cameraAt(double time) {
+    CameraState state;
+    if (!cameraHistory.At(time, state, [](const CameraState& a, const CameraState& b, float f) {
+            CameraState c;
+            c.Position = glm::mix(a.Position, b.Position, f);
+            c.Yaw = glm::mix(a.Yaw, b.Yaw, f);
+            c.Pitch = glm::mix(a.Pitch, b.Pitch, f);
+            return c;
+        })) {
+        return camera;
+    }
+    Camera shotCamera(state.Position, camera.WorldUp, state.Yaw, state.Pitch);
+    shotCamera.Zoom = camera.Zoom;
+    return shotCamera;
+}
+
+// Envía el disparo al hilo de colisiones; el resultado se aplica en un cuadro posterior
+void shootRayFromCamera(Camera& camera, double time) {
+    ShotRequest request;
+    request.Count = buildShotRays(camera, request.Rays, shotPellets, shotSpread + currentBloom);
+    request.Time = time;
+    request.Penetration = shotPenetration;
+    request.Radius = aimAssistRadius;
+    if (!queuedMoves.empty() || !queuedShots.empty() || !hitWorker.Submit(request)) {
+        queuedShots.push_back(request);
+    }
+}
+
+// Dibuja los ids de la lista de dibujo en los píxeles de los perdigones, vistos desde la cámara del clic. Devuelve
+// false si el picker todavía espera todas sus lecturas anteriores, o si el streamer no terminó de subir las
+// texturas: hasta entonces muestran su color promedio de 1x1, y la prueba alfa de la pasada de ids descartaría
+// otros texeles que las máscaras de cobertura de los rayos.
+bool pickFromCamera(Camera& camera, double time) {
+    if (!textureStreamer.Idle()) {
         return false;
-    // En este punto sabemos que hay una intersección en la línea del rayo, pero no si el rayo realmente la intersecta.
-    t = f * glm::dot(edge2, q);
-    if (t > EPSILON) // Intersección con el rayo
-        return true;
+    }
+    Ray rays[MAX_PELLETS];
+    int count = buildShotRays(camera, rays, shotPellets, shotSpread + currentBloom);
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1500.0f);
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::vec2 pixels[MAX_PELLETS];
+    for (int i = 0; i < count; i++) {
+        glm::vec4 clip = projection * view * glm::vec4(rays[i].Origin + rays[i].Direction, 1.0f);
+        pixels[i] = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(SCR_WIDTH, SCR_HEIGHT);
+    }
+    bool sent = picker.Pick(view, projection, glm::ivec2(SCR_WIDTH, SCR_HEIGHT), pixels, count, [](Shader& shader) {
+        for (unsigned int i = 0; i < drawList.size(); i++) {
+            if (drawList[i].Pickable) {
+                picker.DrawModel(shader, *drawList[i].Source, transforms.Get(drawList[i].Transform).World, i + 1);
+            }
+        }
+    });
+    if (sent) {
+        PendingPick pick;
+        pick.Time = time;
+        pick.Versions = targetVersions;
+        pendingPicks.push_back(pick);
+    }
+    return sent;
+}
+
+// Aplica las selecciones por GPU cuyos ids ya se leyeron. Como con los rayos, un blanco que cambió de lugar después
+// de dibujar los ids no puntúa; cada blanco alcanzado se mueve una vez aunque lo alcancen varios perdigones.
+void applyPickResults() {
+    PickResult result;
+    bool moved = false;
+    while (picker.Poll(result)) {
+        PendingPick pick = pendingPicks.front();
+        pendingPicks.erase(pendingPicks.begin());
+
+        int shotScore = 0;
+        vector<unsigned int> hitTargets;
+        for (int i = 0; i < result.Count; i++) {
+            const PickSample& sample = result.Samples[i];
+            if (sample.Object == 0 || drawList[sample.Object - 1].Target < 0) {
+                continue;
+            }
+            unsigned int index = drawList[sample.Object - 1].Target;
+            if (pick.Versions[index] != targetVersions[index]) {
+                continue;
+            }
+            shotScore += targetZones.Score(sample.TexCoords);
+            if (std::find(hitTargets.begin(), hitTargets.end(), index) == hitTargets.end()) {
+                hitTargets.push_back(index);
+            }
+        }
+        for (unsigned int j = 0; j < hitTargets.size(); j++) {
+            glm::vec3 currentPosition = transforms.Get(targetTransforms[hitTargets[j]]).Position();
+            repositionTarget(hitTargets[j], currentPosition, pick.Time);
+            moved = true;
+        }
+        if (!hitTargets.empty()) {
+            totalScore += shotScore;
+            std::cout << "Puntos: " << shotScore << " (total " << totalScore << ")" << std::endl;
+        }
+    }
+    if (moved) {
+        publishTargetMoves();
+    }
+}
 
-    return false;
+// Genera los rayos de un disparo repartidos uniformemente dentro del cono; con varios perdigones el primero sigue
+// la mira. Todos parten de la cámara, así que forman un grupo coherente para la consulta en paquetes.
+int buildShotRays(Camera& camera, Ray* rays, int pellets, float spreadDegrees) {
+    static std::mt19937 gen(std::random_device{}());
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+
+    int count = glm::clamp(pellets, 1, MAX_PELLETS);
+    float spreadRadius = glm::tan(glm::radians(spreadDegrees));
+    for (int i = 0; i < count; i++) {
+        glm::vec3 direction = camera.Front;
+        if (spreadRadius > 0.0f && (i > 0 || count == 1)) {
+            float r = spreadRadius * glm::sqrt(dis(gen));
+            float angle = 2.0f * glm::pi<float>() * dis(gen);
+            direction = glm::normalize(direction + camera.Right * (r * glm::cos(angle)) + camera.Up * (r * glm::sin(angle)));
+        }
+        rays[i] = Ray(camera.Position, direction);
+    }
+    return count;
 }
 
-bool intersectsTargetRayTriangle(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const Model& model, const glm::mat4& modelMatrix) {
-    for (const Mesh& mesh : model.meshes) {
-        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
-            glm::vec3 v0 = glm::vec3(modelMatrix * glm::vec4(mesh.vertices[mesh.indices[i]].Position, 1.0));
-            glm::vec3 v1 = glm::vec3(modelMatrix * glm::vec4(mesh.vertices[mesh.indices[i + 1]].Position, 1.0));
-            glm::vec3 v2 = glm::vec3(modelMatrix * glm::vec4(mesh.vertices[mesh.indices[i + 2]].Position, 1.0));
+// Prueba un blanco con la transformación que tenía en el instante del disparo
+float intersectTargetAt(const Model& target, const glm::mat4& world, const Ray& ray, float radius, float tMax, HitRecord& hit) {
+    AABB box = target.Bounds.Transformed(world);
+    if (IntersectRayAABB(ray.Origin, 1.0f / ray.Direction, box.min - glm::vec3(radius), box.max + glm::vec3(radius), tMax) == FLT_MAX) {
+        return FLT_MAX;
+    }
+    ObjectTransform transform(world);
+    return intersectTarget(target, transform, ray, radius, tMax, hit);
+}
+// Prueba contra el blanco en espacio del modelo: un rayo, o una esfera barrida si radius > 0. El proxy encierra la
+// malla, así que si no se alcanza antes de tMax tampoco la malla; si se alcanza, la prueba exacta contra el BVH
+float intersectTarget(const Model& target, const ObjectTransform& transform, const Ray& ray, float radius, float tMax, HitRecord& hit) {
+    glm::vec3 origin = transform.ToLocalPoint(ray.Origin);
+    glm::vec3 direction = transform.ToLocalDirection(ray.Direction);
+    float localRadius = transform.ToLocalLength(radius);
+    if (target.Proxy.Intersect(origin, direction, localRadius, tMax) == FLT_MAX) {
+        return FLT_MAX;
+    }
+    bool found = radius > 0.0f ? target.SweepSphere(origin, direction, localRadius, hit, tMax)
+                               : target.IntersectClosest(origin, direction, hit, tMax);
+    return found ? hit.T : FLT_MAX;
+}
 
-            float t = 0.0f;
-            if (intersectRayTriangle(rayOrigin, rayDirection, v0, v1, v2, t)) {
-                return true; // Colisiona
+// Un perdigón a la vez: las esferas barridas de la asistencia de puntería, y el disparo de un solo rayo. La rejilla
+// recorre las celdas de cerca a lejos y se detiene en el primer impacto; los blancos cuyas cajas alcanza se prueban
+// contra su BVH en espacio del modelo
+void walkPellets(const HitState& state, const ShotRequest& request, const vector<unsigned int>& moved, bool rewindAll,
+                 HitRecord* hits, unsigned int* hitTargets) {
+    double time = request.Time;
+    for (int i = 0; i < request.Count; i++) {
+        const Ray& ray = request.Rays[i];
+        HitRecord& hit = hits[i];
+        float tMax = ray.TMax;
+        hitTargets[i] = TargetGrid::NONE;
+        if (!rewindAll) {
+            hitTargets[i] = state.Grid.SweepClosest(ray.Origin, ray.Direction, request.Radius, tMax, [&](unsigned int index, float t) {
+                if (std::find(moved.begin(), moved.end(), index) != moved.end()) {
+                    return FLT_MAX;
+                }
+                // Un blanco que siguió moviéndose después del clic se prueba en su pose interpolada de ese instante
+                const StateHistory<glm::mat4, 16>& history = state.History[index];
+                if (history.Get(0).Time > time) {
+                    glm::mat4 world;
+                    history.At(time, world, InterpolateTransform);
+                    return intersectTarget(target, ObjectTransform(world), ray, request.Radius, t, hit);
+                }
+                return intersectTarget(target, state.Targets[index], ray, request.Radius, t, hit);
+            });
+        }
+        for (unsigned int j = 0; j < moved.size(); j++) {
+            glm::mat4 world;
+            state.History[moved[j]].At(time, world, InterpolateTransform);
+            if (intersectTargetAt(target, world, ray, request.Radius, tMax, hit) < tMax) {
+                tMax = hit.T;
+                hitTargets[i] = moved[j];
             }
         }
     }
-    return false; // No colisiona
 }
 
-void checkRayIntersection(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::mat4& targetModelMatrix, const Model& target) {
-    if (intersectsTargetRayTriangle(rayOrigin, rayDirection, target, targetModelMatrix)) {
-        // Extracción de la posición actual del modelo
-        glm::vec3 currentPosition = glm::vec3(targetModelMatrix[3][0], targetModelMatrix[3][1], targetModelMatrix[3][2]);
+// Varios perdigones sin asistencia: cada uno recorre la rejilla por su cuenta, celda a celda, y los blancos que
+// encuentran se prueban de cerca a lejos. Cada blanco recibe juntos, en una consulta en paquetes, los perdigones
+// cuyo mejor impacto todavía está detrás de su caja; un perdigón deja de avanzar en cuanto su impacto queda delante
+// de la celda siguiente, y de los blancos que le quedan por delante.
+void intersectPellets(const HitState& state, const ShotRequest& request, const vector<unsigned int>& moved, bool rewindAll,
+                      HitRecord* hits, unsigned int* hitTargets) {
+    struct Candidate {
+        float Enter;          // donde el perdigón entra en la caja del blanco
+        unsigned int Target;
+        int Pellet;
+    };
+    double time = request.Time;
+    float tMax[MAX_PELLETS];
+    TargetGrid::Walk walks[MAX_PELLETS];
+    vector<unsigned int> seen[MAX_PELLETS]; // blancos ya anotados por cada perdigón: la rejilla los repite por celda
+    vector<Candidate> candidates;
+    float next = FLT_MAX;                   // entrada del candidato más cercano
+    auto note = [&](int pellet, unsigned int index, float enter) {
+        if (std::find(seen[pellet].begin(), seen[pellet].end(), index) != seen[pellet].end()) {
+            return;
+        }
+        seen[pellet].push_back(index);
+        Candidate candidate = { enter, index, pellet };
+        candidates.push_back(candidate);
+        next = glm::min(next, enter);
+    };
+
+    // Los blancos que se movieron después del disparo no están en la rejilla con la caja de ese instante: entran con
+    // la caja de su pose rebobinada
+    vector<AABB> movedBoxes(moved.size());
+    for (unsigned int j = 0; j < moved.size(); j++) {
+        glm::mat4 world;
+        state.History[moved[j]].At(time, world, InterpolateTransform);
+        movedBoxes[j] = target.Bounds.Transformed(world);
+    }
+    for (int i = 0; i < request.Count; i++) {
+        const Ray& ray = request.Rays[i];
+        tMax[i] = ray.TMax;
+        hitTargets[i] = TargetGrid::NONE;
+        walks[i].Done = true;
+        if (!rewindAll) {
+            state.Grid.BeginWalk(walks[i], ray.Origin, ray.Direction, tMax[i], [&](unsigned int index, float enter) {
+                if (std::find(moved.begin(), moved.end(), index) == moved.end()) {
+                    note(i, index, enter);
+                }
+            });
+        }
+        for (unsigned int j = 0; j < moved.size(); j++) {
+            float enter = IntersectRayAABB(ray.Origin, 1.0f / ray.Direction, movedBoxes[j].min, movedBoxes[j].max, tMax[i]);
+            if (enter != FLT_MAX) {
+                note(i, moved[j], enter);
+            }
+        }
+    }
+
+    while (true) {
+        // Fuera los candidatos que quedan detrás del mejor impacto de su perdigón
+        unsigned int kept = 0;
+        next = FLT_MAX;
+        for (unsigned int k = 0; k < candidates.size(); k++) {
+            if (candidates[k].Enter < tMax[candidates[k].Pellet]) {
+                next = glm::min(next, candidates[k].Enter);
+                candidates[kept++] = candidates[k];
+            }
+        }
+        candidates.resize(kept);
+        // Cada perdigón avanza hasta pasar el candidato más cercano, o su propio impacto: así ese candidato es de
+        // verdad el próximo blanco en el camino de todos. Sin candidatos, los perdigones recorren lo que les quede
+        for (int i = 0; i < request.Count; i++) {
+            while (!walks[i].Done && walks[i].Enter <= glm::min(next, tMax[i])) {
+                state.Grid.StepWalk(walks[i], tMax[i], [&](unsigned int index, float enter) {
+                    if (std::find(moved.begin(), moved.end(), index) == moved.end()) {
+                        note(i, index, enter);
+                    }
+                });
+            }
+        }
+        if (candidates.empty()) {
+            break;
+        }
 
-        // Llamar a repositionTarget con la matriz del modelo y la posición actual
-        repositionTarget(targetModelMatrix, currentPosition);
+        // El blanco más cercano, con todos los perdigones que lo tienen por delante
+        unsigned int index = TargetGrid::NONE;
+        for (unsigned int k = 0; k < candidates.size() && index == TargetGrid::NONE; k++) {
+            if (candidates[k].Enter == next) {
+                index = candidates[k].Target;
+            }
+        }
+        int pellets[MAX_PELLETS];
+        unsigned int count = 0;
+        kept = 0;
+        for (unsigned int k = 0; k < candidates.size(); k++) {
+            if (candidates[k].Target == index) {
+                pellets[count++] = candidates[k].Pellet;
+            } else {
+                candidates[kept++] = candidates[k];
+            }
+        }
+        candidates.resize(kept);
+
+        // El blanco en su pose del instante del disparo; el proxy descarta los perdigones que no llegan a la malla
+        const StateHistory<glm::mat4, 16>& history = state.History[index];
+        ObjectTransform transform = state.Targets[index];
+        if (std::find(moved.begin(), moved.end(), index) != moved.end() || history.Get(0).Time > time) {
+            glm::mat4 world;
+            history.At(time, world, InterpolateTransform);
+            transform = ObjectTransform(world);
+        }
+        Ray local[MAX_PELLETS];
+        int localPellets[MAX_PELLETS];
+        unsigned int localCount = 0;
+        for (unsigned int k = 0; k < count; k++) {
+            int i = pellets[k];
+            glm::vec3 origin = transform.ToLocalPoint(request.Rays[i].Origin);
+            glm::vec3 direction = transform.ToLocalDirection(request.Rays[i].Direction);
+            if (target.Proxy.Intersect(origin, direction, 0.0f, tMax[i]) != FLT_MAX) {
+                local[localCount] = Ray(origin, direction, tMax[i]);
+                localPellets[localCount++] = i;
+            }
+        }
+        HitRecord targetHits[MAX_PELLETS];
+        bool found[MAX_PELLETS];
+        target.IntersectClosest(local, localCount, targetHits, found);
+        for (unsigned int k = 0; k < localCount; k++) {
+            if (found[k]) {
+                int i = localPellets[k];
+                hits[i] = targetHits[k];
+                tMax[i] = targetHits[k].T;
+                hitTargets[i] = index;
+            }
+        }
+    }
+}
+
+// Hilo de colisiones: resuelve un disparo contra su copia de los blancos y la escena, que ya tiene todos los
+// cambios enviados antes que el disparo (y quizá algunos posteriores, que el historial permite rebobinar)
+void resolveShot(const ShotRequest& request, ShotResult& result) {
+    const HitState& state = hitState;
+    double time = request.Time;
+    result.Time = time;
+    result.HitCount = 0;
+
+    // Blancos que se movieron después del disparo: la rejilla ya tiene su caja nueva, así que se prueban aparte
+    // con la transformación que tenían en ese instante
+    vector<unsigned int> moved;
+    for (unsigned int i = 0; i < state.MoveLog.Size() && state.MoveLog.Get(i).Time > time; i++) {
+        if (std::find(moved.begin(), moved.end(), state.MoveLog.Get(i).State) == moved.end()) {
+            moved.push_back(state.MoveLog.Get(i).State);
+        }
+    }
+    // Las cajas barridas de la rejilla solo cubren el recorrido desde SweptFrom. Si el disparo es anterior (el hilo
+    // resolvió tarde) no sirven, y todos los blancos se prueban aparte: la caja de la pose rebobinada primero
+    bool rewindAll = state.Moving && time < state.SweptFrom;
+    if (rewindAll) {
+        moved.resize(state.Targets.size());
+        for (unsigned int i = 0; i < moved.size(); i++) {
+            moved[i] = i;
+        }
+    }
+
+    // El impacto más cercano de cada perdigón y su blanco
+    HitRecord hits[MAX_PELLETS];
+    unsigned int hitTargets[MAX_PELLETS];
+    if (request.Radius > 0.0f || request.Count == 1) {
+        walkPellets(state, request, moved, rewindAll, hits, hitTargets);
+    } else {
+        intersectPellets(state, request, moved, rewindAll, hits, hitTargets);
+    }
+
+    for (int i = 0; i < request.Count; i++) {
+        const Ray& ray = request.Rays[i];
+        HitRecord& hit = hits[i];
+        unsigned int targetIndex = hitTargets[i];
+        if (targetIndex == TargetGrid::NONE) {
+            continue;
+        }
+        // El campo, las lámparas o el logo pueden tapar el blanco: se recogen todas las superficies antes del blanco
+        // y la bala lo alcanza solo si le queda poder tras atravesarlas
+        HitList<16> blockers;
+        state.Scene.IntersectAll(ray.Origin, ray.Direction, hit.T, [&](HitRecord& h) { return blockers.Add(h); });
+        if (blockers.Count > 0 &&
+            ResolvePenetration(blockers, ray.Direction, request.Penetration, [](unsigned int instance) { return sceneMaterials[instance]; }) < hit.T) {
+            continue;
+        }
+        hit.Point = ray.Origin + hit.T * ray.Direction;
+
+        int j = 0;
+        while (j < result.HitCount && result.HitTargets[j] != targetIndex) {
+            j++;
+        }
+        if (j == result.HitCount) {
+            result.HitTargets[j] = targetIndex;
+            result.HitVersions[j] = state.Versions[targetIndex];
+            result.HitScores[j] = 0;
+            result.HitCount++;
+        }
+        result.HitScores[j] += targetZones.Score(hit.TexCoords);
+    }
+}
+
+// Hilo de render: aplica los resultados terminados. Un impacto sobre un blanco que ya cambió de lugar desde el
+// estado con que se resolvió (otro disparo anterior lo alcanzó) se descarta para no contarlo dos veces.
+void applyShotResults() {
+    ShotResult result;
+    bool moved = false;
+    while (hitWorker.Poll(result)) {
+        int shotScore = 0;
+        int hitCount = 0;
+        for (int j = 0; j < result.HitCount; j++) {
+            unsigned int index = result.HitTargets[j];
+            if (result.HitVersions[j] != targetVersions[index]) {
+                continue;
+            }
+            shotScore += result.HitScores[j];
+            hitCount++;
+
+            // Extracción de la posición actual del modelo
+            glm::vec3 currentPosition = transforms.Get(targetTransforms[index]).Position();
+
+            // Llamar a repositionTarget con el blanco alcanzado y su posición actual
+            repositionTarget(index, currentPosition, result.Time);
+            moved = true;
+        }
+        if (hitCount > 0) {
+            totalScore += shotScore;
+            std::cout << "Puntos: " << shotScore << " (total " << totalScore << ")" << std::endl;
+        }
+    }
+    if (moved) {
+        publishTargetMoves();
+    }
+}
+
+// Envía al hilo de colisiones los cambios de los blancos anotados desde el envío anterior, con el estado del
+// movimiento. Es lo único que cruza de un hilo al otro: unos cien bytes por blanco que cambió, en lugar de copiar
+// la rejilla, los historiales y la escena.
+void publishTargetMoves() {
+    std::shared_ptr<TargetMoves> moves = std::make_shared<TargetMoves>();
+    moves->Moves = pendingMoves;
+    moves->Moving = movingTargets;
+    moves->SweptFrom = sweptFrom;
+    pendingMoves.clear();
+    queuedMoves.push_back(moves);
+    flushTargetMoves();
+}
+
+// Reintenta los envíos que no cupieron en la cola, en orden; true si no queda ninguno
+bool flushTargetMoves() {
+    unsigned int sent = 0;
+    while (sent < queuedMoves.size() && hitWorker.Publish(queuedMoves[sent])) {
+        sent++;
+    }
+    queuedMoves.erase(queuedMoves.begin(), queuedMoves.begin() + sent);
+    return queuedMoves.empty();
+}
+
+// Hilo de colisiones: aplica a su copia los cambios de los blancos, en el orden en que ocurrieron
+void applyTargetMoves(const std::shared_ptr<const TargetMoves>& moves) {
+    for (const TargetMove& move : moves->Moves) {
+        if (move.Target >= hitState.Targets.size()) {
+            hitState.Targets.resize(move.Target + 1);
+            hitState.Versions.resize(move.Target + 1, 0);
+            hitState.History.resize(move.Target + 1);
+        }
+        // Sin muestra al inicio del avance (estaba quieto o acaba de saltar) se interpolaría desde una pose más vieja
+        StateHistory<glm::mat4, 16>& history = hitState.History[move.Target];
+        if (!move.Jump && history.Size() > 0 && history.Get(0).Time < move.From) {
+            history.Push(move.From, hitState.Targets[move.Target].World);
+        }
+        history.Push(move.Time, move.World, move.Jump);
+        if (move.Jump) {
+            hitState.MoveLog.Push(move.Time, move.Target);
+        }
+        hitState.Targets[move.Target] = ObjectTransform(move.World);
+        hitState.Versions[move.Target] = move.Version;
+        // Solo se tocan las celdas que la caja deja y a las que entra
+        hitState.Grid.Update(move.Target, move.Bounds);
+    }
+    hitState.Moving = moves->Moving;
+    hitState.SweptFrom = moves->SweptFrom;
+}
+
+// Construye la tabla de puntaje a partir de la textura difusa del blanco
+void loadTargetZones(const Model& target) {
+    for (unsigned int i = 0; i < target.textures_loaded.size(); i++) {
+        const Texture& texture = target.textures_loaded[i];
+        if (texture.type == "texture_diffuse") {
+            // La tabla sale de los píxeles que el registro ya decodificó; el archivo solo se decodifica otra vez si la
+            // GPU recibe una copia comprimida en bloques en su lugar
+            bool built = target.ReadTexture(i, [](const DecodedImage& image) {
+                targetZones.Build(image.Data, image.Width, image.Height, image.Components);
+            });
+            if (!built) {
+                targetZones.Load(target.directory + '/' + texture.path);
+            }
+            return;
+        }
     }
 }
 
@@ -395,7 +1136,7 @@ glm::vec3 aiVector3DToGlmVec3(const aiVector3D& v) {
     return glm::vec3(v.x, v.y, v.z);
 }
 
-void repositionTarget(glm::mat4& modelMatrix, const glm::vec3& currentPosition) {
+void repositionTarget(unsigned int targetIndex, const glm::vec3& currentPosition, double time) {
     std::random_device rd;
     std::mt19937 gen(rd());
     std::uniform_real_distribution<> disX(35.0, 65.0); // Límite en el eje X
@@ -413,13 +1154,120 @@ void repositionTarget(glm::mat4& modelMatrix, const glm::vec3& currentPosition)
     newPosition.z = glm::clamp(newPosition.z, zMinGlobal, zMaxGlobal);
 
     // Restablecer la matriz del modelo para aplicar la nueva posición
-    modelMatrix = glm::mat4(1.0f);
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
     modelMatrix = glm::translate(modelMatrix, newPosition);
     modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f));
     
     // Cambiar la orientación y escala del target
     modelMatrix = glm::rotate(modelMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     modelMatrix = glm::rotate(modelMatrix, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    // Marca la transformación como sucia; la inversa y la matriz normal se recalculan al consultarla
+    transforms.Set(targetTransforms[targetIndex], modelMatrix);
+    targetVersions[targetIndex]++;
+
+    // El salto queda registrado en el instante del disparo que lo provocó, así un clic posterior del mismo cuadro
+    // ya ve el blanco en su nueva posición
+    recordTargetMove(targetIndex, modelMatrix, target.Bounds.Transformed(modelMatrix), time, time, true);
+}
+
+// Avanza los blancos en movimiento hasta time. La rejilla del hilo de colisiones recibe la caja barrida desde la pose
+// anterior y el historial la pose nueva, para rebobinar los disparos a cualquier instante intermedio
+void moveTargets(double time, float dt) {
+    if (!movingTargets || dt <= 0.0f) {
+        return;
+    }
+    double from = time - dt;
+    for (unsigned int i = 0; i < targetTransforms.size(); i++) {
+        glm::mat4 start = transforms.Get(targetTransforms[i]).World;
+
+        glm::vec3 position = glm::vec3(start[3]);
+        position.z += targetDirections[i] * TARGET_SPEED * dt;
+        if (position.z < 0.0f || position.z > 100.0f) {
+            position.z = glm::clamp(position.z, 0.0f, 100.0f);
+            targetDirections[i] = -targetDirections[i];
+        }
+        glm::mat4 end = start;
+        end[3] = glm::vec4(position, 1.0f);
+
+        transforms.Set(targetTransforms[i], end);
+        recordTargetMove(i, end, target.Bounds.Swept(start, end), from, time, false);
+    }
+    sweptFrom = from;
+    publishTargetMoves();
+}
+
+// Anota el cambio de un blanco para el hilo de colisiones; sale con el siguiente publishTargetMoves
+void recordTargetMove(unsigned int targetIndex, const glm::mat4& world, const AABB& bounds, double from, double time, bool jump) {
+    TargetMove move;
+    move.Target = targetIndex;
+    move.World = world;
+    move.Bounds = bounds;
+    move.From = from;
+    move.Time = time;
+    move.Version = targetVersions[targetIndex];
+    move.Jump = jump;
+    pendingMoves.push_back(move);
+}
+
+// Dibuja los objetos del mundo de la lista de dibujo
+void drawWorld(Shader& shader) {
+    for (unsigned int i = 0; i < drawList.size(); i++) {
+        setModelTransform(shader, drawList[i].Transform);
+        drawList[i].Source->Draw(shader);
+    }
+}
+
+// Registra las transformaciones de todos los objetos. Las de los objetos estáticos se calculan una sola vez aquí.
+void initSceneTransforms() {
+    glm::mat4 skyboxMatrix = glm::mat4(1.0f);
+    skyboxMatrix = glm::translate(skyboxMatrix, glm::vec3(50.0f, 0.0f, 50.0f));
+    skyboxMatrix = glm::rotate(skyboxMatrix, glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    skyboxMatrix = glm::rotate(skyboxMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    skyboxMatrix = glm::scale(skyboxMatrix, glm::vec3(1000.0f));
+    skyboxTransform = transforms.Add(skyboxMatrix);
+
+    glm::mat4 logoMatrix = glm::mat4(1.0f);
+    logoMatrix = glm::translate(logoMatrix, glm::vec3(20.0f, 4.5f, 20.0f));
+    logoMatrix = glm::scale(logoMatrix, glm::vec3(100.0f));
+    logoTransform = transforms.Add(logoMatrix);
+
+    glm::mat4 fieldMatrix = glm::mat4(1.0f);
+    fieldMatrix = glm::translate(fieldMatrix, glm::vec3(125.0f, -2.0f, 130.0f));
+    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(120.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    fieldMatrix = glm::scale(fieldMatrix, glm::vec3(2.0f));
+    fieldTransform = transforms.Add(fieldMatrix);
+
+    glm::mat4 lamp1Matrix = glm::mat4(1.0f);
+    lamp1Matrix = glm::translate(lamp1Matrix, posLamp1);
+    lamp1Matrix = glm::rotate(lamp1Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    lamp1Matrix = glm::rotate(lamp1Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    lamp1Matrix = glm::scale(lamp1Matrix, glm::vec3(0.08f));
+    lamp1Transform = transforms.Add(lamp1Matrix);
+
+    glm::mat4 lamp2Matrix = glm::mat4(1.0f);
+    lamp2Matrix = glm::translate(lamp2Matrix, posLamp2);
+    lamp2Matrix = glm::rotate(lamp2Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    lamp2Matrix = glm::rotate(lamp2Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    lamp2Matrix = glm::scale(lamp2Matrix, glm::vec3(0.08f));
+    lamp2Transform = transforms.Add(lamp2Matrix);
+
+    // Objetos que siguen a la cámara: su matriz se actualiza cada cuadro al dibujarlos
+    deagleTransform = transforms.Add();
+    m4Transform = transforms.Add();
+    bayonetTransform = transforms.Add();
+    reticleTransform = transforms.Add();
+    shootDeagleTransform = transforms.Add();
+    shootM4Transform = transforms.Add();
+}
+
+// Envía al shader la matriz de modelo y la matriz normal precalculada del objeto
+void setModelTransform(Shader& shader, unsigned int transformId) {
+    const ObjectTransform& transform = transforms.Get(transformId);
+    shader.setMat4("model", transform.World);
+    shader.setMat3("normalMatrix", transform.Normal);
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -447,6 +1295,33 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastY = ypos;
 
     camera.ProcessMouseMovement(xoffset, yoffset);
+    recordCameraState(eventTime());
+}
+
+// glfw: los clics se guardan con su instante para resolver el disparo con el estado de ese momento.
+// GLFW entrega los eventos dentro de glfwPollEvents, hasta un cuadro después de que ocurren: el instante es el del
+// mensaje de Windows que se está despachando, no el del sondeo.
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        double time = eventTime();
+        recordCameraState(time);
+        pendingClicks.push_back(time);
+    }
+}
+
+// Toma a la vez los dos relojes, una sola vez; desde entonces los instantes de los mensajes se pasan con ese desfase
+void startEventClock() {
+    eventTickBase = GetTickCount();
+    eventTimeBase = glfwGetTime();
+}
+
+// Instante, en el reloj de glfwGetTime(), del mensaje de Windows que GLFW está despachando; solo vale dentro de los
+// callbacks. GetMessageTime() cuenta milisegundos del reloj de GetTickCount() (resolución de unos 16 ms) y da la
+// vuelta cada 49 días, de ahí la resta sin signo. Nunca queda después del instante actual.
+double eventTime() {
+    DWORD ticks = (DWORD)GetMessageTime() - eventTickBase;
+    return glm::min(eventTimeBase + ticks / 1000.0, glfwGetTime());
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
@@ -500,7 +1375,8 @@ void drawDeagle(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& d
     pistolaMatrix = glm::rotate(pistolaMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     pistolaMatrix = glm::scale(pistolaMatrix, glm::vec3(0.06f));
     pistolaMatrix = glm::inverse(view) * pistolaMatrix;
-    shader.setMat4("model", pistolaMatrix);
+    transforms.Set(deagleTransform, pistolaMatrix);
+    setModelTransform(shader, deagleTransform);
     deagle.Draw(shader);
 }
 
@@ -511,7 +1387,8 @@ void drawM4(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& m4) {
     armaMatrix = glm::rotate(armaMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     armaMatrix = glm::scale(armaMatrix, glm::vec3(0.04f));
     armaMatrix = glm::inverse(view) * armaMatrix;
-    shader.setMat4("model", armaMatrix);
+    transforms.Set(m4Transform, armaMatrix);
+    setModelTransform(shader, m4Transform);
     m4.Draw(shader);
 }
 
@@ -523,20 +1400,10 @@ void drawBayonet(Shader& shader, glm::mat4& view, glm::mat4& projection, Model&
     cuchilloMatrix = glm::rotate(cuchilloMatrix, glm::radians(18.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     cuchilloMatrix = glm::scale(cuchilloMatrix, glm::vec3(0.05f));
     cuchilloMatrix = glm::inverse(view) * cuchilloMatrix;
-    shader.setMat4("model", cuchilloMatrix);
+    transforms.Set(bayonetTransform, cuchilloMatrix);
+    setModelTransform(shader, bayonetTransform);
     bayonet.Draw(shader);
 }
-// Dibujar Skybox
-void drawSkybox(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& skybox) {
-    glm::mat4 skyboxMatrix = glm::mat4(1.0f);
-    skyboxMatrix = glm::translate(skyboxMatrix, glm::vec3(50.0f, 0.0f, 50.0f));
-    skyboxMatrix = glm::rotate(skyboxMatrix, glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    skyboxMatrix = glm::rotate(skyboxMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    skyboxMatrix = glm::scale(skyboxMatrix, glm::vec3(1000.0f));
-    shader.setMat4("model", skyboxMatrix);
-    skybox.Draw(shader);
-}
-
 // Dibujar Disparo Deagle
 void drawShootDeagle(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& shootDeagle) {
     glm::mat4 shootDeagleMatrix = glm::mat4(1.0f);
@@ -545,7 +1412,8 @@ void drawShootDeagle(Shader& shader, glm::mat4& view, glm::mat4& projection, Mod
     shootDeagleMatrix = glm::rotate(shootDeagleMatrix, glm::radians(-45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     shootDeagleMatrix = glm::scale(shootDeagleMatrix, glm::vec3(0.001f));
     shootDeagleMatrix = glm::inverse(view) * shootDeagleMatrix;
-    shader.setMat4("model", shootDeagleMatrix);
+    transforms.Set(shootDeagleTransform, shootDeagleMatrix);
+    setModelTransform(shader, shootDeagleTransform);
     shootDeagle.Draw(shader);
 }
 
@@ -557,7 +1425,8 @@ void drawShootM4(Shader& shader, glm::mat4& view, glm::mat4& projection, Model&
     shootM4Matrix = glm::rotate(shootM4Matrix, glm::radians(-45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     shootM4Matrix = glm::scale(shootM4Matrix, glm::vec3(0.001f));
     shootM4Matrix = glm::inverse(view) * shootM4Matrix;
-    shader.setMat4("model", shootM4Matrix);
+    transforms.Set(shootM4Transform, shootM4Matrix);
+    setModelTransform(shader, shootM4Transform);
     shootM4.Draw(shader);
 }
 
@@ -569,49 +1438,7 @@ void drawReticle(Shader& shader, glm::mat4& view, glm::mat4& projection, Model&
     reticleMatrix = glm::rotate(reticleMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 1.0f));
     reticleMatrix = glm::scale(reticleMatrix, glm::vec3(0.0015f));
     reticleMatrix = glm::inverse(view) * reticleMatrix;
-    shader.setMat4("model", reticleMatrix);
+    transforms.Set(reticleTransform, reticleMatrix);
+    setModelTransform(shader, reticleTransform);
     reticle2d.Draw(shader);
-}
-
-  // Dibujar Logo
-void drawLogo(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& logo) {
-    glm::mat4 logoMatrix = glm::mat4(1.0f);
-    logoMatrix = glm::translate(logoMatrix, glm::vec3(20.0f, 4.5f, 20.0f));
-    logoMatrix = glm::scale(logoMatrix, glm::vec3(100.0f));
-    shader.setMat4("model", logoMatrix);
-    logo.Draw(shader);
-}
-
-// Dibujar Field
-void drawField(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& field) {
-    glm::mat4 fieldMatrix = glm::mat4(1.0f);
-    fieldMatrix = glm::translate(fieldMatrix, glm::vec3(125.0f, -2.0f, 130.0f));
-    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(120.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    fieldMatrix = glm::scale(fieldMatrix, glm::vec3(2.0f));
-    shader.setMat4("model", fieldMatrix);
-    field.Draw(shader);
-}
-
-// Lampara 1
-void drawLamp1(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& lamp1) {
-    glm::mat4 lamp1Matrix = glm::mat4(1.0f);
-    lamp1Matrix = glm::translate(lamp1Matrix, posLamp1);
-    lamp1Matrix = glm::rotate(lamp1Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    lamp1Matrix = glm::rotate(lamp1Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    lamp1Matrix = glm::scale(lamp1Matrix, glm::vec3(0.08f));
-    shader.setMat4("model", lamp1Matrix);
-    lamp1.Draw(shader);
-}
-
-// Lampara 2
-void drawLamp2(Shader& shader, glm::mat4& view, glm::mat4& projection, Model& lamp2) {
-    glm::mat4 lamp2Matrix = glm::mat4(1.0f);
-    lamp2Matrix = glm::translate(lamp2Matrix, posLamp2);
-    lamp2Matrix = glm::rotate(lamp2Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    lamp2Matrix = glm::rotate(lamp2Matrix, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    lamp2Matrix = glm::scale(lamp2Matrix, glm::vec3(0.08f));
-    shader.setMat4("model", lamp2Matrix);
-    lamp2.Draw(shader);
 }
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+// Pasada de ids para la selección por GPU: objeto, malla, triángulo y coordenadas de textura de cada píxel
+layout (location = 0) out uvec4 PickId;
+
+in vec2 TexCoords;
+
+uniform int objectId;
+uniform int meshIndex;
+uniform float alphaCutoff; // 0 en las mallas opacas
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    // Los texeles transparentes no detienen el disparo, igual que en las consultas de rayos. La textura ya está
+    // completa: mientras el streamer muestra su marcador de 1x1 no se hace esta pasada (ver pickFromCamera)
+    if (alphaCutoff > 0.0 && textureLod(texture_diffuse1, TexCoords, 0.0).a < alphaCutoff)
+        discard;
+    // gl_PrimitiveID cuenta los triángulos desde el inicio de la llamada de dibujo, es decir, de la malla
+    uvec2 uv = uvec2(min(fract(TexCoords) * 65536.0, vec2(65535.0)));
+    PickId = uvec4(uint(objectId), uint(meshIndex), uint(gl_PrimitiveID), uv.x | (uv.y << 16));
+}
@@ -0,0 +1,162 @@
+// Headless model load benchmark and check: reads every model in the repository's model folder (or the given ones)
+// with each mesh loader Model can use and compares what they produce, with no GL context.
+//
+// Benchmark: the mesh stage of Model::Import (file to Vertex records, indices and material texture list) through
+// ASSIMP with no mesh cache (the cache is written, as on a first run), through the mesh cache ASSIMP leaves
+// behind, and through the native glTF loader (LoadGltf, without the fallback to ASSIMP). Texture decoding and the
+// BVHs are the same for all of them and left out, and so is the GPU upload, which needs a context: the glTF
+// loader's meshes upload their file's buffer as it is (see VertexSource) instead of one interleaved copy per mesh.
+//
+// Check: the mesh cache and the glTF loader must give the same meshes as ASSIMP, in the same order: identical
+// positions, normals and indices, texture coordinates within 1e-6 (ASSIMP flips v twice) and the same textures and
+// alpha cutoffs. Tangents are not compared; the shaders don't read them. Any difference makes the run exit with
+// status 1.
+//
+// Not part of the game project; tools/CMakeLists.txt builds it. Run it from the OpenGL folder so the default model
+// paths resolve.
+// Usage: load_bench [repetitions] [model.gltf ...]
+#include <learnopengl/model.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <learnopengl/stb_image.h>
+using namespace std;
+
+static double seconds()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// best of repetitions runs of one loader; meshes gets the last run's result
+template <typename Loader>
+static double measure(int repetitions, vector<ImportedMesh>& meshes, bool& read, Loader load)
+{
+    double best = 1e30;
+    for (int r = 0; r < repetitions; r++)
+    {
+        meshes.clear();
+        double start = seconds();
+        read = load(meshes);
+        best = min(best, seconds() - start);
+    }
+    return best;
+}
+
+// differences between another loader's meshes and ASSIMP's, printed per mesh
+static unsigned long long compare(const vector<ImportedMesh>& assimp, const vector<ImportedMesh>& other, const char* name)
+{
+    if (assimp.size() != other.size())
+    {
+        printf("  %zu meshes from ASSIMP, %zu from the %s\n", assimp.size(), other.size(), name);
+        return 1;
+    }
+    unsigned long long failures = 0;
+    for (size_t m = 0; m < assimp.size(); m++)
+    {
+        const ImportedMesh& a = assimp[m];
+        const ImportedMesh& g = other[m];
+        if (a.Vertices.size() != g.Vertices.size() || a.Indices != g.Indices)
+        {
+            printf("  %s mesh %zu: %zu / %zu vertices, %zu / %zu indices%s\n", name, m, a.Vertices.size(), g.Vertices.size(), a.Indices.size(),
+                   g.Indices.size(), a.Indices.size() == g.Indices.size() ? ", different" : "");
+            failures++;
+            continue;
+        }
+        unsigned long long vertices = 0;
+        for (size_t v = 0; v < a.Vertices.size(); v++)
+            if (a.Vertices[v].Position != g.Vertices[v].Position || a.Vertices[v].Normal != g.Vertices[v].Normal ||
+                glm::length(a.Vertices[v].TexCoords - g.Vertices[v].TexCoords) > 1e-6f)
+                vertices++;
+        bool textures = a.Textures.size() == g.Textures.size();
+        for (size_t t = 0; textures && t < a.Textures.size(); t++)
+            textures = a.Textures[t].Type == g.Textures[t].Type && a.Textures[t].Path == g.Textures[t].Path && a.Textures[t].Cutoff == g.Textures[t].Cutoff;
+        if (vertices > 0 || !textures)
+            printf("  %s mesh %zu: %llu vertices differ%s\n", name, m, vertices, textures ? "" : ", textures differ");
+        failures += vertices + (textures ? 0 : 1);
+    }
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    int repetitions = argc > 1 ? max(atoi(argv[1]), 1) : 5;
+    vector<string> paths;
+    for (int i = 2; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        paths.push_back("model/target/target.gltf");
+        paths.push_back("model/field/scene.gltf");
+        paths.push_back("model/m4/m4.gltf");
+        paths.push_back("model/deagle/deagle.gltf");
+        paths.push_back("model/skybox/skybox.gltf");
+        paths.push_back("model/logo/logo.gltf");
+        paths.push_back("model/bayonet/bayonet.gltf");
+        paths.push_back("model/lamp/lamp.gltf");
+        paths.push_back("model/mira4/miragreen.gltf");
+        paths.push_back("model/mira4/scene.gltf");
+        paths.push_back("model/shoot/shootD.gltf");
+        paths.push_back("model/shoot/shootm.gltf");
+    }
+
+    unsigned long long failures = 0;
+    double totals[3] = { 0.0, 0.0, 0.0 };
+    printf("%-28s %9s %9s %12s %12s %12s\n", "model", "triangles", "in place", "assimp", "mesh cache", "gltf");
+    for (size_t p = 0; p < paths.size(); p++)
+    {
+        const string& path = paths[p];
+        vector<ImportedMesh> assimp, cached, gltf;
+        bool readAssimp, readCache, readGltf;
+        double times[3];
+        times[0] = measure(repetitions, assimp, readAssimp, [&](vector<ImportedMesh>& meshes) {
+            remove((path + ".mesh").c_str());
+            Model model;
+            return model.ReadMeshes(path, LOADER_ASSIMP, meshes);
+        });
+        times[1] = measure(repetitions, cached, readCache, [&](vector<ImportedMesh>& meshes) {
+            Model model;
+            return model.ReadMeshes(path, LOADER_ASSIMP, meshes);
+        });
+        times[2] = measure(repetitions, gltf, readGltf, [&](vector<ImportedMesh>& meshes) {
+            vector<shared_ptr<MappedFile> > buffers;  // what Upload would send to the GPU
+            return LoadGltf(path, meshes, buffers);
+        });
+        if (!readAssimp)
+        {
+            printf("%-28s could not be read\n", path.c_str());
+            continue;
+        }
+        size_t triangles = 0, direct = 0;
+        for (size_t m = 0; m < assimp.size(); m++)
+            triangles += assimp[m].Indices.size() / 3;
+        for (size_t m = 0; m < gltf.size(); m++)
+            direct += gltf[m].Source.Buffer >= 0;
+        printf("%-28s %9zu %3zu / %-3zu %9.3f ms %9.3f ms ", path.c_str(), triangles, direct, assimp.size(), times[0] * 1e3, times[1] * 1e3);
+        for (int l = 0; l < 2; l++)
+            totals[l] += times[l];
+        failures += compare(assimp, cached, "mesh cache");
+        // a file the glTF loader turns down goes to ASSIMP in the game; nothing to compare
+        if (!readGltf)
+        {
+            printf("%12s\n", "ASSIMP");
+            continue;
+        }
+        printf("%9.3f ms\n", times[2] * 1e3);
+        totals[2] += times[2];
+        failures += compare(assimp, gltf, "glTF loader");
+    }
+    printf("%-28s %9s %9s %9.3f ms %9.3f ms %9.3f ms\n", "total", "", "", totals[0] * 1e3, totals[1] * 1e3, totals[2] * 1e3);
+    if (failures > 0)
+    {
+        printf("FAILED: %llu mismatches\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,256 @@
+// Headless check of the GPU picking: draws the id pass (IdPicker) on an EGL context with no window and compares
+// every picked pixel with the ray the game would shoot through it, answered on the CPU by Model::IntersectClosest.
+//
+// The scene is the game's pickable models: the field, the two lamps and the logo where the game puts them, and a
+// cluster of targets placed so they overlap each other on screen at different depths. Every view aims the camera
+// at one target from the shooting line, and each pick takes PickResult::MAX_SAMPLES random pixels around the
+// center of the screen, like a wide spread shot. The ray of a pixel goes from the camera through the pixel's
+// center.
+//
+// A pixel whose object id differs from the CPU's is only excused when the two answers are within depth precision
+// of each other (the GPU's object is hit as near as the CPU's), or when the ray grazes a silhouette: the CPU answer
+// changes inside the pixel's footprint, which the rasterizer samples only at the center. Any other difference is a
+// mismatch and makes the run exit with status 1, and so does not getting a context.
+//
+// Not part of the game project; tools/CMakeLists.txt builds it where EGL is available. It runs on Mesa's llvmpipe
+// with no GPU (EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1), from the OpenGL folder so the model and shader
+// paths resolve.
+// Usage: pick_check [picks per view]
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <learnopengl/model.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/id_picker.h>
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <learnopengl/stb_image.h>
+using namespace std;
+
+// the game's viewport and projection
+static const int WIDTH = 1920, HEIGHT = 1080;
+
+// one pickable object: the id the picker draws it with is its index + 1
+struct PickObject {
+    Model* Source;
+    glm::mat4 World;
+    ObjectTransform Transform;
+};
+
+// a current OpenGL 3.3 core context with no surface: the surfaceless platform when EGL has it (no display server
+// needed), the default display otherwise
+static bool createContext()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    // the default surface type is a window, which the surfaceless platform doesn't have
+    const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint configs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0)
+        return false;
+    const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3, EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                         EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        return false;
+    return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+// the game's initial target pose, moved to position
+static glm::mat4 targetMatrix(const glm::vec3& position)
+{
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), position);
+    m = glm::rotate(m, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    m = glm::rotate(m, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(m, glm::vec3(0.2f));
+}
+
+static void addObject(vector<PickObject>& objects, Model& model, const glm::mat4& world)
+{
+    PickObject object;
+    object.Source = &model;
+    object.World = world;
+    object.Transform = ObjectTransform(world);
+    objects.push_back(object);
+}
+
+// the object id the CPU answers for a world space ray (0 for none) and where it hits; the rays go through the
+// models' BVHs in model space, so every object's t is on the same world space ray
+static unsigned int closestObject(const vector<PickObject>& objects, const glm::vec3& origin, const glm::vec3& dir, float& t)
+{
+    unsigned int best = 0;
+    t = FLT_MAX;
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        HitRecord hit;
+        const ObjectTransform& transform = objects[i].Transform;
+        if (objects[i].Source->IntersectClosest(transform.ToLocalPoint(origin), transform.ToLocalDirection(dir), hit, t))
+        {
+            t = hit.T;
+            best = i + 1;
+        }
+    }
+    return best;
+}
+
+// where the ray of one object hits it, FLT_MAX if it doesn't
+static float objectHit(const PickObject& object, const glm::vec3& origin, const glm::vec3& dir)
+{
+    HitRecord hit;
+    if (!object.Source->IntersectClosest(object.Transform.ToLocalPoint(origin), object.Transform.ToLocalDirection(dir), hit))
+        return FLT_MAX;
+    return hit.T;
+}
+
+// the ray from the camera through a point of the window (origin at the bottom left, like gl_FragCoord)
+static glm::vec3 pixelDirection(const glm::mat4& inverseViewProjection, const glm::vec3& eye, const glm::vec2& pixel)
+{
+    glm::vec2 ndc = pixel / glm::vec2(WIDTH, HEIGHT) * 2.0f - 1.0f;
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+    return glm::normalize(glm::vec3(farPoint) / farPoint.w - eye);
+}
+
+int main(int argc, char** argv)
+{
+    int picksPerView = argc > 1 ? atoi(argv[1]) : 8;
+    if (!createContext())
+    {
+        printf("no OpenGL 3.3 context through EGL\n");
+        return 1;
+    }
+    printf("%s\n", (const char*)glGetString(GL_RENDERER));
+    IdPicker picker;
+    if (!picker.Init("shaders/pick_id.vs", "shaders/pick_id.fs"))
+    {
+        printf("the id framebuffer is not complete\n");
+        return 1;
+    }
+    glEnable(GL_DEPTH_TEST);
+
+    // the textures are uploaded right away (no streamer), so the id pass alpha tests the real texels
+    Model target, field, lamp, logo;
+    target.Import("model/target/target.gltf");
+    field.Import("model/field/scene.gltf");
+    lamp.Import("model/lamp/lamp.gltf");
+    logo.Import("model/logo/logo.gltf");
+    target.Upload();
+    field.Upload();
+    lamp.Upload();
+    logo.Upload();
+
+    // the field, lamps and logo as initSceneTransforms places them
+    vector<PickObject> objects;
+    glm::mat4 fieldMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(125.0f, -2.0f, 130.0f));
+    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(120.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    fieldMatrix = glm::rotate(fieldMatrix, glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    addObject(objects, field, glm::scale(fieldMatrix, glm::vec3(2.0f)));
+    const glm::vec3 lamps[2] = { glm::vec3(6.5f, -1.2f, 20.0f), glm::vec3(32.5f, -1.0f, 20.0f) };
+    for (int i = 0; i < 2; i++)
+    {
+        glm::mat4 lampMatrix = glm::translate(glm::mat4(1.0f), lamps[i]);
+        lampMatrix = glm::rotate(lampMatrix, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        lampMatrix = glm::rotate(lampMatrix, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        addObject(objects, lamp, glm::scale(lampMatrix, glm::vec3(0.08f)));
+    }
+    addObject(objects, logo, glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(20.0f, 4.5f, 20.0f)), glm::vec3(100.0f)));
+
+    // targets in rows at growing depth, each row shifted so the ones behind peek out between the ones in front
+    unsigned int firstTarget = (unsigned int)objects.size();
+    for (int row = 0; row < 3; row++)
+        for (int column = 0; column < 5; column++)
+            addObject(objects, target, targetMatrix(glm::vec3(30.0f + row * 4.0f, 1.5f + row * 0.6f, 44.0f + column * 3.0f + row * 1.4f)));
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> offset(-0.45f * IdPicker::MAX_REGION, 0.45f * IdPicker::MAX_REGION);
+    glm::mat4 projection = glm::perspective(glm::radians(ZOOM), (float)WIDTH / (float)HEIGHT, 0.1f, 1500.0f);
+    unsigned long long samples = 0, hits = 0, ties = 0, edges = 0, mismatches = 0;
+    for (unsigned int aim = firstTarget; aim < objects.size(); aim++)
+    {
+        // from the shooting line towards the target's center
+        glm::vec3 center = glm::vec3(objects[aim].World * glm::vec4((target.Bounds.min + target.Bounds.max) * 0.5f, 1.0f));
+        glm::vec3 eye(20.0f, 3.2f, center.z);
+        glm::vec3 front = glm::normalize(center - eye);
+        Camera camera(eye, glm::vec3(0.0f, 1.0f, 0.0f), glm::degrees(atan2f(front.z, front.x)), glm::degrees(asinf(front.y)));
+        glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+
+        for (int p = 0; p < picksPerView; p++)
+        {
+            glm::vec2 pixels[PickResult::MAX_SAMPLES];
+            for (int i = 0; i < PickResult::MAX_SAMPLES; i++)
+                pixels[i] = glm::floor(glm::vec2(WIDTH, HEIGHT) * 0.5f + glm::vec2(offset(gen), offset(gen))) + 0.5f;
+            bool sent = picker.Pick(view, projection, glm::ivec2(WIDTH, HEIGHT), pixels, PickResult::MAX_SAMPLES, [&](Shader& shader) {
+                for (unsigned int i = 0; i < objects.size(); i++)
+                    picker.DrawModel(shader, *objects[i].Source, objects[i].World, i + 1);
+            });
+            PickResult result;
+            glFinish();
+            if (!sent || !picker.Poll(result))
+            {
+                printf("the pick did not come back\n");
+                return 1;
+            }
+
+            for (int i = 0; i < result.Count; i++)
+            {
+                glm::vec3 dir = pixelDirection(inverseViewProjection, camera.Position, pixels[i]);
+                float t;
+                unsigned int expected = closestObject(objects, camera.Position, dir, t);
+                unsigned int picked = result.Samples[i].Object;
+                samples++;
+                hits += expected != 0;
+                if (picked == expected)
+                    continue;
+                if (picked != 0 && expected != 0 && objectHit(objects[picked - 1], camera.Position, dir) <= t * 1.001f)
+                {
+                    ties++;
+                    continue;
+                }
+                bool edge = false;
+                for (int corner = 0; corner < 4 && !edge; corner++)
+                {
+                    glm::vec2 inside = pixels[i] + glm::vec2(corner & 1 ? 0.45f : -0.45f, corner & 2 ? 0.45f : -0.45f);
+                    float cornerT;
+                    edge = closestObject(objects, camera.Position, pixelDirection(inverseViewProjection, camera.Position, inside), cornerT) != expected;
+                }
+                if (edge)
+                {
+                    edges++;
+                    continue;
+                }
+                if (mismatches < 10)
+                    printf("  mismatch: view of object %u, pixel (%.1f, %.1f): picked %u, ray hits %u at t = %.3f\n", aim + 1, pixels[i].x,
+                           pixels[i].y, picked, expected, t);
+                mismatches++;
+            }
+        }
+    }
+    printf("%llu pixels, %llu on an object: %llu depth ties, %llu silhouette pixels, %llu mismatches\n", samples, hits, ties, edges,
+           mismatches);
+    if (mismatches > 0)
+    {
+        printf("FAILED\n");
+        return 1;
+    }
+    printf("all picks agree\n");
+    return 0;
+}
@@ -0,0 +1,698 @@
+// Headless ray cast benchmark and differential check: builds the mesh BVHs of the given models (the game's pickable
+// models by default) with no GL context and shoots the same rays through the binary node layout and the compressed
+// 4-wide one (BVH::Compress).
+//
+// Benchmark: random rays (from a sphere around the model towards points of its bounds, like shots from any side)
+// and coherent rays (a camera's pixel grid, in tiles of one packet) through the closest hit, any hit, packet any
+// hit, packet closest hit and all hits queries. Reports node memory per triangle, rays per second, node visits and
+// triangle tests per ray.
+//
+// Check: every accelerated path is compared with a brute force loop over all triangles with the selected kernel's
+// scalar test (TriangleSoA::IntersectOne), which is itself compared with the same test in double precision. Besides the
+// benchmark rays the check shoots axis aligned rays (infinite 1/dir), rays aimed at vertices and edges of the mesh, and
+// rays starting inside the bounds. Answers may only differ where the ray grazes a triangle (passes within rounding of
+// an edge or runs parallel to it); any other difference is a mismatch and makes the run exit with status 1.
+//
+// Not part of the game project; tools/CMakeLists.txt builds it, with AVX2. Run it from the OpenGL folder so the
+// default model paths resolve. Configure with -DTRIANGLE_SOA_KERNEL=MOLLER_TRUMBORE or SCALAR to check the other
+// kernels.
+// Usage: raycast_bench [rays] [checked rays] [model.gltf ...]
+#define BVH_COUNT_VISITS
+
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <learnopengl/bvh.h>
+
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+// BVH::Build only reads the positions
+struct BenchVertex {
+    glm::vec3 Position;
+};
+
+struct BenchMesh {
+    vector<BenchVertex> vertices;
+    vector<unsigned int> indices;
+    TriangleSoA triangles;  // in index buffer order, for the brute force loop
+};
+
+struct RaySet {
+    const char* Name;
+    vector<glm::vec3> Origins;
+    vector<glm::vec3> Directions;
+};
+
+// loads the meshes the same way Model does (one BVH per assimp mesh, in model space)
+static bool loadMeshes(const string& path, vector<BenchMesh>& meshes)
+{
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        printf("ERROR::ASSIMP:: %s\n", importer.GetErrorString());
+        return false;
+    }
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh* mesh = scene->mMeshes[m];
+        BenchMesh out;
+        out.vertices.resize(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+            out.vertices[i].Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+            if (mesh->mFaces[f].mNumIndices == 3)
+                for (unsigned int k = 0; k < 3; k++)
+                    out.indices.push_back(mesh->mFaces[f].mIndices[k]);
+        vector<unsigned int> order(out.indices.size() / 3);
+        for (unsigned int i = 0; i < order.size(); i++)
+            order[i] = i;
+        out.triangles.Build(out.vertices, out.indices, order);
+        meshes.push_back(out);
+    }
+    return true;
+}
+
+static glm::vec3 randomDirection(mt19937& rng)
+{
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    glm::vec3 d;
+    do
+        d = glm::vec3(unit(rng), unit(rng), unit(rng));
+    while (glm::dot(d, d) > 1.0f || glm::dot(d, d) < 0.0001f);
+    return glm::normalize(d);
+}
+
+// rays from a sphere around the model towards random points of its bounds, like shots at it from any side
+static void makeRandomRays(const AABB& bounds, unsigned int count, RaySet& set)
+{
+    mt19937 rng(1234);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    glm::vec3 center = bounds.Center();
+    glm::vec3 extent = bounds.max - bounds.min;
+    float radius = glm::length(extent);
+    set.Name = "random";
+    set.Origins.resize(count);
+    set.Directions.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        set.Origins[i] = center + randomDirection(rng) * radius;
+        glm::vec3 aim = center + 0.5f * extent * glm::vec3(unit(rng), unit(rng), unit(rng));
+        set.Directions[i] = aim - set.Origins[i];
+    }
+}
+
+// primary rays of cameras around the model, 256 x 256 pixels each over the model's silhouette. The pixels go in
+// 4 x 4 tiles so every packet of the batched query holds neighbouring rays.
+static void makeCoherentRays(const AABB& bounds, unsigned int count, RaySet& set)
+{
+    const unsigned int SIDE = 256, TILE = 4;
+    mt19937 rng(5678);
+    glm::vec3 center = bounds.Center();
+    float radius = glm::length(bounds.max - bounds.min);
+    set.Name = "coherent";
+    set.Origins.resize(count);
+    set.Directions.resize(count);
+    glm::vec3 eye(0.0f), right(0.0f), up(0.0f), forward(0.0f);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int pixel = i % (SIDE * SIDE);
+        if (pixel == 0)
+        {
+            forward = randomDirection(rng);
+            eye = center - forward * (2.0f * radius);
+            right = glm::normalize(glm::cross(forward, fabsf(forward.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+            up = glm::cross(right, forward);
+        }
+        unsigned int tile = pixel / (TILE * TILE), inTile = pixel % (TILE * TILE);
+        unsigned int x = tile % (SIDE / TILE) * TILE + inTile % TILE;
+        unsigned int y = tile / (SIDE / TILE) * TILE + inTile / TILE;
+        // half the model's diagonal fills the view at the model's distance
+        float sx = ((x + 0.5f) / SIDE - 0.5f) * 0.55f, sy = ((y + 0.5f) / SIDE - 0.5f) * 0.55f;
+        set.Origins[i] = eye;
+        set.Directions[i] = forward + sx * right + sy * up;
+    }
+}
+
+// rays along the axes through the bounds: two components of the direction are zero, so 1/dir is infinite
+static void makeAxisRays(const AABB& bounds, unsigned int count, RaySet& set)
+{
+    mt19937 rng(91011);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec3 extent = bounds.max - bounds.min;
+    set.Name = "axis";
+    set.Origins.resize(count);
+    set.Directions.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        int axis = i % 3;
+        float sign = (i / 3) % 2 ? 1.0f : -1.0f;
+        glm::vec3 origin = bounds.min + extent * glm::vec3(unit(rng), unit(rng), unit(rng));
+        origin[axis] = sign > 0.0f ? bounds.min[axis] - extent[axis] : bounds.max[axis] + extent[axis];
+        glm::vec3 direction(0.0f);
+        direction[axis] = sign;
+        set.Origins[i] = origin;
+        set.Directions[i] = direction;
+    }
+}
+
+// rays at the vertices and edges of random triangles, where neighbouring triangles meet and the tests disagree
+// most easily
+static void makeEdgeRays(const vector<BenchMesh>& meshes, const AABB& bounds, unsigned int count, RaySet& set)
+{
+    mt19937 rng(121314);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float radius = glm::length(bounds.max - bounds.min);
+    set.Name = "edges";
+    set.Origins.resize(count);
+    set.Directions.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const BenchMesh* mesh;
+        do
+            mesh = &meshes[rng() % meshes.size()];
+        while (mesh->indices.empty());
+        unsigned int triangle = rng() % (mesh->indices.size() / 3);
+        glm::vec3 a = mesh->vertices[mesh->indices[triangle * 3 + rng() % 3]].Position;
+        glm::vec3 b = mesh->vertices[mesh->indices[triangle * 3 + rng() % 3]].Position;
+        glm::vec3 aim = i % 2 ? a : glm::mix(a, b, unit(rng));
+        set.Origins[i] = aim + randomDirection(rng) * radius;
+        set.Directions[i] = aim - set.Origins[i];
+    }
+}
+
+// rays starting anywhere inside the bounds, in any direction
+static void makeInsideRays(const AABB& bounds, unsigned int count, RaySet& set)
+{
+    mt19937 rng(151617);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec3 extent = bounds.max - bounds.min;
+    set.Name = "inside";
+    set.Origins.resize(count);
+    set.Directions.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        set.Origins[i] = bounds.min + extent * glm::vec3(unit(rng), unit(rng), unit(rng));
+        set.Directions[i] = randomDirection(rng);
+    }
+}
+
+// about count rays of a set, whole packets taken evenly across it, so the check sees all of a camera's pixels
+static void sampleRays(const RaySet& set, unsigned int count, RaySet& sample)
+{
+    size_t packets = (set.Origins.size() + BVH::PACKET_SIZE - 1) / BVH::PACKET_SIZE;
+    size_t wanted = glm::max((count + BVH::PACKET_SIZE - 1) / BVH::PACKET_SIZE, 1u);
+    size_t step = glm::max(packets / wanted, (size_t)1);
+    sample.Name = set.Name;
+    sample.Origins.clear();
+    sample.Directions.clear();
+    for (size_t packet = 0; packet < packets && sample.Origins.size() < count; packet += step)
+        for (size_t r = packet * BVH::PACKET_SIZE; r < min((packet + 1) * BVH::PACKET_SIZE, set.Origins.size()); r++)
+        {
+            sample.Origins.push_back(set.Origins[r]);
+            sample.Directions.push_back(set.Directions[r]);
+        }
+}
+
+static double seconds()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// one line of the benchmark: query runs every ray through all meshes and returns 1 for a hit
+template <typename Query>
+static void measure(const char* query, const RaySet& set, Query run)
+{
+    BVH::VisitCount() = 0;
+    BVH::TriangleCount() = 0;
+    unsigned int hits = 0;
+    double start = seconds();
+    hits = run();
+    double elapsed = seconds() - start;
+    double rays = (double)set.Origins.size();
+    printf("    %-9s %-8s %7.2f Mrays/s  %6.1f nodes/ray  %7.1f tris/ray  hits %u\n", set.Name, query, rays / elapsed * 1e-6,
+           BVH::VisitCount() / rays, BVH::TriangleCount() / rays, hits);
+}
+
+static void bench(const vector<BVH>& bvhs, const RaySet& set)
+{
+    size_t count = set.Origins.size();
+    measure("closest", set, [&]() {
+        unsigned int hits = 0;
+        for (size_t r = 0; r < count; r++)
+        {
+            HitRecord hit;
+            float tMax = FLT_MAX;
+            bool found = false;
+            for (size_t i = 0; i < bvhs.size(); i++)
+            {
+                if (bvhs[i].IntersectClosest(set.Origins[r], set.Directions[r], hit, tMax))
+                {
+                    tMax = hit.T;
+                    found = true;
+                }
+            }
+            hits += found;
+        }
+        return hits;
+    });
+    measure("any", set, [&]() {
+        unsigned int hits = 0;
+        for (size_t r = 0; r < count; r++)
+        {
+            bool found = false;
+            for (size_t i = 0; i < bvhs.size() && !found; i++)
+                found = bvhs[i].IntersectAny(set.Origins[r], set.Directions[r]);
+            hits += found;
+        }
+        return hits;
+    });
+    measure("packet", set, [&]() {
+        unsigned int hits = 0;
+        Ray rays[BVH::PACKET_SIZE];
+        bool packetHits[BVH::PACKET_SIZE], found[BVH::PACKET_SIZE];
+        for (size_t first = 0; first < count; first += BVH::PACKET_SIZE)
+        {
+            unsigned int n = (unsigned int)min((size_t)BVH::PACKET_SIZE, count - first);
+            for (unsigned int k = 0; k < n; k++)
+            {
+                rays[k] = Ray(set.Origins[first + k], set.Directions[first + k]);
+                found[k] = false;
+            }
+            for (size_t i = 0; i < bvhs.size(); i++)
+            {
+                bvhs[i].IntersectAny(rays, n, packetHits);
+                for (unsigned int k = 0; k < n; k++)
+                    found[k] |= packetHits[k];
+            }
+            for (unsigned int k = 0; k < n; k++)
+                hits += found[k];
+        }
+        return hits;
+    });
+    measure("pclosest", set, [&]() {
+        unsigned int hits = 0;
+        Ray rays[BVH::PACKET_SIZE];
+        HitRecord closest[BVH::PACKET_SIZE];
+        bool packetHits[BVH::PACKET_SIZE], found[BVH::PACKET_SIZE];
+        for (size_t first = 0; first < count; first += BVH::PACKET_SIZE)
+        {
+            unsigned int n = (unsigned int)min((size_t)BVH::PACKET_SIZE, count - first);
+            for (unsigned int k = 0; k < n; k++)
+            {
+                rays[k] = Ray(set.Origins[first + k], set.Directions[first + k]);
+                found[k] = false;
+            }
+            for (size_t i = 0; i < bvhs.size(); i++)
+            {
+                bvhs[i].IntersectClosest(rays, n, closest, packetHits);
+                for (unsigned int k = 0; k < n; k++)
+                {
+                    if (packetHits[k])
+                    {
+                        rays[k].TMax = closest[k].T;
+                        found[k] = true;
+                    }
+                }
+            }
+            for (unsigned int k = 0; k < n; k++)
+                hits += found[k];
+        }
+        return hits;
+    });
+    measure("all", set, [&]() {
+        unsigned int hits = 0;
+        for (size_t r = 0; r < count; r++)
+        {
+            unsigned int layers = 0;
+            for (size_t i = 0; i < bvhs.size(); i++)
+                bvhs[i].IntersectAll(set.Origins[r], set.Directions[r], FLT_MAX, [&](HitRecord&) {
+                    layers++;
+                    return FLT_MAX;
+                });
+            hits += layers > 0;
+        }
+        return hits;
+    });
+}
+
+// The check's oracle: where the ray meets the triangle's plane, in double precision. Grazing means the float tests
+// may round either way: the ray passes closer to the triangle's border than their rounding, which grows with the
+// coordinates involved and as the ray turns parallel to the triangle, or it starts on the triangle.
+struct ExactHit {
+    bool Hit;
+    bool Grazing;
+    double T;
+};
+
+static ExactHit exactRayTriangle(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    // relative rounding allowed for the float tests, about a hundred float ulps
+    const double TOLERANCE = 1e-5;
+    ExactHit result = { false, false, 0.0 };
+    glm::dvec3 o(origin), d(dir), v0(a);
+    glm::dvec3 edge1 = glm::dvec3(b) - v0, edge2 = glm::dvec3(c) - v0, edge3 = glm::dvec3(c) - glm::dvec3(b);
+    glm::dvec3 normal = glm::cross(edge1, edge2);
+    double area2 = glm::length(normal);
+    if (area2 == 0.0)
+        return result; // degenerate triangles have no surface to hit
+    double dirLength = glm::length(d);
+    double sine = fabs(glm::dot(normal, d)) / (area2 * dirLength);
+    if (sine < TOLERANCE)
+    {
+        result.Grazing = true;
+        return result;
+    }
+    double determinant = glm::dot(normal, d);
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+    const double EPSILON = 0.0;
+#else
+    // Möller–Trumbore takes rays whose determinant is under its EPSILON (tiny triangles too, it is not relative)
+    // as parallel, and hits closer than EPSILON as misses; both are part of the contract being checked
+    const double EPSILON = 0.0000001;
+    if (fabs(determinant) < 2.0 * EPSILON)
+    {
+        result.Grazing = fabs(determinant) > 0.5 * EPSILON;
+        return result;
+    }
+#endif
+    result.T = glm::dot(normal, v0 - o) / determinant;
+    glm::dvec3 w = o + result.T * d - v0;
+    double u = glm::dot(glm::cross(w, edge2), normal) / (area2 * area2);
+    double v = glm::dot(glm::cross(edge1, w), normal) / (area2 * area2);
+    // signed distances to the three edges: barycentric times the height over that edge
+    double distance = min(min(u * area2 / glm::length(edge2), v * area2 / glm::length(edge1)), (1.0 - u - v) * area2 / glm::length(edge3));
+    double scale = glm::length(o - v0) + glm::length(edge1) + glm::length(edge2);
+    result.Hit = distance >= 0.0 && result.T > EPSILON;
+    result.Grazing = fabs(distance) < TOLERANCE * scale / sine || (distance > 0.0 && fabs(result.T) * dirLength < TOLERANCE * scale);
+    return result;
+}
+
+// triangle `triangle` of mesh `mesh`, as hit by the queries
+struct TriangleRef {
+    unsigned int Mesh;
+    unsigned int Triangle;
+    bool operator<(const TriangleRef& other) const
+    {
+        return Mesh != other.Mesh ? Mesh < other.Mesh : Triangle < other.Triangle;
+    }
+    bool operator==(const TriangleRef& other) const
+    {
+        return Mesh == other.Mesh && Triangle == other.Triangle;
+    }
+};
+
+// brute force answers for one ray
+struct Reference {
+    float T;                  // closest hit, FLT_MAX on a miss
+    TriangleRef Closest;
+    vector<TriangleRef> All;  // sorted
+};
+
+struct Mismatches {
+    unsigned long long Kernel, Closest, Any, Packet, All, Grazing;
+};
+
+static ExactHit exactHit(const vector<BenchMesh>& meshes, const glm::vec3& origin, const glm::vec3& dir, const TriangleRef& ref)
+{
+    const BenchMesh& mesh = meshes[ref.Mesh];
+    return exactRayTriangle(origin, dir, mesh.vertices[mesh.indices[ref.Triangle * 3]].Position, mesh.vertices[mesh.indices[ref.Triangle * 3 + 1]].Position,
+                            mesh.vertices[mesh.indices[ref.Triangle * 3 + 2]].Position);
+}
+
+static bool grazes(const vector<BenchMesh>& meshes, const glm::vec3& origin, const glm::vec3& dir, const TriangleRef& ref)
+{
+    return exactHit(meshes, origin, dir, ref).Grazing;
+}
+
+// true if the ray grazes any triangle; only asked about rays whose answers differ
+static bool grazesAny(const vector<BenchMesh>& meshes, const glm::vec3& origin, const glm::vec3& dir)
+{
+    for (unsigned int m = 0; m < meshes.size(); m++)
+        for (unsigned int t = 0; t < meshes[m].indices.size() / 3; t++)
+        {
+            TriangleRef ref = { m, t };
+            if (grazes(meshes, origin, dir, ref))
+                return true;
+        }
+    return false;
+}
+
+static void count(bool agrees, bool grazing, unsigned long long& mismatches, unsigned long long& grazed)
+{
+    if (agrees)
+        return;
+    grazing ? grazed++ : mismatches++;
+}
+
+// brute force over all triangles with the scalar kernel; every answer of it that disagrees with the double precision
+// test away from grazing counts as a kernel mismatch
+static Reference reference(const vector<BenchMesh>& meshes, const glm::vec3& origin, const glm::vec3& dir, Mismatches& mismatches)
+{
+    Reference ref;
+    ref.T = FLT_MAX;
+    ref.Closest.Mesh = ref.Closest.Triangle = 0;
+    TriangleSoA::PreparedRay ray(origin, dir);
+    for (unsigned int m = 0; m < meshes.size(); m++)
+    {
+        const BenchMesh& mesh = meshes[m];
+        for (unsigned int t = 0; t < mesh.indices.size() / 3; t++)
+        {
+            const glm::vec3& v0 = mesh.vertices[mesh.indices[t * 3]].Position;
+            const glm::vec3& v1 = mesh.vertices[mesh.indices[t * 3 + 1]].Position;
+            const glm::vec3& v2 = mesh.vertices[mesh.indices[t * 3 + 2]].Position;
+            float hitT, u, v;
+            bool hit = mesh.triangles.IntersectOne(ray, t, hitT, u, v);
+            ExactHit exact = exactRayTriangle(origin, dir, v0, v1, v2);
+            if (hit != exact.Hit)
+                count(false, exact.Grazing, mismatches.Kernel, mismatches.Grazing);
+            if (!hit)
+                continue;
+            TriangleRef tri = { m, t };
+            ref.All.push_back(tri);
+            if (hitT < ref.T)
+            {
+                ref.T = hitT;
+                ref.Closest = tri;
+            }
+        }
+    }
+    sort(ref.All.begin(), ref.All.end());
+    return ref;
+}
+
+// the closest hit agrees if the distances match, or if the one triangle the two answers disagree on is grazed
+static bool closestAgrees(const vector<BenchMesh>& meshes, const glm::vec3& origin, const glm::vec3& dir, const Reference& ref, bool found,
+                          float t, const TriangleRef& tri)
+{
+    if (!found && ref.T == FLT_MAX)
+        return true;
+    if (found && ref.T != FLT_MAX && fabsf(t - ref.T) <= 1e-4f * max(ref.T, 1.0f))
+        return true;
+    bool refCloser = !found || (ref.T != FLT_MAX && ref.T < t);
+    return refCloser ? grazes(meshes, origin, dir, ref.Closest) : grazes(meshes, origin, dir, tri);
+}
+
+static void check(const vector<BenchMesh>& meshes, const vector<BVH>& bvhs, const RaySet& set, const vector<Reference>& refs, Mismatches& mismatches)
+{
+    // the batched queries take the rays a packet at a time, as the benchmark does; the closest one carries each
+    // ray's cut-off from mesh to mesh
+    vector<char> packetHits(refs.size(), 0);
+    vector<char> packetFound(refs.size(), 0);
+    vector<TriangleRef> packetTris(refs.size());
+    vector<float> packetT(refs.size(), FLT_MAX);
+    for (size_t first = 0; first < refs.size(); first += BVH::PACKET_SIZE)
+    {
+        unsigned int n = (unsigned int)min((size_t)BVH::PACKET_SIZE, refs.size() - first);
+        Ray rays[BVH::PACKET_SIZE], closestRays[BVH::PACKET_SIZE];
+        bool hits[BVH::PACKET_SIZE];
+        HitRecord closest[BVH::PACKET_SIZE];
+        for (unsigned int k = 0; k < n; k++)
+            rays[k] = closestRays[k] = Ray(set.Origins[first + k], set.Directions[first + k]);
+        for (unsigned int i = 0; i < bvhs.size(); i++)
+        {
+            bvhs[i].IntersectAny(rays, n, hits);
+            for (unsigned int k = 0; k < n; k++)
+                packetHits[first + k] |= hits[k];
+            bvhs[i].IntersectClosest(closestRays, n, closest, hits);
+            for (unsigned int k = 0; k < n; k++)
+            {
+                if (!hits[k])
+                    continue;
+                closestRays[k].TMax = closest[k].T;
+                packetFound[first + k] = 1;
+                packetT[first + k] = closest[k].T;
+                packetTris[first + k].Mesh = i;
+                packetTris[first + k].Triangle = closest[k].Triangle;
+            }
+        }
+    }
+
+    for (size_t r = 0; r < refs.size(); r++)
+    {
+        const glm::vec3& origin = set.Origins[r];
+        const glm::vec3& dir = set.Directions[r];
+        const Reference& ref = refs[r];
+
+        HitRecord hit;
+        float tMax = FLT_MAX;
+        bool found = false;
+        TriangleRef tri = { 0, 0 };
+        for (unsigned int i = 0; i < bvhs.size(); i++)
+        {
+            if (bvhs[i].IntersectClosest(origin, dir, hit, tMax))
+            {
+                tMax = hit.T;
+                tri.Mesh = i;
+                tri.Triangle = hit.Triangle;
+                found = true;
+            }
+        }
+        if (!closestAgrees(meshes, origin, dir, ref, found, tMax, tri))
+            mismatches.Closest++;
+        if (!closestAgrees(meshes, origin, dir, ref, packetFound[r] != 0, packetT[r], packetTris[r]))
+            mismatches.Closest++;
+
+        bool any = false, packet = packetHits[r] != 0;
+        for (unsigned int i = 0; i < bvhs.size(); i++)
+            any |= bvhs[i].IntersectAny(origin, dir);
+        bool refAny = !ref.All.empty();
+        if (any != refAny || packet != refAny)
+        {
+            bool grazing = grazesAny(meshes, origin, dir);
+            count(any == refAny, grazing, mismatches.Any, mismatches.Grazing);
+            count(packet == refAny, grazing, mismatches.Packet, mismatches.Grazing);
+        }
+
+        vector<TriangleRef> all;
+        for (unsigned int i = 0; i < bvhs.size(); i++)
+            bvhs[i].IntersectAll(origin, dir, FLT_MAX, [&](HitRecord& h) {
+                TriangleRef layer = { i, h.Triangle };
+                all.push_back(layer);
+                return FLT_MAX;
+            });
+        sort(all.begin(), all.end());
+        if (all != ref.All)
+        {
+            vector<TriangleRef> differ;
+            set_symmetric_difference(all.begin(), all.end(), ref.All.begin(), ref.All.end(), back_inserter(differ));
+            bool grazing = true;
+            for (size_t k = 0; k < differ.size() && grazing; k++)
+                grazing = grazes(meshes, origin, dir, differ[k]);
+            count(false, grazing, mismatches.All, mismatches.Grazing);
+        }
+    }
+}
+
+static void printMemory(const char* layout, const vector<BVH>& bvhs, size_t triangles)
+{
+    size_t nodeBytes = 0, totalBytes = 0;
+    for (size_t i = 0; i < bvhs.size(); i++)
+    {
+        nodeBytes += bvhs[i].NodeBytes();
+        totalBytes += bvhs[i].NodeBytes() + bvhs[i].triangleCount * sizeof(unsigned int) + bvhs[i].triangles.MemoryBytes();
+    }
+    printf("  %s: nodes %.2f B/tri, total %.2f B/tri\n", layout, (double)nodeBytes / triangles, (double)totalBytes / triangles);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int rayCount = argc > 1 ? (unsigned int)atoi(argv[1]) : 1000000;
+    unsigned int checkCount = argc > 2 ? (unsigned int)atoi(argv[2]) : 5000;
+    vector<string> paths;
+    for (int i = 3; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        paths.push_back("model/target/target.gltf");
+        paths.push_back("model/field/scene.gltf");
+        paths.push_back("model/lamp/lamp.gltf");
+        paths.push_back("model/logo/logo.gltf");
+        paths.push_back("model/m4/m4.gltf");
+        paths.push_back("model/deagle/deagle.gltf");
+    }
+
+    unsigned long long failures = 0;
+    for (size_t p = 0; p < paths.size(); p++)
+    {
+        vector<BenchMesh> meshes;
+        if (!loadMeshes(paths[p], meshes))
+            continue;
+        vector<BVH> binary(meshes.size());
+        AABB bounds;
+        size_t triangles = 0;
+        double start = seconds();
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            binary[i].Build(meshes[i].vertices, meshes[i].indices);
+            bounds.Grow(binary[i].Bounds());
+            triangles += meshes[i].indices.size() / 3;
+        }
+        double buildTime = seconds() - start;
+        if (triangles == 0)
+            continue;
+        vector<BVH> compressed = binary;
+        start = seconds();
+        for (size_t i = 0; i < compressed.size(); i++)
+            compressed[i].Compress();
+        double compressTime = seconds() - start;
+
+        printf("%s: %zu triangles, %zu meshes, build %.1f ms, compress %.1f ms\n", paths[p].c_str(), triangles, meshes.size(),
+               buildTime * 1e3, compressTime * 1e3);
+        RaySet sets[5];
+        makeRandomRays(bounds, rayCount, sets[0]);
+        makeCoherentRays(bounds, rayCount, sets[1]);
+        makeAxisRays(bounds, checkCount, sets[2]);
+        makeEdgeRays(meshes, bounds, checkCount, sets[3]);
+        makeInsideRays(bounds, checkCount, sets[4]);
+
+        printMemory("binary", binary, triangles);
+        bench(binary, sets[0]);
+        bench(binary, sets[1]);
+        printMemory("wide", compressed, triangles);
+        bench(compressed, sets[0]);
+        bench(compressed, sets[1]);
+
+        // the same brute force answers are checked against both layouts
+        for (int s = 0; s < 5; s++)
+        {
+            RaySet set;
+            sampleRays(sets[s], checkCount, set);
+            size_t n = set.Origins.size();
+            Mismatches kernel = {};
+            vector<Reference> refs(n);
+            for (size_t r = 0; r < n; r++)
+                refs[r] = reference(meshes, set.Origins[r], set.Directions[r], kernel);
+            Mismatches layouts[2] = {};
+            check(meshes, binary, set, refs, layouts[0]);
+            check(meshes, compressed, set, refs, layouts[1]);
+            printf("  check %-9s %6zu rays: kernel %llu (%llu grazing)", set.Name, n, kernel.Kernel, kernel.Grazing);
+            for (int l = 0; l < 2; l++)
+            {
+                const Mismatches& m = layouts[l];
+                printf(", %s closest %llu any %llu packet %llu all %llu (%llu grazing)", l == 0 ? "binary" : "wide", m.Closest, m.Any, m.Packet,
+                       m.All, m.Grazing);
+                failures += m.Closest + m.Any + m.Packet + m.All;
+            }
+            printf("\n");
+            failures += kernel.Kernel;
+        }
+    }
+    if (failures > 0)
+    {
+        printf("FAILED: %llu mismatches\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,273 @@
+// Offline texture compression: encodes every image the game's models use (or the given models' images) into a
+// block compressed KTX2 file next to it (textures/wall.png -> textures/wall.png.ktx2), with the whole mip chain.
+// DecodeImage uploads that file instead of decoding the image, for as long as the image is unchanged. No GL
+// context needed.
+//
+// Formats by the channels an image uses (ChooseBlockFormat): BC5 for the models' normal maps (the materials'
+// normalTexture, which the game doesn't load yet; they are ready for a shader that samples them), BC4 for one channel
+// images, BC1 for opaque color and BC3 for color with alpha; with --bc7 opaque color goes to BC7. Grey and alpha
+// images are expanded to RGBA first, so they land in BC1 or BC3 like color. The mip levels are box filtered
+// (DownsampleImage) and every level is split into bands of block rows that are encoded on a ThreadPool.
+//
+// --check reads each written file back the way the game does and decodes level 0 on the CPU (DecompressBlocks):
+// the PSNR against the image, over the channels the format keeps, is printed, and a file that doesn't read back
+// or falls under 25 dB makes the run exit with status 1. So does the target's normal map not coming out as BC5 when
+// the default models are compressed.
+//
+// Not part of the game project; tools/CMakeLists.txt builds it. Run it from the OpenGL folder so the default model
+// paths resolve.
+// Usage: texture_compress [--bc7] [--check] [--threads n] [model.gltf ...]
+#include <learnopengl/model.h>
+#include <learnopengl/block_compress.h>
+#include <learnopengl/ktx2.h>
+#include <learnopengl/thread_pool.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <learnopengl/stb_image.h>
+using namespace std;
+
+static double seconds()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// one image on its way to a KTX2 file
+struct CompressJob {
+    string Path;
+    bool NormalMap;
+    bool Read;
+    uint64_t SourceHash;
+    int Width, Height, Components;
+    BlockFormat Format;
+    vector<vector<unsigned char> > Pixels;      // mip chain, level 0 first
+    vector<vector<unsigned char> > Compressed;  // the same levels encoded
+};
+
+// the images the materials of a .gltf file use as normal maps; the meshes' texture lists only have the maps the
+// game samples
+static void gltfNormalMaps(const string& path, vector<MaterialTexture>& textures)
+{
+    MappedFile file;
+    JsonValue doc;
+    if (!file.Open(path))
+        return;
+    JsonParser parser((const char*)file.Data(), (const char*)file.Data() + file.Size());
+    if (!parser.Parse(doc))
+        return;
+    const JsonValue& materials = doc.Get("materials");
+    for (int i = 0; i < materials.Size(); i++)
+        addGltfTexture(doc, materials.At(i).Get("normalTexture"), "texture_normal", -1.0f, textures);
+}
+
+// decodes the image, picks its format and builds its mip chain
+static void prepare(CompressJob& job, bool highQuality)
+{
+    MappedFile source;
+    int width, height, components;
+    unsigned char* data = source.Open(job.Path) ? stbi_load(job.Path.c_str(), &width, &height, &components, 0) : NULL;
+    job.Read = data != NULL;
+    if (!data)
+        return;
+    job.SourceHash = hashFileContents(source.Data(), source.Size());
+    int levels = MipLevelCount(width, height);
+    job.Pixels.resize(levels);
+    if (components == 2 && !job.NormalMap)
+    {
+        ExpandGreyAlpha(data, width, height, job.Pixels[0]);
+        components = 4;
+    }
+    else
+        job.Pixels[0].assign(data, data + (size_t)width * height * components);
+    stbi_image_free(data);
+    job.Width = width;
+    job.Height = height;
+    job.Components = components;
+    job.Format = ChooseBlockFormat(job.Pixels[0].data(), width, height, components, job.NormalMap, highQuality);
+    for (int level = 1; level < levels; level++)
+        DownsampleImage(job.Pixels[level - 1].data(), glm::max(width >> (level - 1), 1), glm::max(height >> (level - 1), 1), components,
+                        job.NormalMap, job.Pixels[level]);
+    job.Compressed.resize(levels);
+    for (int level = 0; level < levels; level++)
+        job.Compressed[level].resize(CompressedSize(job.Format, glm::max(width >> level, 1), glm::max(height >> level, 1)));
+}
+
+// PSNR of the decoded level 0 against the image, over the channels the format keeps
+static double psnr(const CompressJob& job, const vector<unsigned char>& decoded)
+{
+    int channels = job.Format == BLOCK_BC4 ? 1 : job.Format == BLOCK_BC5 ? 2 : job.Format == BLOCK_BC1 ? 3 : glm::min(job.Components, 4);
+    channels = glm::min(channels, job.Components);
+    double squared = 0.0;
+    size_t texels = (size_t)job.Width * job.Height;
+    for (size_t i = 0; i < texels; i++)
+        for (int c = 0; c < channels; c++)
+        {
+            double difference = (double)job.Pixels[0][i * job.Components + c] - decoded[i * 4 + c];
+            squared += difference * difference;
+        }
+    double mean = squared / (texels * channels);
+    return mean == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / mean);
+}
+
+int main(int argc, char** argv)
+{
+    bool highQuality = false, check = false;
+    unsigned int threads = 0;
+    vector<string> models;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bc7") == 0)
+            highQuality = true;
+        else if (strcmp(argv[i], "--check") == 0)
+            check = true;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = (unsigned int)atoi(argv[++i]);
+        else
+            models.push_back(argv[i]);
+    }
+    // a normal map the default models are known to have; --check makes sure it is found
+    const char* KNOWN_NORMAL_MAP = "model/target/textures/Target_normal.png";
+    bool defaults = models.empty();
+    if (defaults)
+    {
+        models.push_back("model/target/target.gltf");
+        models.push_back("model/field/scene.gltf");
+        models.push_back("model/m4/m4.gltf");
+        models.push_back("model/deagle/deagle.gltf");
+        models.push_back("model/skybox/skybox.gltf");
+        models.push_back("model/logo/logo.gltf");
+        models.push_back("model/bayonet/bayonet.gltf");
+        models.push_back("model/lamp/lamp.gltf");
+        models.push_back("model/mira4/miragreen.gltf");
+        models.push_back("model/mira4/scene.gltf");
+        models.push_back("model/shoot/shootD.gltf");
+        models.push_back("model/shoot/shootm.gltf");
+    }
+
+    // the images the models' materials refer to, each once
+    map<string, bool> images;
+    for (size_t m = 0; m < models.size(); m++)
+    {
+        Model model;
+        vector<ImportedMesh> meshes;
+        if (!model.ReadMeshes(models[m], LOADER_GLTF, meshes))
+            continue;
+        vector<MaterialTexture> textures;
+        for (size_t i = 0; i < meshes.size(); i++)
+            textures.insert(textures.end(), meshes[i].Textures.begin(), meshes[i].Textures.end());
+        gltfNormalMaps(models[m], textures);
+        string directory = models[m].substr(0, models[m].find_last_of('/'));
+        for (size_t t = 0; t < textures.size(); t++)
+        {
+            string path = directory + '/' + textures[t].Path;
+            images[path] = images[path] || textures[t].Type == "texture_normal";
+        }
+    }
+    vector<CompressJob> jobs;
+    for (map<string, bool>::const_iterator i = images.begin(); i != images.end(); ++i)
+    {
+        CompressJob job;
+        job.Path = i->first;
+        job.NormalMap = i->second;
+        jobs.push_back(job);
+    }
+
+    ThreadPool pool(threads);
+    double start = seconds();
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        CompressJob* job = &jobs[j];
+        pool.Submit([job, highQuality]() { prepare(*job, highQuality); });
+    }
+    pool.Wait();
+    double decoded = seconds();
+    // bands of 16 block rows (64 texel rows) of every level of every image
+    const int BAND_ROWS = 16;
+    for (size_t j = 0; j < jobs.size(); j++)
+        for (size_t level = 0; jobs[j].Read && level < jobs[j].Pixels.size(); level++)
+        {
+            CompressJob* job = &jobs[j];
+            int width = glm::max(job->Width >> level, 1), height = glm::max(job->Height >> level, 1);
+            for (int row = 0; row < (height + 3) / 4; row += BAND_ROWS)
+            {
+                int last = glm::min(row + BAND_ROWS, (height + 3) / 4);
+                pool.Submit([job, level, width, height, row, last]() {
+                    CompressBlocks(job->Format, job->Pixels[level].data(), width, height, job->Components, row, last, job->Compressed[level].data());
+                });
+            }
+        }
+    pool.Wait();
+    double encoded = seconds();
+
+    unsigned long long failures = 0;
+    size_t rawTotal = 0, compressedTotal = 0;
+    printf("%-56s %11s %6s %10s %10s%s\n", "image", "size", "format", "RGBA8", "KTX2", check ? "      PSNR" : "");
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        CompressJob& job = jobs[j];
+        if (!job.Read)
+        {
+            printf("%-56s could not be read\n", job.Path.c_str());
+            continue;
+        }
+        if (!WriteKtx2(job.Path + ".ktx2", job.Format, job.Width, job.Height, job.Compressed, job.SourceHash))
+        {
+            failures++;
+            continue;
+        }
+        // what the GPU held before (8 bits per channel, 4/3 for the mipmaps) and holds now
+        size_t raw = (size_t)job.Width * job.Height * job.Components * 4 / 3, compressed = 0;
+        for (size_t level = 0; level < job.Compressed.size(); level++)
+            compressed += job.Compressed[level].size();
+        rawTotal += raw;
+        compressedTotal += compressed;
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", job.Width, job.Height);
+        printf("%-56s %11s %6s %7.2f MB %7.2f MB", job.Path.c_str(), size, BlockFormatName(job.Format), raw / 1048576.0, compressed / 1048576.0);
+        if (check)
+        {
+            Ktx2Texture texture;
+            vector<unsigned char> rgba;
+            if (!ReadKtx2(job.Path + ".ktx2", texture) || texture.SourceHash != job.SourceHash || texture.Format != job.Format ||
+                texture.Levels.size() != job.Compressed.size() || !DecompressBlocks(texture.Format, texture.Levels[0], texture.Width, texture.Height, rgba))
+            {
+                printf("  does not read back");
+                failures++;
+            }
+            else
+            {
+                double quality = psnr(job, rgba);
+                printf(" %6.2f dB", quality);
+                failures += quality < 25.0;
+            }
+        }
+        printf("\n");
+    }
+    if (check && defaults)
+    {
+        bool found = false;
+        for (size_t j = 0; j < jobs.size(); j++)
+            found = found || (jobs[j].Path == KNOWN_NORMAL_MAP && jobs[j].Read && jobs[j].Format == BLOCK_BC5);
+        if (!found)
+        {
+            printf("%s was not compressed as a BC5 normal map\n", KNOWN_NORMAL_MAP);
+            failures++;
+        }
+    }
+    printf("%zu images: %.2f MB -> %.2f MB, decoded in %.0f ms, encoded in %.0f ms on %u threads\n", jobs.size(), rawTotal / 1048576.0,
+           compressedTotal / 1048576.0, (decoded - start) * 1e3, (encoded - decoded) * 1e3, pool.Size());
+    if (failures > 0)
+    {
+        printf("FAILED: %llu images\n", failures);
+        return 1;
+    }
+    return 0;
+}
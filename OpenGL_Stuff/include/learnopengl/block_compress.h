@@ -0,0 +1,603 @@
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+using namespace std;
+
+// CPU encoders and decoders for the BCn block formats the textures are stored in offline (see tools/
+// texture_compress.cpp and ktx2.h). No GL calls: the decoders let the encoder be checked without a GPU.
+//
+//   BC1  opaque color, 4 bpp          two 5:6:5 endpoints, 2 bit indices
+//   BC3  color and alpha, 8 bpp       a BC4 block for alpha, then a BC1 color block
+//   BC4  one channel, 4 bpp           two 8 bit endpoints, 3 bit indices
+//   BC5  two channels, 8 bpp          two BC4 blocks (normal maps: x and y, z = sqrt(1 - x^2 - y^2))
+//   BC7  color and alpha, 8 bpp       mode 6 only: RGBA 7 bit endpoints with a p-bit each, 4 bit indices
+//
+// Endpoints are fitted along the principal axis of the block's colors, then refined once by least squares on
+// the chosen indices. Blocks past the right or bottom edge repeat the edge texels.
+enum BlockFormat { BLOCK_BC1, BLOCK_BC3, BLOCK_BC4, BLOCK_BC5, BLOCK_BC7 };
+
+inline const char* BlockFormatName(BlockFormat format)
+{
+    const char* names[] = { "BC1", "BC3", "BC4", "BC5", "BC7" };
+    return names[format];
+}
+
+inline size_t BlockBytes(BlockFormat format)
+{
+    return format == BLOCK_BC1 || format == BLOCK_BC4 ? 8 : 16;
+}
+
+// bytes of one level of width x height texels
+inline size_t CompressedSize(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+// levels of a full mip chain down to 1x1
+inline int MipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while ((glm::max(width, height) >> levels) > 0)
+        levels++;
+    return levels;
+}
+
+// Format for an image by the channels it uses: normal maps keep x and y (BC5), one channel images go to BC4, color
+// goes to BC1 when every texel is opaque and to BC3 otherwise. highQuality sends opaque color to BC7 instead (twice
+// the size of BC1, fewer block artifacts); color with alpha stays BC3, whose separate alpha block beats the shared
+// endpoints of mode 6. Two channel images are grey and alpha, not two independent channels: expand them to RGBA
+// (ExpandGreyAlpha) before choosing.
+inline BlockFormat ChooseBlockFormat(const unsigned char* pixels, int width, int height, int components, bool normalMap, bool highQuality)
+{
+    if (normalMap)
+        return BLOCK_BC5;
+    if (components == 1)
+        return BLOCK_BC4;
+    bool opaque = true;
+    if (components == 4)
+        for (size_t i = 0; opaque && i < (size_t)width * height; i++)
+            opaque = pixels[i * 4 + 3] == 255;
+    if (!opaque)
+        return BLOCK_BC3;
+    return highQuality ? BLOCK_BC7 : BLOCK_BC1;
+}
+
+// grey and alpha texels (stb_image's two channel images) as RGBA, the grey copied to red, green and blue
+inline void ExpandGreyAlpha(const unsigned char* pixels, int width, int height, vector<unsigned char>& rgba)
+{
+    size_t texels = (size_t)width * height;
+    rgba.resize(texels * 4);
+    for (size_t i = 0; i < texels; i++)
+    {
+        rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = pixels[i * 2];
+        rgba[i * 4 + 3] = pixels[i * 2 + 1];
+    }
+}
+
+// Next mip level of an 8 bit image: the average of each 2x2 texels (an odd last row or column is averaged with
+// itself). Normal maps are renormalized so the smaller levels don't flatten the shading.
+inline void DownsampleImage(const unsigned char* pixels, int width, int height, int components, bool normalMap, vector<unsigned char>& level)
+{
+    int w = glm::max(width / 2, 1), h = glm::max(height / 2, 1);
+    level.resize((size_t)w * h * components);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            int x0 = glm::min(x * 2, width - 1), x1 = glm::min(x * 2 + 1, width - 1);
+            int y0 = glm::min(y * 2, height - 1), y1 = glm::min(y * 2 + 1, height - 1);
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int c = 0; c < components; c++)
+                sum[c] = (pixels[((size_t)y0 * width + x0) * components + c] + pixels[((size_t)y0 * width + x1) * components + c] +
+                          pixels[((size_t)y1 * width + x0) * components + c] + pixels[((size_t)y1 * width + x1) * components + c]) * 0.25f;
+            if (normalMap && components >= 3)
+            {
+                glm::vec3 n = glm::vec3(sum[0], sum[1], sum[2]) / 127.5f - 1.0f;
+                float length = glm::length(n);
+                if (length > 1e-4f)
+                    n = (n / length + 1.0f) * 127.5f;
+                else
+                    n = glm::vec3(127.5f, 127.5f, 255.0f);
+                sum[0] = n.x;
+                sum[1] = n.y;
+                sum[2] = n.z;
+            }
+            for (int c = 0; c < components; c++)
+                level[((size_t)y * w + x) * components + c] = (unsigned char)glm::clamp((int)(sum[c] + 0.5f), 0, 255);
+        }
+}
+
+// the 4x4 texels of block (bx, by) as RGBA; missing channels read 0, and alpha 255
+inline void loadBlock(const unsigned char* pixels, int width, int height, int components, int bx, int by, unsigned char block[16][4])
+{
+    for (int i = 0; i < 16; i++)
+    {
+        int x = glm::min(bx * 4 + i % 4, width - 1), y = glm::min(by * 4 + i / 4, height - 1);
+        const unsigned char* texel = pixels + ((size_t)y * width + x) * components;
+        for (int c = 0; c < 4; c++)
+            block[i][c] = c < components ? texel[c] : (c == 3 ? 255 : 0);
+    }
+}
+
+// little endian bit writer and reader over one block
+inline void putBits(unsigned char* block, int& at, uint32_t value, int bits)
+{
+    for (int b = 0; b < bits; b++, at++)
+        if (value >> b & 1)
+            block[at >> 3] |= (unsigned char)(1 << (at & 7));
+}
+
+inline uint32_t getBits(const unsigned char* block, int& at, int bits)
+{
+    uint32_t value = 0;
+    for (int b = 0; b < bits; b++, at++)
+        value |= (uint32_t)(block[at >> 3] >> (at & 7) & 1) << b;
+    return value;
+}
+
+// Endpoints a, b spanning the texels' channels first..first+channels-1 along their principal axis (a few power
+// iterations on the covariance)
+inline void fitEndpoints(const unsigned char block[16][4], int first, int channels, float a[4], float b[4])
+{
+    float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < channels; c++)
+            mean[c] += block[i][first + c] / 16.0f;
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int r = 0; r < channels; r++)
+            for (int c = 0; c < channels; c++)
+                covariance[r][c] += (block[i][first + r] - mean[r]) * (block[i][first + c] - mean[c]);
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, length = 0.0f;
+        for (int r = 0; r < channels; r++)
+        {
+            for (int c = 0; c < channels; c++)
+                next[r] += covariance[r][c] * axis[c];
+            length = glm::max(length, fabsf(next[r]));
+        }
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < channels; c++)
+            axis[c] = next[c] / length;
+    }
+    float lowest = 0.0f, highest = 0.0f, norm = 0.0f;
+    for (int c = 0; c < channels; c++)
+        norm += axis[c] * axis[c];
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (block[i][first + c] - mean[c]) * axis[c];
+        t /= norm;
+        lowest = glm::min(lowest, t);
+        highest = glm::max(highest, t);
+    }
+    for (int c = 0; c < channels; c++)
+    {
+        a[c] = glm::clamp(mean[c] + axis[c] * lowest, 0.0f, 255.0f);
+        b[c] = glm::clamp(mean[c] + axis[c] * highest, 0.0f, 255.0f);
+    }
+}
+
+// Least squares endpoints for fixed interpolation weights (0 at a, 1 at b); false if the weights are degenerate
+inline bool refineEndpoints(const unsigned char block[16][4], int first, int channels, const float weights[16], float a[4], float b[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+    {
+        float wa = 1.0f - weights[i], wb = weights[i];
+        aa += wa * wa;
+        ab += wa * wb;
+        bb += wb * wb;
+        for (int c = 0; c < channels; c++)
+        {
+            ax[c] += wa * block[i][first + c];
+            bx[c] += wb * block[i][first + c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f)
+        return false;
+    for (int c = 0; c < channels; c++)
+    {
+        a[c] = glm::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+        b[c] = glm::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+inline uint16_t packRgb565(const float c[4])
+{
+    int r = (int)(c[0] * 31.0f / 255.0f + 0.5f), g = (int)(c[1] * 63.0f / 255.0f + 0.5f), b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+inline void unpackRgb565(uint16_t value, int c[3])
+{
+    int r = value >> 11 & 31, g = value >> 5 & 63, b = value & 31;
+    c[0] = r << 3 | r >> 2;
+    c[1] = g << 2 | g >> 4;
+    c[2] = b << 3 | b >> 2;
+}
+
+// the four colors of an opaque BC1 block: 4 color mode when color0 > color1 (always for BC3 color blocks), else
+// 3 colors and black
+inline void bc1Palette(uint16_t color0, uint16_t color1, bool fourColors, int palette[4][4])
+{
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+        if (fourColors || color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    for (int i = 0; i < 4; i++)
+        palette[i][3] = 255;
+}
+
+// indices of the nearest palette colors and the squared error they leave
+inline int bc1Indices(const unsigned char block[16][4], uint16_t color0, uint16_t color1, uint32_t& indices)
+{
+    int palette[4][4];
+    bc1Palette(color0, color1, true, palette);
+    indices = 0;
+    int total = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int p = 0; p < 4; p++)
+        {
+            int error = 0;
+            for (int c = 0; c < 3; c++)
+                error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+            if (error < bestError)
+            {
+                best = p;
+                bestError = error;
+            }
+        }
+        indices |= (uint32_t)best << (i * 2);
+        total += bestError;
+    }
+    return total;
+}
+
+// a BC1 block from the block's RGB, in 4 color mode (the only mode BC3 color blocks have); a block of one color
+// has equal endpoints and every index 0
+inline void encodeBC1(const unsigned char block[16][4], unsigned char* out)
+{
+    float a[4], b[4];
+    fitEndpoints(block, 0, 3, a, b);
+    uint16_t color0 = packRgb565(b), color1 = packRgb565(a);
+    if (color0 < color1)
+        swap(color0, color1);
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        int error = bc1Indices(block, color0, color1, indices);
+        // one least squares pass on the chosen indices, kept if it helps
+        const float weightOf[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+            weights[i] = weightOf[indices >> (i * 2) & 3];
+        float refinedA[4], refinedB[4];
+        if (refineEndpoints(block, 0, 3, weights, refinedA, refinedB))
+        {
+            uint16_t refined0 = packRgb565(refinedA), refined1 = packRgb565(refinedB);
+            if (refined0 < refined1)
+                swap(refined0, refined1);
+            uint32_t refinedIndices;
+            if (refined0 != refined1 && bc1Indices(block, refined0, refined1, refinedIndices) < error)
+            {
+                color0 = refined0;
+                color1 = refined1;
+                indices = refinedIndices;
+            }
+        }
+    }
+    out[0] = (unsigned char)color0;
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)color1;
+    out[3] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// the eight values of a BC4 block (8 value mode when a0 > a1, else 6 values, 0 and 255)
+inline void bc4Palette(int a0, int a1, int palette[8])
+{
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    else
+    {
+        for (int i = 1; i < 5; i++)
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// a BC4 block from channel `channel` of the block
+inline void encodeBC4(const unsigned char block[16][4], int channel, unsigned char* out)
+{
+    int lowest = 255, highest = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lowest = glm::min(lowest, (int)block[i][channel]);
+        highest = glm::max(highest, (int)block[i][channel]);
+    }
+    int palette[8];
+    bc4Palette(highest, lowest, palette);
+    memset(out, 0, 8);
+    out[0] = (unsigned char)highest;
+    out[1] = (unsigned char)lowest;
+    int at = 16;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        for (int p = 1; p < 8 && highest > lowest; p++)
+            if (abs(block[i][channel] - palette[p]) < abs(block[i][channel] - palette[best]))
+                best = p;
+        putBits(out, at, best, 3);
+    }
+}
+
+// BC7 mode 6 interpolation weights, in 64ths
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// indices of a mode 6 block for 8 bit endpoints e0, e1 and the squared error they leave. Each texel is
+// projected on the endpoint line and only the three palette entries around it are tried.
+inline int bc7Indices(const unsigned char block[16][4], const int e0[4], const int e1[4], int indices[16])
+{
+    int palette[16][4], direction[4], length = 0;
+    for (int p = 0; p < 16; p++)
+        for (int c = 0; c < 4; c++)
+            palette[p][c] = ((64 - BC7_WEIGHTS[p]) * e0[c] + BC7_WEIGHTS[p] * e1[c] + 32) >> 6;
+    for (int c = 0; c < 4; c++)
+    {
+        direction[c] = e1[c] - e0[c];
+        length += direction[c] * direction[c];
+    }
+    int total = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int projected = 0;
+        for (int c = 0; c < 4; c++)
+            projected += (block[i][c] - e0[c]) * direction[c];
+        int guess = length == 0 ? 0 : glm::clamp((int)floorf(projected * 15.0f / length + 0.5f), 0, 15);
+        int bestError = 1 << 30;
+        for (int p = glm::max(guess - 1, 0); p <= glm::min(guess + 1, 15); p++)
+        {
+            int error = 0;
+            for (int c = 0; c < 4; c++)
+                error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+            if (error < bestError)
+            {
+                indices[i] = p;
+                bestError = error;
+            }
+        }
+        total += bestError;
+    }
+    return total;
+}
+
+// endpoints a, b quantized to 7 bits plus the p-bit pair that fits best; returns the error
+inline int bc7Quantize(const unsigned char block[16][4], const float a[4], const float b[4], int q0[4], int q1[4], int p[2], int indices[16])
+{
+    int bestError = 1 << 30;
+    for (int pair = 0; pair < 4; pair++)
+    {
+        int p0 = pair & 1, p1 = pair >> 1, c0[4], c1[4], e0[4], e1[4], candidate[16];
+        for (int c = 0; c < 4; c++)
+        {
+            c0[c] = glm::clamp((int)floorf((a[c] - p0) * 0.5f + 0.5f), 0, 127);
+            c1[c] = glm::clamp((int)floorf((b[c] - p1) * 0.5f + 0.5f), 0, 127);
+            e0[c] = c0[c] << 1 | p0;
+            e1[c] = c1[c] << 1 | p1;
+        }
+        int error = bc7Indices(block, e0, e1, candidate);
+        if (error < bestError)
+        {
+            bestError = error;
+            memcpy(q0, c0, sizeof(c0));
+            memcpy(q1, c1, sizeof(c1));
+            p[0] = p0;
+            p[1] = p1;
+            memcpy(indices, candidate, sizeof(candidate));
+        }
+    }
+    return bestError;
+}
+
+// a BC7 mode 6 block from the block's RGBA
+inline void encodeBC7(const unsigned char block[16][4], unsigned char* out)
+{
+    float a[4], b[4];
+    fitEndpoints(block, 0, 4, a, b);
+    int q0[4], q1[4], p[2], indices[16];
+    int error = bc7Quantize(block, a, b, q0, q1, p, indices);
+    float weights[16];
+    for (int i = 0; i < 16; i++)
+        weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+    if (refineEndpoints(block, 0, 4, weights, a, b))
+    {
+        int r0[4] = { 0 }, r1[4] = { 0 }, rp[2] = { 0 }, refined[16] = { 0 };
+        if (bc7Quantize(block, a, b, r0, r1, rp, refined) < error)
+        {
+            memcpy(q0, r0, sizeof(r0));
+            memcpy(q1, r1, sizeof(r1));
+            memcpy(p, rp, sizeof(rp));
+            memcpy(indices, refined, sizeof(refined));
+        }
+    }
+    // the first index is stored with its top bit implied 0: swap the endpoints if it is set
+    if (indices[0] >= 8)
+    {
+        for (int c = 0; c < 4; c++)
+            swap(q0[c], q1[c]);
+        swap(p[0], p[1]);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+    memset(out, 0, 16);
+    int at = 0;
+    putBits(out, at, 1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        putBits(out, at, q0[c], 7);
+        putBits(out, at, q1[c], 7);
+    }
+    putBits(out, at, p[0], 1);
+    putBits(out, at, p[1], 1);
+    for (int i = 0; i < 16; i++)
+        putBits(out, at, indices[i], i == 0 ? 3 : 4);
+}
+
+// Encodes block rows firstRow..lastRow-1 of an 8 bit image with `components` channels into out, which holds the
+// whole level (CompressedSize bytes). Separate row ranges can be encoded on separate threads.
+inline void CompressBlocks(BlockFormat format, const unsigned char* pixels, int width, int height, int components, int firstRow, int lastRow, unsigned char* out)
+{
+    int columns = (width + 3) / 4;
+    size_t bytes = BlockBytes(format);
+    unsigned char block[16][4];
+    for (int by = firstRow; by < lastRow; by++)
+        for (int bx = 0; bx < columns; bx++)
+        {
+            unsigned char* target = out + ((size_t)by * columns + bx) * bytes;
+            loadBlock(pixels, width, height, components, bx, by, block);
+            switch (format)
+            {
+            case BLOCK_BC1:
+                encodeBC1(block, target);
+                break;
+            case BLOCK_BC3:
+                encodeBC4(block, 3, target);
+                encodeBC1(block, target + 8);
+                break;
+            case BLOCK_BC4:
+                encodeBC4(block, 0, target);
+                break;
+            case BLOCK_BC5:
+                encodeBC4(block, 0, target);
+                encodeBC4(block, 1, target + 8);
+                break;
+            case BLOCK_BC7:
+                encodeBC7(block, target);
+                break;
+            }
+        }
+}
+
+inline void decodeBC1(const unsigned char* in, bool fourColors, unsigned char block[16][4])
+{
+    uint16_t color0 = (uint16_t)(in[0] | in[1] << 8), color1 = (uint16_t)(in[2] | in[3] << 8);
+    uint32_t indices = (uint32_t)in[4] | (uint32_t)in[5] << 8 | (uint32_t)in[6] << 16 | (uint32_t)in[7] << 24;
+    int palette[4][4];
+    bc1Palette(color0, color1, fourColors, palette);
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            block[i][c] = (unsigned char)palette[indices >> (i * 2) & 3][c];
+}
+
+inline void decodeBC4(const unsigned char* in, int channel, unsigned char block[16][4])
+{
+    int palette[8];
+    bc4Palette(in[0], in[1], palette);
+    int at = 16;
+    for (int i = 0; i < 16; i++)
+        block[i][channel] = (unsigned char)palette[getBits(in, at, 3)];
+}
+
+// mode 6 only, the one the encoder writes; false for any other mode
+inline bool decodeBC7(const unsigned char* in, unsigned char block[16][4])
+{
+    int at = 0;
+    if (getBits(in, at, 7) != 1u << 6)
+        return false;
+    int e0[4], e1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        e0[c] = getBits(in, at, 7) << 1;
+        e1[c] = getBits(in, at, 7) << 1;
+    }
+    int p0 = getBits(in, at, 1), p1 = getBits(in, at, 1);
+    for (int c = 0; c < 4; c++)
+    {
+        e0[c] |= p0;
+        e1[c] |= p1;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        int w = BC7_WEIGHTS[getBits(in, at, i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++)
+            block[i][c] = (unsigned char)(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+    }
+    return true;
+}
+
+// Decodes a whole level to RGBA8 (what GL would sample: BC4 as (r, 0, 0, 1), BC5 as (r, g, 0, 1)). Returns false
+// if a BC7 block uses a mode other than 6.
+inline bool DecompressBlocks(BlockFormat format, const unsigned char* data, int width, int height, vector<unsigned char>& rgba)
+{
+    rgba.assign((size_t)width * height * 4, 0);
+    int columns = (width + 3) / 4, rows = (height + 3) / 4;
+    size_t bytes = BlockBytes(format);
+    bool decoded = true;
+    for (int by = 0; by < rows; by++)
+        for (int bx = 0; bx < columns; bx++)
+        {
+            const unsigned char* in = data + ((size_t)by * columns + bx) * bytes;
+            unsigned char block[16][4];
+            memset(block, 0, sizeof(block));
+            for (int i = 0; i < 16; i++)
+                block[i][3] = 255;
+            switch (format)
+            {
+            case BLOCK_BC1:
+                decodeBC1(in, false, block);
+                break;
+            case BLOCK_BC3:
+                decodeBC1(in + 8, true, block);
+                decodeBC4(in, 3, block);
+                break;
+            case BLOCK_BC4:
+                decodeBC4(in, 0, block);
+                break;
+            case BLOCK_BC5:
+                decodeBC4(in, 0, block);
+                decodeBC4(in + 8, 1, block);
+                break;
+            case BLOCK_BC7:
+                decoded = decodeBC7(in, block) && decoded;
+                break;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x < width && y < height)
+                    memcpy(&rgba[((size_t)y * width + x) * 4], block[i], 4);
+            }
+        }
+    return decoded;
+}
+#endif
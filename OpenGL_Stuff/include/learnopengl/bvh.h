@@ -0,0 +1,1442 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/triangle_soa.h>
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+// axis aligned bounding box, used both for BVH nodes and for the SAH cost evaluation during the build.
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+    AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+    void Grow(const glm::vec3& p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void Grow(const AABB& b)
+    {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    bool IsEmpty() const
+    {
+        return min.x > max.x;
+    }
+
+    // half of the surface area is enough for the SAH since only ratios are compared
+    float HalfArea() const
+    {
+        if (IsEmpty())
+            return 0.0f;
+        glm::vec3 e = max - min;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    glm::vec3 Center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    // box enclosing this box after an affine transform (Arvo's method, no need to transform the eight corners)
+    AABB Transformed(const glm::mat4& m) const
+    {
+        if (IsEmpty())
+            return *this;
+        glm::vec3 t(m[3]);
+        AABB b(t, t);
+        for (int c = 0; c < 3; c++)
+        {
+            glm::vec3 column(m[c]);
+            glm::vec3 lo = column * min[c];
+            glm::vec3 hi = column * max[c];
+            b.min += glm::min(lo, hi);
+            b.max += glm::max(lo, hi);
+        }
+        return b;
+    }
+
+    // box enclosing this box at every pose of a motion from one transform to another, blended as by
+    // InterpolateTransform (translation and scale linear, rotation slerped). Without rotation the box moves
+    // linearly, so the boxes at both ends are enough; a rotating box stays inside a sphere around the model
+    // origin, whose path is the straight line between both translations.
+    AABB Swept(const glm::mat4& from, const glm::mat4& to) const
+    {
+        if (IsEmpty())
+            return *this;
+        glm::mat3 a(from), b(to);
+        glm::vec3 scaleA(glm::length(a[0]), glm::length(a[1]), glm::length(a[2]));
+        glm::vec3 scaleB(glm::length(b[0]), glm::length(b[1]), glm::length(b[2]));
+        if (a[0] / scaleA.x == b[0] / scaleB.x && a[1] / scaleA.y == b[1] / scaleB.y && a[2] / scaleA.z == b[2] / scaleB.z)
+        {
+            AABB box = Transformed(from);
+            box.Grow(Transformed(to));
+            return box;
+        }
+        float reach = glm::length(glm::max(glm::abs(min), glm::abs(max)));
+        float radius = reach * glm::max(glm::max(glm::max(scaleA.x, scaleA.y), scaleA.z), glm::max(glm::max(scaleB.x, scaleB.y), scaleB.z));
+        glm::vec3 p0(from[3]), p1(to[3]);
+        return AABB(glm::min(p0, p1) - radius, glm::max(p0, p1) + radius);
+    }
+};
+
+// 32 byte node: two nodes share a cache line. Inner nodes store the index of their left child in leftFirst
+// (the right child is always leftFirst + 1), leaves store the first entry of BVH::triIndices instead.
+struct BVHNode {
+    glm::vec3 boundsMin;
+    unsigned int leftFirst;
+    glm::vec3 boundsMax;
+    unsigned int triCount;
+
+    bool IsLeaf() const { return triCount > 0; }
+};
+
+// 64 byte node of the compressed layout (see BVH::Compress), one cache line per visit. Up to four children whose
+// boxes are stored with 8 bits per plane on a grid over this node's box: plane = origin + q * 2^exponent. Child
+// minimums are rounded down and maximums up, so a decoded box always contains the real one and no hit is missed.
+// Leaf children point straight at their triangles, so leaves don't need nodes of their own.
+struct BVHNode4 {
+    glm::vec3 origin;
+    signed char exponent[3];
+    unsigned char childCount;
+    unsigned char qmin[3][4];    // [axis][child]
+    unsigned char qmax[3][4];
+    unsigned int child[4];       // node index of inner children, first entry of BVH::triIndices for leaf children
+    unsigned char triCount[4];   // 0 for inner children
+    unsigned int padding;
+
+    // 2^exponent, built from the bits so decoding doesn't need ldexp
+    float Scale(int axis) const
+    {
+        unsigned int bits = (unsigned int)(exponent[axis] + 127) << 23;
+        float scale;
+        memcpy(&scale, &bits, sizeof(scale));
+        return scale;
+    }
+
+    bool IsLeaf(int i) const { return triCount[i] > 0; }
+};
+static_assert(sizeof(BVHNode4) == 64, "BVHNode4 must fill exactly one cache line");
+
+// Define BVH_COUNT_VISITS to count the nodes visited and the triangles tested by ray queries, e.g. for benchmarks.
+// A packet counts each node once and each triangle once per active ray.
+#if defined(BVH_COUNT_VISITS)
+#define BVH_COUNT_VISIT() (BVH::VisitCount()++)
+#define BVH_COUNT_TRIANGLES(n) (BVH::TriangleCount() += (n))
+#else
+#define BVH_COUNT_VISIT()
+#define BVH_COUNT_TRIANGLES(n)
+#endif
+
+// With the watertight triangle test a ray through an edge must not be lost by the box tests either, so the exit
+// distance of every box is pushed out by the worst case rounding of the slab test, 2 * gamma(3) (Ize 2013).
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+const float BOX_EXIT_SCALE = 1.0000004f;
+#else
+const float BOX_EXIT_SCALE = 1.0f;
+#endif
+
+// slab test against a node; invDir is 1/dir precomputed once per ray. Returns the entry distance or FLT_MAX on a miss.
+inline float IntersectRayAABB(const glm::vec3& origin, const glm::vec3& invDir, const glm::vec3& bmin, const glm::vec3& bmax, float tMax)
+{
+    glm::vec3 t0 = (bmin - origin) * invDir;
+    glm::vec3 t1 = (bmax - origin) * invDir;
+    glm::vec3 tSmall = glm::min(t0, t1);
+    glm::vec3 tBig = glm::max(t0, t1);
+    float tEnter = glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f));
+    float tExit = glm::min(glm::min(glm::min(tBig.x, tBig.y), tBig.z) * BOX_EXIT_SCALE, tMax);
+    return tEnter <= tExit ? tEnter : FLT_MAX;
+}
+
+// slab test of the rays of a packet selected by mask against one box. Returns the mask of rays that hit it and the
+// nearest entry distance among them in tNear.
+inline unsigned int IntersectPacketAABB(const RayPacket& packet, unsigned int mask, const glm::vec3& bmin, const glm::vec3& bmax, float& tNear)
+{
+    unsigned int hits = 0;
+#if defined(TRIANGLE_SOA_SIMD)
+    const unsigned int WIDTH = TriangleSoA::WIDTH;
+    SimdFloat minX = simdSet(bmin.x), minY = simdSet(bmin.y), minZ = simdSet(bmin.z);
+    SimdFloat maxX = simdSet(bmax.x), maxY = simdSet(bmax.y), maxZ = simdSet(bmax.z);
+    SimdFloat nearest = simdSet(FLT_MAX);
+    for (unsigned int r = 0; r < packet.count; r += WIDTH)
+    {
+        if (((mask >> r) & ((1u << WIDTH) - 1u)) == 0)
+            continue;
+        SimdFloat ox = simdLoad(&packet.ox[r]), oy = simdLoad(&packet.oy[r]), oz = simdLoad(&packet.oz[r]);
+        SimdFloat ix = simdLoad(&packet.idx[r]), iy = simdLoad(&packet.idy[r]), iz = simdLoad(&packet.idz[r]);
+        SimdFloat t0x = simdMul(simdSub(minX, ox), ix), t1x = simdMul(simdSub(maxX, ox), ix);
+        SimdFloat t0y = simdMul(simdSub(minY, oy), iy), t1y = simdMul(simdSub(maxY, oy), iy);
+        SimdFloat t0z = simdMul(simdSub(minZ, oz), iz), t1z = simdMul(simdSub(maxZ, oz), iz);
+        SimdFloat tEnter = simdMax(simdMax(simdMin(t0x, t1x), simdMin(t0y, t1y)), simdMax(simdMin(t0z, t1z), simdSet(0.0f)));
+        SimdFloat boxExit = simdMin(simdMin(simdMax(t0x, t1x), simdMax(t0y, t1y)), simdMax(t0z, t1z));
+        SimdFloat tExit = simdMin(simdMul(boxExit, simdSet(BOX_EXIT_SCALE)), simdLoad(&packet.tMax[r]));
+        SimdFloat hit = simdLessEqual(tEnter, tExit);
+        hits |= simdMask(hit) << r;
+        nearest = simdMin(nearest, simdSelect(hit, tEnter, simdSet(FLT_MAX)));
+    }
+    float lanes[WIDTH];
+    simdStore(lanes, nearest);
+    tNear = FLT_MAX;
+    for (unsigned int i = 0; i < WIDTH; i++)
+        tNear = min(tNear, lanes[i]);
+#else
+    tNear = FLT_MAX;
+    for (unsigned int r = 0; r < packet.count; r++)
+    {
+        if (!(mask & (1u << r)))
+            continue;
+        glm::vec3 origin(packet.ox[r], packet.oy[r], packet.oz[r]);
+        glm::vec3 invDir(packet.idx[r], packet.idy[r], packet.idz[r]);
+        float d = IntersectRayAABB(origin, invDir, bmin, bmax, packet.tMax[r]);
+        if (d != FLT_MAX)
+        {
+            hits |= 1u << r;
+            tNear = min(tNear, d);
+        }
+    }
+#endif
+    return hits & mask;
+}
+
+// ray for the batched queries; Direction doesn't need to be normalized, TMax is in units of Direction.
+struct Ray {
+    glm::vec3 Origin;
+    glm::vec3 Direction;
+    float TMax;
+
+    Ray() : Origin(0.0f), Direction(0.0f, 0.0f, -1.0f), TMax(FLT_MAX) {}
+    Ray(const glm::vec3& origin, const glm::vec3& direction, float tMax = FLT_MAX) : Origin(origin), Direction(direction), TMax(tMax) {}
+};
+
+// result of a closest hit query. The BVH fills the distance, triangle and barycentrics; the model level query
+// adds the mesh, the interpolated texture coordinates and the hit point.
+struct HitRecord {
+    float T;                // ray parameter, in units of the ray direction
+    unsigned int Triangle;  // triangle id: index of its first vertex index in Mesh::indices divided by 3
+    unsigned int Mesh;      // index of the mesh inside its model
+    unsigned int Instance;  // instance id when the query went through a SceneBVH
+    glm::vec2 Barycentric;  // weights of the triangle's second and third vertex
+    glm::vec2 TexCoords;
+    glm::vec3 Point;
+
+    HitRecord() : T(FLT_MAX), Triangle(0), Mesh(0), Instance(0), Barycentric(0.0f), TexCoords(0.0f), Point(0.0f) {}
+};
+
+// Bounded buffer for the all-hits queries, kept sorted by T. It lives on the stack, so collecting hits never
+// allocates. When it is full a new hit replaces the farthest one if it is nearer, so the list always holds the
+// nearest Capacity hits, and Add returns the distance past which hits can no longer get in.
+template <unsigned int Capacity>
+class HitList {
+public:
+    HitRecord Hits[Capacity];
+    unsigned int Count;
+
+    HitList() : Count(0) {}
+
+    float Add(const HitRecord& hit)
+    {
+        if (Count == Capacity)
+        {
+            if (hit.T >= Hits[Count - 1].T)
+                return Limit();
+            Count--;
+        }
+        unsigned int i = Count++;
+        while (i > 0 && Hits[i - 1].T > hit.T)
+        {
+            Hits[i] = Hits[i - 1];
+            i--;
+        }
+        Hits[i] = hit;
+        return Limit();
+    }
+
+    float Limit() const
+    {
+        return Count == Capacity ? Hits[Count - 1].T : FLT_MAX;
+    }
+
+    bool Full() const
+    {
+        return Count == Capacity;
+    }
+
+    void Clear()
+    {
+        Count = 0;
+    }
+};
+
+// Möller–Trumbore ray/triangle test
+inline bool intersectRayTriangle(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t) {
+    const float EPSILON = 0.0000001f;
+    glm::vec3 edge1, edge2, h, s, q;
+    float a, f, u, v;
+    edge1 = v1 - v0;
+    edge2 = v2 - v0;
+    h = glm::cross(rayDir, edge2);
+    a = glm::dot(edge1, h);
+    if (a > -EPSILON && a < EPSILON)
+        return false;    // El rayo es paralelo al triángulo.
+    f = 1.0f / a;
+    s = rayOrigin - v0;
+    u = f * glm::dot(s, h);
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    q = glm::cross(s, edge1);
+    v = f * glm::dot(rayDir, q);
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    // En este punto sabemos que hay una intersección en la línea del rayo, pero no si el rayo realmente la intersecta.
+    t = f * glm::dot(edge2, q);
+    if (t > EPSILON) // Intersección con el rayo
+        return true;
+
+    return false;
+}
+
+// Bounding volume hierarchy over the triangles of a single mesh, built in model space with the surface area heuristic.
+// triIndices stores triangle ids (the index of the triangle's first entry in the index buffer divided by 3) in leaf
+// order, and triangles holds a SoA copy of the triangle data in that same order for the SIMD kernels.
+// The queries only go through the nodes/triIndices pointers, which point either at the arrays filled by Build or,
+// for a BVH loaded from the on-disk cache, straight into the mapped file (see View).
+// After Compress the binary nodes are replaced by the quantized 4-wide wideNodes; triangles stay where they are.
+class BVH {
+public:
+    const BVHNode*       nodes;
+    unsigned int         nodeCount;
+    const BVHNode4*      wideNodes;
+    unsigned int         wideNodeCount;
+    const unsigned int*  triIndices;
+    unsigned int         triangleCount;
+    TriangleSoA          triangles;
+
+    static const int BINS = 16;
+    static const int MAX_DEPTH = 64;
+    // leaves hold at most this many triangles (unless the depth limit was hit), so a BVHNode4 can store their count in a byte
+    static const unsigned int MAX_LEAF_SIZE = 255;
+    // rays traversed together by the batched queries, one bit per ray in the traversal masks
+    static const unsigned int PACKET_SIZE = RayPacket::SIZE;
+    // cost of visiting a node relative to testing one SIMD batch of triangles
+    static constexpr float TRAVERSAL_COST = 1.0f;
+
+    BVH() : nodes(NULL), nodeCount(0), wideNodes(NULL), wideNodeCount(0), triIndices(NULL), triangleCount(0) {}
+
+    BVH(const BVH& other)
+    {
+        *this = other;
+    }
+
+    BVH& operator=(const BVH& other)
+    {
+        if (this == &other)
+            return *this;
+        nodeStorage = other.nodeStorage;
+        triIndexStorage = other.triIndexStorage;
+        owner = other.owner;
+        triangles = other.triangles;
+        nodeCount = other.nodeCount;
+        triangleCount = other.triangleCount;
+        if (owner)
+        {
+            nodes = other.nodes;
+            triIndices = other.triIndices;
+        }
+        else
+        {
+            bindStorage();
+        }
+        // the copy may start at a different offset from a cache line, so the nodes are copied to the new alignment
+        wideStorage.assign(other.wideStorage.size(), 0);
+        wideBounds = other.wideBounds;
+        bindWideStorage(other.wideNodeCount);
+        if (wideNodeCount > 0)
+            memcpy((void*)wideNodes, other.wideNodes, wideNodeCount * sizeof(BVHNode4));
+        return *this;
+    }
+
+    template <typename VertexT>
+    void Build(const vector<VertexT>& vertices, const vector<unsigned int>& indices)
+    {
+        owner.reset();
+        nodeStorage.clear();
+        triIndexStorage.clear();
+        bindStorage();
+        wideStorage.clear();
+        bindWideStorage(0);
+        size_t triCount = indices.size() / 3;
+        if (triCount == 0)
+            return;
+
+        // per triangle bounds and centroids are only needed while building
+        bounds.resize(triCount);
+        centroids.resize(triCount);
+        triIndexStorage.resize(triCount);
+        for (size_t i = 0; i < triCount; i++)
+        {
+            AABB b;
+            b.Grow(vertices[indices[i * 3]].Position);
+            b.Grow(vertices[indices[i * 3 + 1]].Position);
+            b.Grow(vertices[indices[i * 3 + 2]].Position);
+            bounds[i] = b;
+            centroids[i] = (b.min + b.max) * 0.5f;
+            triIndexStorage[i] = (unsigned int)i;
+        }
+
+        // a binary tree with one triangle per leaf has at most 2N - 1 nodes
+        nodeStorage.reserve(triCount * 2);
+        BVHNode root;
+        root.leftFirst = 0;
+        root.triCount = (unsigned int)triCount;
+        nodeStorage.push_back(root);
+        updateBounds(0);
+        subdivide(0, 0);
+        nodeStorage.shrink_to_fit();
+        triangles.Build(vertices, indices, triIndexStorage);
+        bindStorage();
+
+        bounds.clear();
+        bounds.shrink_to_fit();
+        centroids.clear();
+        centroids.shrink_to_fit();
+    }
+
+    // uses nodes, triangle ids and SoA triangles stored elsewhere (e.g. a mapped cache file) without copying them;
+    // dataOwner keeps that memory alive for as long as this BVH or a copy of it exists.
+    void View(const BVHNode* nodeData, unsigned int numNodes, const unsigned int* indexData, const float* triangleData,
+              unsigned int numTriangles, const shared_ptr<const void>& dataOwner)
+    {
+        nodeStorage.clear();
+        nodeStorage.shrink_to_fit();
+        triIndexStorage.clear();
+        triIndexStorage.shrink_to_fit();
+        wideStorage.clear();
+        bindWideStorage(0);
+        owner = dataOwner;
+        nodes = nodeData;
+        nodeCount = numNodes;
+        triIndices = indexData;
+        triangleCount = numTriangles;
+        triangles.View(triangleData, numTriangles, dataOwner);
+    }
+
+    // Replaces the binary nodes with the compressed 4-wide layout: about half the node memory and less than half the
+    // node visits per query, at the cost of decoding the child boxes. Packet queries then run one ray at a time.
+    // Call Build again to get the binary layout back. Models do this for all their meshes when BVH_COMPRESSED_NODES
+    // is defined.
+    void Compress()
+    {
+        if (nodeCount == 0)
+            return;
+        for (unsigned int i = 0; i < nodeCount; i++)
+            if (nodes[i].triCount > MAX_LEAF_SIZE)
+                return; // a leaf at the depth limit is too big for the compressed layout, keep the binary one
+        vector<BVHNode4> wide;
+        wide.reserve(nodeCount / 3 + 1);
+        wide.push_back(BVHNode4());
+        compressNode(0, 0, wide);
+        wideBounds = AABB(nodes[0].boundsMin, nodes[0].boundsMax);
+
+        // one extra node of slack to start the array on a cache line
+        wideStorage.assign((wide.size() + 1) * sizeof(BVHNode4), 0);
+        bindWideStorage((unsigned int)wide.size());
+        memcpy((void*)wideNodes, wide.data(), wide.size() * sizeof(BVHNode4));
+
+        nodeStorage.clear();
+        nodeStorage.shrink_to_fit();
+        nodes = NULL;
+        nodeCount = 0;
+    }
+
+    bool Compressed() const
+    {
+        return wideNodeCount > 0;
+    }
+
+    bool Empty() const
+    {
+        return nodeCount == 0 && wideNodeCount == 0;
+    }
+
+    AABB Bounds() const
+    {
+        if (wideNodeCount > 0)
+            return wideBounds;
+        if (nodeCount == 0)
+            return AABB();
+        return AABB(nodes[0].boundsMin, nodes[0].boundsMax);
+    }
+
+    // memory used by the nodes in the current layout
+    size_t NodeBytes() const
+    {
+        return (size_t)nodeCount * sizeof(BVHNode) + (size_t)wideNodeCount * sizeof(BVHNode4);
+    }
+
+#if defined(BVH_COUNT_VISITS)
+    static unsigned long long& VisitCount()
+    {
+        static unsigned long long count = 0;
+        return count;
+    }
+
+    static unsigned long long& TriangleCount()
+    {
+        static unsigned long long count = 0;
+        return count;
+    }
+#endif
+
+    // returns true as soon as any triangle closer than tMax is hit; the ray must be in the mesh's model space.
+    bool IntersectAny(const glm::vec3& origin, const glm::vec3& dir, float tMax = FLT_MAX) const
+    {
+        if (wideNodeCount > 0)
+            return intersectAnyWide(origin, dir, tMax);
+        if (nodeCount == 0)
+            return false;
+        glm::vec3 invDir = 1.0f / dir;
+        if (IntersectRayAABB(origin, invDir, nodes[0].boundsMin, nodes[0].boundsMax, tMax) == FLT_MAX)
+            return false;
+        return intersectAnyFrom(0, origin, dir, invDir, tMax);
+    }
+
+    // closest hit closer than tMax; fills T, Triangle and Barycentric of hit. The ray must be in model space.
+    bool IntersectClosest(const glm::vec3& origin, const glm::vec3& dir, HitRecord& hit, float tMax = FLT_MAX) const
+    {
+        if (wideNodeCount > 0)
+            return intersectClosestWide(origin, dir, hit, tMax);
+        if (nodeCount == 0)
+            return false;
+        glm::vec3 invDir = 1.0f / dir;
+        if (IntersectRayAABB(origin, invDir, nodes[0].boundsMin, nodes[0].boundsMax, tMax) == FLT_MAX)
+            return false;
+
+        // far children are pushed with their entry distance so they can be skipped once a closer hit is known
+        unsigned int stack[MAX_DEPTH];
+        float stackDist[MAX_DEPTH];
+        int stackPtr = 0;
+        unsigned int nodeIdx = 0;
+        unsigned int index = 0;
+        float u = 0.0f, v = 0.0f;
+        bool found = false;
+        while (true)
+        {
+            BVH_COUNT_VISIT();
+            const BVHNode& node = nodes[nodeIdx];
+            if (node.IsLeaf())
+            {
+                BVH_COUNT_TRIANGLES(node.triCount);
+                found |= triangles.IntersectClosest(origin, dir, node.leftFirst, node.triCount, tMax, index, u, v);
+            }
+            else
+            {
+                unsigned int child1 = node.leftFirst;
+                unsigned int child2 = node.leftFirst + 1;
+                float dist1 = IntersectRayAABB(origin, invDir, nodes[child1].boundsMin, nodes[child1].boundsMax, tMax);
+                float dist2 = IntersectRayAABB(origin, invDir, nodes[child2].boundsMin, nodes[child2].boundsMax, tMax);
+                if (dist1 > dist2)
+                {
+                    swap(dist1, dist2);
+                    swap(child1, child2);
+                }
+                if (dist1 != FLT_MAX)
+                {
+                    if (dist2 != FLT_MAX)
+                    {
+                        stackDist[stackPtr] = dist2;
+                        stack[stackPtr++] = child2;
+                    }
+                    nodeIdx = child1;
+                    continue;
+                }
+            }
+            // pop the next node that can still contain a closer hit
+            while (stackPtr > 0 && stackDist[stackPtr - 1] > tMax)
+                stackPtr--;
+            if (stackPtr == 0)
+                break;
+            nodeIdx = stack[--stackPtr];
+        }
+        if (found)
+        {
+            hit.T = tMax;
+            hit.Triangle = triIndices[index];
+            hit.Barycentric = glm::vec2(u, v);
+        }
+        return found;
+    }
+
+    // closest contact of a sphere of the given radius swept along the ray (a capsule from origin to origin + tMax *
+    // dir), for thick projectiles and aim assist. Same contract as IntersectClosest: hit.T is where the center is
+    // when the sphere first touches, Barycentric the touched point of the triangle. Node boxes are only grown by
+    // the radius, so the traversal visits about as many nodes as a ray does; the test per triangle is exact.
+    bool SweepSphere(const glm::vec3& origin, const glm::vec3& dir, float radius, HitRecord& hit, float tMax = FLT_MAX) const
+    {
+        if (Empty())
+            return false;
+        glm::vec3 invDir = 1.0f / dir;
+        glm::vec3 grow(radius);
+        AABB bounds = Bounds();
+        if (IntersectRayAABB(origin, invDir, bounds.min - grow, bounds.max + grow, tMax) == FLT_MAX)
+            return false;
+        unsigned int index = 0;
+        float u = 0.0f, v = 0.0f;
+        bool found = false;
+        if (wideNodeCount > 0)
+        {
+            WideEntry stack[MAX_DEPTH * 3 + 1];
+            int stackPtr = 0;
+            WideEntry root = { 0, 0, 0.0f };
+            stack[stackPtr++] = root;
+            while (stackPtr > 0)
+            {
+                WideEntry entry = stack[--stackPtr];
+                if (entry.dist > tMax)
+                    continue;
+                if (entry.triCount > 0)
+                {
+                    BVH_COUNT_TRIANGLES(entry.triCount);
+                    found |= triangles.SweepSphere(origin, dir, radius, entry.ref, entry.triCount, tMax, index, u, v);
+                    continue;
+                }
+                BVH_COUNT_VISIT();
+                stackPtr = pushChildren(wideNodes[entry.ref], origin, invDir, tMax, stack, stackPtr, radius);
+            }
+        }
+        else
+        {
+            unsigned int stack[MAX_DEPTH];
+            float stackDist[MAX_DEPTH];
+            int stackPtr = 0;
+            unsigned int nodeIdx = 0;
+            while (true)
+            {
+                BVH_COUNT_VISIT();
+                const BVHNode& node = nodes[nodeIdx];
+                if (node.IsLeaf())
+                {
+                    BVH_COUNT_TRIANGLES(node.triCount);
+                    found |= triangles.SweepSphere(origin, dir, radius, node.leftFirst, node.triCount, tMax, index, u, v);
+                }
+                else
+                {
+                    unsigned int child1 = node.leftFirst;
+                    unsigned int child2 = node.leftFirst + 1;
+                    float dist1 = IntersectRayAABB(origin, invDir, nodes[child1].boundsMin - grow, nodes[child1].boundsMax + grow, tMax);
+                    float dist2 = IntersectRayAABB(origin, invDir, nodes[child2].boundsMin - grow, nodes[child2].boundsMax + grow, tMax);
+                    if (dist1 > dist2)
+                    {
+                        swap(dist1, dist2);
+                        swap(child1, child2);
+                    }
+                    if (dist1 != FLT_MAX)
+                    {
+                        if (dist2 != FLT_MAX)
+                        {
+                            stackDist[stackPtr] = dist2;
+                            stack[stackPtr++] = child2;
+                        }
+                        nodeIdx = child1;
+                        continue;
+                    }
+                }
+                while (stackPtr > 0 && stackDist[stackPtr - 1] > tMax)
+                    stackPtr--;
+                if (stackPtr == 0)
+                    break;
+                nodeIdx = stack[--stackPtr];
+            }
+        }
+        if (found)
+        {
+            hit.T = tMax;
+            hit.Triangle = triIndices[index];
+            hit.Barycentric = glm::vec2(u, v);
+        }
+        return found;
+    }
+
+    // Every hit closer than tMax, in traversal order: onHit(HitRecord&) gets T, Triangle and Barycentric filled and
+    // returns the distance past which it wants no more hits (e.g. HitList::Add). Nodes beyond the smaller of that
+    // and tMax are skipped. Returns the final cut-off distance.
+    template <typename OnHit>
+    float IntersectAll(const glm::vec3& origin, const glm::vec3& dir, float tMax, OnHit onHit) const
+    {
+        auto report = [&](unsigned int index, float t, float u, float v) {
+            HitRecord hit;
+            hit.T = t;
+            hit.Triangle = triIndices[index];
+            hit.Barycentric = glm::vec2(u, v);
+            return glm::min(tMax, onHit(hit));
+        };
+        glm::vec3 invDir = 1.0f / dir;
+        if (wideNodeCount > 0)
+        {
+            if (IntersectRayAABB(origin, invDir, wideBounds.min, wideBounds.max, tMax) == FLT_MAX)
+                return tMax;
+            WideEntry stack[MAX_DEPTH * 3 + 1];
+            int stackPtr = 0;
+            WideEntry root = { 0, 0, 0.0f };
+            stack[stackPtr++] = root;
+            while (stackPtr > 0)
+            {
+                WideEntry entry = stack[--stackPtr];
+                if (entry.dist > tMax)
+                    continue;
+                if (entry.triCount > 0)
+                {
+                    BVH_COUNT_TRIANGLES(entry.triCount);
+                    tMax = triangles.IntersectAll(origin, dir, entry.ref, entry.triCount, tMax, report);
+                    continue;
+                }
+                BVH_COUNT_VISIT();
+                stackPtr = pushChildren(wideNodes[entry.ref], origin, invDir, tMax, stack, stackPtr);
+            }
+            return tMax;
+        }
+        if (nodeCount == 0 || IntersectRayAABB(origin, invDir, nodes[0].boundsMin, nodes[0].boundsMax, tMax) == FLT_MAX)
+            return tMax;
+
+        // same front to back order as the closest hit query, so a bounded list fills with near hits first
+        unsigned int stack[MAX_DEPTH];
+        float stackDist[MAX_DEPTH];
+        int stackPtr = 0;
+        unsigned int nodeIdx = 0;
+        while (true)
+        {
+            BVH_COUNT_VISIT();
+            const BVHNode& node = nodes[nodeIdx];
+            if (node.IsLeaf())
+            {
+                BVH_COUNT_TRIANGLES(node.triCount);
+                tMax = triangles.IntersectAll(origin, dir, node.leftFirst, node.triCount, tMax, report);
+            }
+            else
+            {
+                unsigned int child1 = node.leftFirst;
+                unsigned int child2 = node.leftFirst + 1;
+                float dist1 = IntersectRayAABB(origin, invDir, nodes[child1].boundsMin, nodes[child1].boundsMax, tMax);
+                float dist2 = IntersectRayAABB(origin, invDir, nodes[child2].boundsMin, nodes[child2].boundsMax, tMax);
+                if (dist1 > dist2)
+                {
+                    swap(dist1, dist2);
+                    swap(child1, child2);
+                }
+                if (dist1 != FLT_MAX)
+                {
+                    if (dist2 != FLT_MAX)
+                    {
+                        stackDist[stackPtr] = dist2;
+                        stack[stackPtr++] = child2;
+                    }
+                    nodeIdx = child1;
+                    continue;
+                }
+            }
+            while (stackPtr > 0 && stackDist[stackPtr - 1] > tMax)
+                stackPtr--;
+            if (stackPtr == 0)
+                break;
+            nodeIdx = stack[--stackPtr];
+        }
+        return tMax;
+    }
+
+    // any-hit query for many rays at once: hits[i] tells whether rays[i] hit the mesh. Rays are traversed in packets
+    // of PACKET_SIZE that share node visits and leaf loads, so rays should be passed in coherent order (e.g. the
+    // pellets of one shot).
+    void IntersectAny(const Ray* rays, unsigned int count, bool* hits) const
+    {
+#if defined(TRIANGLE_SOA_SIMD)
+        if (wideNodeCount > 0)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                hits[i] = IntersectAny(rays[i].Origin, rays[i].Direction, rays[i].TMax);
+            return;
+        }
+        for (unsigned int first = 0; first < count; first += PACKET_SIZE)
+        {
+            unsigned int n = count - first < PACKET_SIZE ? count - first : PACKET_SIZE;
+            intersectAnyPacket(rays + first, n, hits + first);
+        }
+#else
+        // without SIMD there's nothing to share between the rays of a packet
+        for (unsigned int i = 0; i < count; i++)
+            hits[i] = IntersectAny(rays[i].Origin, rays[i].Direction, rays[i].TMax);
+#endif
+    }
+
+    // closest hit query for many rays at once: found[i] tells whether rays[i] hit the mesh closer than its TMax, and
+    // then hits[i] has the hit like IntersectClosest. Packets as with IntersectAny; each ray keeps its own cut-off,
+    // so a node is only visited for the rays that can still find a closer hit in it.
+    void IntersectClosest(const Ray* rays, unsigned int count, HitRecord* hits, bool* found) const
+    {
+#if defined(TRIANGLE_SOA_SIMD)
+        if (wideNodeCount > 0)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                found[i] = IntersectClosest(rays[i].Origin, rays[i].Direction, hits[i], rays[i].TMax);
+            return;
+        }
+        for (unsigned int first = 0; first < count; first += PACKET_SIZE)
+        {
+            unsigned int n = count - first < PACKET_SIZE ? count - first : PACKET_SIZE;
+            intersectClosestPacket(rays + first, n, hits + first, found + first);
+        }
+#else
+        for (unsigned int i = 0; i < count; i++)
+            found[i] = IntersectClosest(rays[i].Origin, rays[i].Direction, hits[i], rays[i].TMax);
+#endif
+    }
+
+private:
+#if defined(BVH_COUNT_VISITS)
+    // rays set in a packet traversal mask
+    static unsigned int activeRays(unsigned int mask)
+    {
+        unsigned int n = 0;
+        for (; mask != 0; mask &= mask - 1)
+            n++;
+        return n;
+    }
+#endif
+
+    // single ray any-hit traversal of the subtree below nodeIdx (which the ray is known to hit)
+    bool intersectAnyFrom(unsigned int nodeIdx, const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& invDir, float tMax) const
+    {
+        unsigned int stack[MAX_DEPTH];
+        int stackPtr = 0;
+        while (true)
+        {
+            BVH_COUNT_VISIT();
+            const BVHNode& node = nodes[nodeIdx];
+            if (node.IsLeaf())
+            {
+                BVH_COUNT_TRIANGLES(node.triCount);
+                if (triangles.IntersectAny(origin, dir, node.leftFirst, node.triCount, tMax))
+                    return true; // any hit is enough, stop the traversal
+                if (stackPtr == 0)
+                    break;
+                nodeIdx = stack[--stackPtr];
+                continue;
+            }
+            // visit the nearest child first, push the other one if it's also hit
+            unsigned int child1 = node.leftFirst;
+            unsigned int child2 = node.leftFirst + 1;
+            float dist1 = IntersectRayAABB(origin, invDir, nodes[child1].boundsMin, nodes[child1].boundsMax, tMax);
+            float dist2 = IntersectRayAABB(origin, invDir, nodes[child2].boundsMin, nodes[child2].boundsMax, tMax);
+            if (dist1 > dist2)
+            {
+                swap(dist1, dist2);
+                swap(child1, child2);
+            }
+            if (dist1 == FLT_MAX)
+            {
+                if (stackPtr == 0)
+                    break;
+                nodeIdx = stack[--stackPtr];
+            }
+            else
+            {
+                nodeIdx = child1;
+                if (dist2 != FLT_MAX)
+                    stack[stackPtr++] = child2;
+            }
+        }
+        return false;
+    }
+
+    // stack entry of the compressed traversal: a node, or a leaf's triangle range when triCount > 0
+    struct WideEntry {
+        unsigned int ref;
+        unsigned int triCount;
+        float dist;
+    };
+
+    bool intersectAnyWide(const glm::vec3& origin, const glm::vec3& dir, float tMax) const
+    {
+        glm::vec3 invDir = 1.0f / dir;
+        if (IntersectRayAABB(origin, invDir, wideBounds.min, wideBounds.max, tMax) == FLT_MAX)
+            return false;
+        WideEntry stack[MAX_DEPTH * 3 + 1];
+        int stackPtr = 0;
+        WideEntry root = { 0, 0, 0.0f };
+        stack[stackPtr++] = root;
+        while (stackPtr > 0)
+        {
+            WideEntry entry = stack[--stackPtr];
+            if (entry.triCount > 0)
+            {
+                BVH_COUNT_TRIANGLES(entry.triCount);
+                if (triangles.IntersectAny(origin, dir, entry.ref, entry.triCount, tMax))
+                    return true;
+                continue;
+            }
+            BVH_COUNT_VISIT();
+            stackPtr = pushChildren(wideNodes[entry.ref], origin, invDir, tMax, stack, stackPtr);
+        }
+        return false;
+    }
+
+    bool intersectClosestWide(const glm::vec3& origin, const glm::vec3& dir, HitRecord& hit, float tMax) const
+    {
+        glm::vec3 invDir = 1.0f / dir;
+        if (IntersectRayAABB(origin, invDir, wideBounds.min, wideBounds.max, tMax) == FLT_MAX)
+            return false;
+        WideEntry stack[MAX_DEPTH * 3 + 1];
+        int stackPtr = 0;
+        WideEntry root = { 0, 0, 0.0f };
+        stack[stackPtr++] = root;
+        unsigned int index = 0;
+        float u = 0.0f, v = 0.0f;
+        bool found = false;
+        while (stackPtr > 0)
+        {
+            WideEntry entry = stack[--stackPtr];
+            if (entry.dist > tMax)
+                continue;
+            if (entry.triCount > 0)
+            {
+                BVH_COUNT_TRIANGLES(entry.triCount);
+                found |= triangles.IntersectClosest(origin, dir, entry.ref, entry.triCount, tMax, index, u, v);
+                continue;
+            }
+            BVH_COUNT_VISIT();
+            stackPtr = pushChildren(wideNodes[entry.ref], origin, invDir, tMax, stack, stackPtr);
+        }
+        if (found)
+        {
+            hit.T = tMax;
+            hit.Triangle = triIndices[index];
+            hit.Barycentric = glm::vec2(u, v);
+        }
+        return found;
+    }
+
+    // pushes the children of node the ray hits, nearest last so it is visited first. grow enlarges the child boxes
+    // on every side (the radius of a swept sphere).
+    static int pushChildren(const BVHNode4& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax, WideEntry* stack, int stackPtr,
+                            float grow = 0.0f)
+    {
+        float dist[4];
+        unsigned int mask = intersectChildren(node, origin, invDir, tMax, dist, grow);
+        int first = stackPtr;
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            if (!(mask & (1u << i)))
+                continue;
+            WideEntry entry = { node.child[i], node.triCount[i], dist[i] };
+            int j = stackPtr++;
+            while (j > first && stack[j - 1].dist < entry.dist)
+            {
+                stack[j] = stack[j - 1];
+                j--;
+            }
+            stack[j] = entry;
+        }
+        return stackPtr;
+    }
+
+    // slab test against the four decoded child boxes; returns the mask of children hit and their entry distances
+    static unsigned int intersectChildren(const BVHNode4& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax, float dist[4],
+                                          float grow = 0.0f)
+    {
+        unsigned int valid = (1u << node.childCount) - 1u;
+#if defined(TRIANGLE_SOA_SIMD)
+        // both SIMD paths have SSE4.1, which is exactly four lanes
+        __m128 tEnter = _mm_setzero_ps();
+        __m128 tExit = _mm_set1_ps(FLT_MAX);
+        for (int a = 0; a < 3; a++)
+        {
+            __m128 o = _mm_set1_ps(node.origin[a]);
+            __m128 scale = _mm_set1_ps(node.Scale(a));
+            int qmin, qmax;
+            memcpy(&qmin, node.qmin[a], sizeof(qmin));
+            memcpy(&qmax, node.qmax[a], sizeof(qmax));
+            __m128 lo = _mm_add_ps(o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(qmin))), scale));
+            __m128 hi = _mm_add_ps(o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(qmax))), scale));
+            lo = _mm_sub_ps(lo, _mm_set1_ps(grow));
+            hi = _mm_add_ps(hi, _mm_set1_ps(grow));
+            __m128 rayOrigin = _mm_set1_ps(origin[a]);
+            __m128 rayInvDir = _mm_set1_ps(invDir[a]);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(lo, rayOrigin), rayInvDir);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(hi, rayOrigin), rayInvDir);
+            tEnter = _mm_max_ps(tEnter, _mm_min_ps(t0, t1));
+            tExit = _mm_min_ps(tExit, _mm_max_ps(t0, t1));
+        }
+        tExit = _mm_min_ps(_mm_mul_ps(tExit, _mm_set1_ps(BOX_EXIT_SCALE)), _mm_set1_ps(tMax));
+        _mm_storeu_ps(dist, tEnter);
+        return (unsigned int)_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit)) & valid;
+#else
+        unsigned int mask = 0;
+        for (unsigned int i = 0; i < node.childCount; i++)
+        {
+            glm::vec3 lo, hi;
+            for (int a = 0; a < 3; a++)
+            {
+                lo[a] = node.origin[a] + (float)node.qmin[a][i] * node.Scale(a) - grow;
+                hi[a] = node.origin[a] + (float)node.qmax[a][i] * node.Scale(a) + grow;
+            }
+            dist[i] = IntersectRayAABB(origin, invDir, lo, hi, tMax);
+            if (dist[i] != FLT_MAX)
+                mask |= 1u << i;
+        }
+        return mask & valid;
+#endif
+    }
+
+    // fills wide[wideIdx] from the binary subtree at binaryIdx: the binary children are opened, largest first,
+    // until the node has four children or only leaves are left
+    void compressNode(unsigned int binaryIdx, unsigned int wideIdx, vector<BVHNode4>& wide) const
+    {
+        const BVHNode& node = nodes[binaryIdx];
+        unsigned int children[4];
+        unsigned int count = 0;
+        if (node.IsLeaf())
+        {
+            children[count++] = binaryIdx;
+        }
+        else
+        {
+            children[count++] = node.leftFirst;
+            children[count++] = node.leftFirst + 1;
+        }
+        while (count < 4)
+        {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const BVHNode& child = nodes[children[i]];
+                float area = AABB(child.boundsMin, child.boundsMax).HalfArea();
+                if (!child.IsLeaf() && area > largestArea)
+                {
+                    largest = (int)i;
+                    largestArea = area;
+                }
+            }
+            if (largest < 0)
+                break;
+            unsigned int opened = children[largest];
+            children[largest] = nodes[opened].leftFirst;
+            children[count++] = nodes[opened].leftFirst + 1;
+        }
+
+        BVHNode4 out;
+        memset(&out, 0, sizeof(out));
+        out.origin = node.boundsMin;
+        out.childCount = (unsigned char)count;
+        for (int a = 0; a < 3; a++)
+            out.exponent[a] = (signed char)quantizationExponent(node.boundsMin[a], node.boundsMax[a]);
+        unsigned int firstInner = (unsigned int)wide.size();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const BVHNode& child = nodes[children[i]];
+            for (int a = 0; a < 3; a++)
+            {
+                float scale = out.Scale(a);
+                // round outwards, then fix up in case the division rounded the wrong way
+                int lo = glm::clamp((int)floor((child.boundsMin[a] - out.origin[a]) / scale), 0, 255);
+                while (lo > 0 && out.origin[a] + (float)lo * scale > child.boundsMin[a])
+                    lo--;
+                int hi = glm::clamp((int)ceil((child.boundsMax[a] - out.origin[a]) / scale), 0, 255);
+                while (hi < 255 && out.origin[a] + (float)hi * scale < child.boundsMax[a])
+                    hi++;
+                out.qmin[a][i] = (unsigned char)lo;
+                out.qmax[a][i] = (unsigned char)hi;
+            }
+            if (child.IsLeaf())
+            {
+                out.child[i] = child.leftFirst;
+                out.triCount[i] = (unsigned char)child.triCount;
+            }
+            else
+            {
+                out.child[i] = (unsigned int)wide.size();
+                wide.push_back(BVHNode4());
+            }
+        }
+        wide[wideIdx] = out;
+        unsigned int next = firstInner;
+        for (unsigned int i = 0; i < count; i++)
+            if (!nodes[children[i]].IsLeaf())
+                compressNode(children[i], next++, wide);
+    }
+
+    // smallest power of two step whose 255th multiple still reaches max from min
+    static int quantizationExponent(float min, float max)
+    {
+        int e = 0;
+        frexp((max - min) / 255.0f, &e);
+        e = glm::clamp(e, -126, 127);
+        while (e < 127)
+        {
+            unsigned int bits = (unsigned int)(e + 127) << 23;
+            float scale;
+            memcpy(&scale, &bits, sizeof(scale));
+            if (min + 255.0f * scale >= max)
+                break;
+            e++;
+        }
+        return e;
+    }
+
+    struct PacketEntry {
+        unsigned int node;
+        unsigned int mask;
+    };
+
+    // one packet of up to PACKET_SIZE rays: a node is visited once for every ray of the packet that reaches it,
+    // boxes and triangles are tested against several rays per SIMD instruction, and a ray leaves the packet as
+    // soon as it found a hit.
+    void intersectAnyPacket(const Ray* rays, unsigned int count, bool* hits) const
+    {
+        for (unsigned int i = 0; i < count; i++)
+            hits[i] = false;
+        if (nodeCount == 0)
+            return;
+
+        glm::vec3 origins[PACKET_SIZE], directions[PACKET_SIZE];
+        float tMax[PACKET_SIZE];
+        for (unsigned int i = 0; i < count; i++)
+        {
+            origins[i] = rays[i].Origin;
+            directions[i] = rays[i].Direction;
+            tMax[i] = rays[i].TMax;
+        }
+        RayPacket packet;
+        packet.Set(origins, directions, tMax, count);
+
+        float tNear;
+        unsigned int active = IntersectPacketAABB(packet, packet.AllMask(), nodes[0].boundsMin, nodes[0].boundsMax, tNear);
+        PacketEntry stack[MAX_DEPTH];
+        int stackPtr = 0;
+        PacketEntry entry = { 0, active };
+        while (true)
+        {
+            // rays that hit something in the meantime don't need to visit this node anymore
+            unsigned int mask = entry.mask & active;
+            const BVHNode& node = nodes[entry.node];
+            if (mask != 0 && (mask & (mask - 1)) == 0 && !node.IsLeaf())
+            {
+                // a single ray left in this subtree: the packet bookkeeping no longer pays off
+                unsigned int i = 0;
+                while (!(mask & (1u << i)))
+                    i++;
+                glm::vec3 invDir(packet.idx[i], packet.idy[i], packet.idz[i]);
+                if (intersectAnyFrom(entry.node, rays[i].Origin, rays[i].Direction, invDir, rays[i].TMax))
+                {
+                    hits[i] = true;
+                    active &= ~mask;
+                    if (active == 0)
+                        break;
+                }
+            }
+            else if (mask != 0 && node.IsLeaf())
+            {
+                BVH_COUNT_TRIANGLES(node.triCount * activeRays(mask));
+                unsigned int leafHits = triangles.IntersectAny(packet, mask, node.leftFirst, node.triCount);
+                for (unsigned int i = 0; i < count; i++)
+                    if (leafHits & (1u << i))
+                        hits[i] = true;
+                active &= ~leafHits;
+                if (active == 0)
+                    break;
+            }
+            else if (mask != 0)
+            {
+                // test the packet against both children, then visit the child the packet reaches first
+                unsigned int child1 = node.leftFirst;
+                unsigned int child2 = node.leftFirst + 1;
+                float near1, near2;
+                unsigned int mask1 = IntersectPacketAABB(packet, mask, nodes[child1].boundsMin, nodes[child1].boundsMax, near1);
+                unsigned int mask2 = IntersectPacketAABB(packet, mask, nodes[child2].boundsMin, nodes[child2].boundsMax, near2);
+                if (near1 > near2)
+                {
+                    swap(child1, child2);
+                    swap(mask1, mask2);
+                }
+                if (mask1 != 0)
+                {
+                    if (mask2 != 0)
+                    {
+                        PacketEntry far = { child2, mask2 };
+                        stack[stackPtr++] = far;
+                    }
+                    entry.node = child1;
+                    entry.mask = mask1;
+                    continue;
+                }
+                if (mask2 != 0)
+                {
+                    entry.node = child2;
+                    entry.mask = mask2;
+                    continue;
+                }
+            }
+            if (stackPtr == 0)
+                break;
+            entry = stack[--stackPtr];
+        }
+    }
+
+    // one packet of up to PACKET_SIZE rays for the closest hit: like intersectAnyPacket, but every ray stays until
+    // the traversal ends and a hit only lowers its cut-off, which the box tests of later nodes see
+    void intersectClosestPacket(const Ray* rays, unsigned int count, HitRecord* hits, bool* found) const
+    {
+        for (unsigned int i = 0; i < count; i++)
+            found[i] = false;
+        if (nodeCount == 0)
+            return;
+
+        glm::vec3 origins[PACKET_SIZE], directions[PACKET_SIZE];
+        float tMax[PACKET_SIZE];
+        for (unsigned int i = 0; i < count; i++)
+        {
+            origins[i] = rays[i].Origin;
+            directions[i] = rays[i].Direction;
+            tMax[i] = rays[i].TMax;
+        }
+        RayPacket packet;
+        packet.Set(origins, directions, tMax, count);
+
+        unsigned int index[PACKET_SIZE];
+        float u[PACKET_SIZE], v[PACKET_SIZE];
+        unsigned int hitMask = 0;
+        float tNear;
+        PacketEntry stack[MAX_DEPTH];
+        int stackPtr = 0;
+        PacketEntry entry = { 0, IntersectPacketAABB(packet, packet.AllMask(), nodes[0].boundsMin, nodes[0].boundsMax, tNear) };
+        while (true)
+        {
+            const BVHNode& node = nodes[entry.node];
+            if (entry.mask != 0 && node.IsLeaf())
+            {
+                BVH_COUNT_TRIANGLES(node.triCount * activeRays(entry.mask));
+                hitMask |= triangles.IntersectClosest(packet, entry.mask, node.leftFirst, node.triCount, index, u, v);
+            }
+            else if (entry.mask != 0)
+            {
+                // the children are tested against the rays' current cut-offs, so rays that found a closer hit since
+                // this node was pushed drop out here
+                unsigned int child1 = node.leftFirst;
+                unsigned int child2 = node.leftFirst + 1;
+                float near1, near2;
+                unsigned int mask1 = IntersectPacketAABB(packet, entry.mask, nodes[child1].boundsMin, nodes[child1].boundsMax, near1);
+                unsigned int mask2 = IntersectPacketAABB(packet, entry.mask, nodes[child2].boundsMin, nodes[child2].boundsMax, near2);
+                if (near1 > near2)
+                {
+                    swap(child1, child2);
+                    swap(mask1, mask2);
+                }
+                if (mask1 != 0)
+                {
+                    if (mask2 != 0)
+                    {
+                        PacketEntry far = { child2, mask2 };
+                        stack[stackPtr++] = far;
+                    }
+                    entry.node = child1;
+                    entry.mask = mask1;
+                    continue;
+                }
+                if (mask2 != 0)
+                {
+                    entry.node = child2;
+                    entry.mask = mask2;
+                    continue;
+                }
+            }
+            if (stackPtr == 0)
+                break;
+            entry = stack[--stackPtr];
+        }
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (!(hitMask & (1u << i)))
+                continue;
+            found[i] = true;
+            hits[i].T = packet.tMax[i];
+            hits[i].Triangle = triIndices[index[i]];
+            hits[i].Barycentric = glm::vec2(u[i], v[i]);
+        }
+    }
+
+    // arrays owned by a built BVH, and the owner of the memory a viewed BVH points into
+    vector<BVHNode>      nodeStorage;
+    vector<unsigned int> triIndexStorage;
+    shared_ptr<const void> owner;
+
+    // compressed nodes, with room to start them on a cache line, and the exact bounds of the root
+    vector<unsigned char> wideStorage;
+    AABB                  wideBounds;
+
+    // build scratch data
+    vector<AABB>      bounds;
+    vector<glm::vec3> centroids;
+
+    void bindStorage()
+    {
+        nodes = nodeStorage.empty() ? NULL : nodeStorage.data();
+        nodeCount = (unsigned int)nodeStorage.size();
+        triIndices = triIndexStorage.empty() ? NULL : triIndexStorage.data();
+        triangleCount = (unsigned int)triIndexStorage.size();
+    }
+
+    void bindWideStorage(unsigned int count)
+    {
+        if (wideStorage.empty())
+        {
+            wideNodes = NULL;
+            wideNodeCount = 0;
+            return;
+        }
+        size_t address = (size_t)wideStorage.data();
+        wideNodes = (const BVHNode4*)(wideStorage.data() + ((64 - address % 64) % 64));
+        wideNodeCount = count;
+    }
+
+    // leaves are tested TriangleSoA::WIDTH triangles at a time, so the SAH counts batches instead of triangles
+    static float batches(unsigned int triCount)
+    {
+        return (float)((triCount + TriangleSoA::WIDTH - 1) / TriangleSoA::WIDTH);
+    }
+
+    void updateBounds(unsigned int nodeIdx)
+    {
+        BVHNode& node = nodeStorage[nodeIdx];
+        AABB b;
+        for (unsigned int i = 0; i < node.triCount; i++)
+            b.Grow(bounds[triIndexStorage[node.leftFirst + i]]);
+        node.boundsMin = b.min;
+        node.boundsMax = b.max;
+    }
+
+    // binned SAH: evaluates BINS - 1 split planes per axis over the centroid bounds and returns the cheapest one
+    float findBestSplit(const BVHNode& node, int& axis, float& splitPos) const
+    {
+        AABB centroidBounds;
+        for (unsigned int i = 0; i < node.triCount; i++)
+            centroidBounds.Grow(centroids[triIndexStorage[node.leftFirst + i]]);
+
+        float bestCost = FLT_MAX;
+        for (int a = 0; a < 3; a++)
+        {
+            float boundsMin = centroidBounds.min[a];
+            float boundsMax = centroidBounds.max[a];
+            if (boundsMin == boundsMax)
+                continue;
+
+            AABB binBounds[BINS];
+            unsigned int binCount[BINS] = { 0 };
+            float scale = BINS / (boundsMax - boundsMin);
+            for (unsigned int i = 0; i < node.triCount; i++)
+            {
+                unsigned int tri = triIndexStorage[node.leftFirst + i];
+                int bin = min(BINS - 1, (int)((centroids[tri][a] - boundsMin) * scale));
+                binCount[bin]++;
+                binBounds[bin].Grow(bounds[tri]);
+            }
+
+            // sweep from both sides to gather the area and count of every split candidate
+            float leftArea[BINS - 1], rightArea[BINS - 1];
+            unsigned int leftCount[BINS - 1], rightCount[BINS - 1];
+            AABB leftBox, rightBox;
+            unsigned int leftSum = 0, rightSum = 0;
+            for (int i = 0; i < BINS - 1; i++)
+            {
+                leftSum += binCount[i];
+                leftCount[i] = leftSum;
+                leftBox.Grow(binBounds[i]);
+                leftArea[i] = leftBox.HalfArea();
+                rightSum += binCount[BINS - 1 - i];
+                rightCount[BINS - 2 - i] = rightSum;
+                rightBox.Grow(binBounds[BINS - 1 - i]);
+                rightArea[BINS - 2 - i] = rightBox.HalfArea();
+            }
+            float binWidth = (boundsMax - boundsMin) / BINS;
+            for (int i = 0; i < BINS - 1; i++)
+            {
+                float cost = batches(leftCount[i]) * leftArea[i] + batches(rightCount[i]) * rightArea[i];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    axis = a;
+                    splitPos = boundsMin + binWidth * (i + 1);
+                }
+            }
+        }
+        return bestCost;
+    }
+
+    void subdivide(unsigned int nodeIdx, int depth)
+    {
+        BVHNode& node = nodeStorage[nodeIdx];
+        if (node.triCount <= 1 || depth >= MAX_DEPTH - 1)
+            return;
+        // too big leaves are split even where the SAH disagrees
+        bool tooBig = node.triCount > MAX_LEAF_SIZE;
+
+        int axis = 0;
+        float splitPos = 0.0f;
+        float splitCost = findBestSplit(node, axis, splitPos);
+        AABB nodeBounds(node.boundsMin, node.boundsMax);
+        float leafCost = batches(node.triCount) * nodeBounds.HalfArea();
+        if (!tooBig && splitCost + TRAVERSAL_COST * nodeBounds.HalfArea() >= leafCost)
+            return; // splitting doesn't pay off, keep this node as a leaf
+
+        // partition the triangle ids in place around the split plane
+        int i = node.leftFirst;
+        if (splitCost != FLT_MAX)
+        {
+            int j = i + node.triCount - 1;
+            while (i <= j)
+            {
+                if (centroids[triIndexStorage[i]][axis] < splitPos)
+                    i++;
+                else
+                    swap(triIndexStorage[i], triIndexStorage[j--]);
+            }
+        }
+        unsigned int leftCount = i - node.leftFirst;
+        if (leftCount == 0 || leftCount == node.triCount)
+        {
+            if (!tooBig)
+                return;
+            // no plane separates the centroids: halve the list
+            leftCount = node.triCount / 2;
+            i = node.leftFirst + leftCount;
+        }
+
+        unsigned int leftChildIdx = (unsigned int)nodeStorage.size();
+        BVHNode left, right;
+        left.leftFirst = node.leftFirst;
+        left.triCount = leftCount;
+        right.leftFirst = i;
+        right.triCount = node.triCount - leftCount;
+        node.leftFirst = leftChildIdx;
+        node.triCount = 0;
+        // push_back may reallocate, so 'node' must not be used after this point
+        nodeStorage.push_back(left);
+        nodeStorage.push_back(right);
+        updateBounds(leftChildIdx);
+        updateBounds(leftChildIdx + 1);
+        subdivide(leftChildIdx, depth + 1);
+        subdivide(leftChildIdx + 1, depth + 1);
+    }
+};
+#endif
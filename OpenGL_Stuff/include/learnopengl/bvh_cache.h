@@ -0,0 +1,172 @@
+#ifndef BVH_CACHE_H
+#define BVH_CACHE_H
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/mapped_file.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+using namespace std;
+
+// On-disk cache of the BVHs of a model, stored next to the model file (e.g. scene.gltf.bvh). The file only holds
+// offsets, never pointers, so it is mapped read-only and the BVHs point straight into it:
+//
+//   BVHCacheHeader | BVHCacheEntry per mesh | per mesh: nodes, triangle ids, SoA triangles
+//
+// Every section starts on a 64 byte boundary. A mesh's entry is keyed by a hash of its positions and indices, so
+// an edited model simply rebuilds. Bump BVH_CACHE_VERSION whenever the node or triangle layout changes.
+const uint32_t BVH_CACHE_VERSION = 2;
+const uint32_t BVH_CACHE_ENDIAN = 0x01020304;
+
+struct BVHCacheHeader {
+    char Magic[8];          // "BVHCACHE"
+    uint32_t Version;
+    uint32_t Endian;        // BVH_CACHE_ENDIAN as written by the machine that built the file
+    uint32_t NodeSize;      // sizeof(BVHNode)
+    uint32_t Padding;       // TriangleSoA::PADDING
+    uint32_t MeshCount;
+    uint32_t TriangleFormat;  // TriangleSoA::FORMAT
+};
+
+struct BVHCacheEntry {
+    uint64_t Hash;
+    uint32_t NodeCount;
+    uint32_t TriangleCount;
+    uint64_t NodeOffset;
+    uint64_t IndexOffset;
+    uint64_t TriangleOffset;
+};
+
+// 64 bit FNV-1a over the vertex positions and the indices, the only inputs of BVH::Build
+template <typename VertexT>
+uint64_t HashMeshGeometry(const vector<VertexT>& vertices, const vector<unsigned int>& indices)
+{
+    uint64_t hash = 14695981039346656037ull;
+    const uint64_t prime = 1099511628211ull;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const unsigned char* p = (const unsigned char*)&vertices[i].Position;
+        for (size_t b = 0; b < sizeof(vertices[i].Position); b++)
+            hash = (hash ^ p[b]) * prime;
+    }
+    const unsigned char* p = (const unsigned char*)indices.data();
+    for (size_t b = 0; b < indices.size() * sizeof(unsigned int); b++)
+        hash = (hash ^ p[b]) * prime;
+    return hash;
+}
+
+inline uint64_t alignCacheOffset(uint64_t offset)
+{
+    return (offset + 63) & ~(uint64_t)63;
+}
+
+// writes a block of a cache file at the given offset, padding up to it with zeros: written is where the file ends
+// and moves past the block. The gaps are the ones alignCacheOffset leaves, under 64 bytes.
+inline void writeCacheBlock(ostream& out, uint64_t& written, uint64_t at, const void* block, uint64_t bytes)
+{
+    static const char zeros[64] = { 0 };
+    out.write(zeros, (streamsize)(at - written));
+    out.write((const char*)block, (streamsize)bytes);
+    written = at + bytes;
+}
+
+// Gives every mesh its BVH: mapped from the cache if the file matches all meshes, otherwise built and written
+// back so the next run can map it. Returns true if the cache was used.
+template <typename MeshT>
+bool LoadOrBuildBVHs(vector<MeshT>& meshes, const string& cachePath)
+{
+    vector<uint64_t> hashes(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+        hashes[i] = HashMeshGeometry(meshes[i].vertices, meshes[i].indices);
+
+    shared_ptr<MappedFile> file = make_shared<MappedFile>();
+    if (file->Open(cachePath))
+    {
+        const unsigned char* data = file->Data();
+        size_t size = file->Size();
+        const BVHCacheHeader* header = (const BVHCacheHeader*)data;
+        const BVHCacheEntry* entries = (const BVHCacheEntry*)(data + sizeof(BVHCacheHeader));
+        bool valid = size >= sizeof(BVHCacheHeader) && memcmp(header->Magic, "BVHCACHE", 8) == 0 &&
+                     header->Version == BVH_CACHE_VERSION && header->Endian == BVH_CACHE_ENDIAN &&
+                     header->NodeSize == sizeof(BVHNode) && header->Padding == TriangleSoA::PADDING &&
+                     header->TriangleFormat == TriangleSoA::FORMAT && header->MeshCount == meshes.size() &&
+                     size >= sizeof(BVHCacheHeader) + meshes.size() * sizeof(BVHCacheEntry);
+        for (size_t i = 0; valid && i < meshes.size(); i++)
+        {
+            const BVHCacheEntry& e = entries[i];
+            uint64_t triangleFloats = e.TriangleCount == 0 ? 0 : ((uint64_t)e.TriangleCount + TriangleSoA::PADDING) * 9;
+            valid = e.Hash == hashes[i] && e.TriangleCount == meshes[i].indices.size() / 3 &&
+                    e.NodeOffset + (uint64_t)e.NodeCount * sizeof(BVHNode) <= size &&
+                    e.IndexOffset + (uint64_t)e.TriangleCount * sizeof(unsigned int) <= size &&
+                    e.TriangleOffset + triangleFloats * sizeof(float) <= size;
+        }
+        if (valid)
+        {
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                const BVHCacheEntry& e = entries[i];
+                meshes[i].bvh.View((const BVHNode*)(data + e.NodeOffset), e.NodeCount, (const unsigned int*)(data + e.IndexOffset),
+                                   (const float*)(data + e.TriangleOffset), e.TriangleCount, file);
+            }
+            return true;
+        }
+        // the file is stale; release it so it can be overwritten
+        file->Close();
+    }
+
+    for (size_t i = 0; i < meshes.size(); i++)
+        meshes[i].bvh.Build(meshes[i].vertices, meshes[i].indices);
+
+    // lay out the sections and write the new cache
+    BVHCacheHeader header;
+    memcpy(header.Magic, "BVHCACHE", 8);
+    header.Version = BVH_CACHE_VERSION;
+    header.Endian = BVH_CACHE_ENDIAN;
+    header.NodeSize = sizeof(BVHNode);
+    header.Padding = TriangleSoA::PADDING;
+    header.MeshCount = (uint32_t)meshes.size();
+    header.TriangleFormat = TriangleSoA::FORMAT;
+    vector<BVHCacheEntry> entries(meshes.size());
+    uint64_t offset = alignCacheOffset(sizeof(BVHCacheHeader) + meshes.size() * sizeof(BVHCacheEntry));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const BVH& bvh = meshes[i].bvh;
+        BVHCacheEntry& e = entries[i];
+        e.Hash = hashes[i];
+        e.NodeCount = bvh.nodeCount;
+        e.TriangleCount = bvh.triangleCount;
+        e.NodeOffset = offset;
+        offset = alignCacheOffset(offset + (uint64_t)bvh.nodeCount * sizeof(BVHNode));
+        e.IndexOffset = offset;
+        offset = alignCacheOffset(offset + (uint64_t)bvh.triangleCount * sizeof(unsigned int));
+        e.TriangleOffset = offset;
+        offset = alignCacheOffset(offset + bvh.triangles.DataFloats() * sizeof(float));
+    }
+
+    ofstream out(cachePath.c_str(), ios::binary | ios::trunc);
+    if (!out)
+    {
+        std::cout << "BVH cache could not be written: " << cachePath << std::endl;
+        return false;
+    }
+    uint64_t written = 0;
+    writeCacheBlock(out, written, 0, &header, sizeof(header));
+    writeCacheBlock(out, written, written, entries.data(), entries.size() * sizeof(BVHCacheEntry));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const BVH& bvh = meshes[i].bvh;
+        writeCacheBlock(out, written, entries[i].NodeOffset, bvh.nodes, (uint64_t)bvh.nodeCount * sizeof(BVHNode));
+        writeCacheBlock(out, written, entries[i].IndexOffset, bvh.triIndices, (uint64_t)bvh.triangleCount * sizeof(unsigned int));
+        writeCacheBlock(out, written, entries[i].TriangleOffset, bvh.triangles.Data(), bvh.triangles.DataFloats() * sizeof(float));
+    }
+    writeCacheBlock(out, written, offset, NULL, 0);
+    if (!out)
+        std::cout << "BVH cache could not be written: " << cachePath << std::endl;
+    return false;
+}
+#endif
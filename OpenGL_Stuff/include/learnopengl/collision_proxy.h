@@ -0,0 +1,442 @@
+#ifndef COLLISION_PROXY_H
+#define COLLISION_PROXY_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cfloat>
+#include <cmath>
+using namespace std;
+
+enum ProxyShape {
+    PROXY_NONE,
+    PROXY_SPHERE,
+    PROXY_BOX,
+    PROXY_CAPSULE,
+    PROXY_DISC
+};
+
+// Analytic stand-in for the collision mesh of a model: a sphere, an oriented box, a capsule or a disc (a flat
+// cylinder). The proxy always encloses every vertex, so a ray that misses it cannot hit the mesh, and no point of
+// its surface is farther than Error model units from the mesh. The shape lives in its own frame: model space point =
+// Center + Axes * local point, with the capsule segment and the disc normal along the local z axis.
+//   sphere:  Extents.x = radius
+//   box:     Extents = half sizes
+//   capsule: Extents.x = radius, Extents.z = half length of the segment
+//   disc:    Extents.x = radius, Extents.z = half thickness
+struct CollisionProxy {
+    ProxyShape Shape;
+    glm::vec3 Center;
+    glm::mat3 Axes;
+    glm::vec3 Extents;
+    float Error;
+
+    CollisionProxy() : Shape(PROXY_NONE), Center(0.0f), Axes(1.0f), Extents(0.0f), Error(FLT_MAX) {}
+
+    // entry distance of a model space ray into the proxy grown by grow (the radius of a swept sphere; boxes and
+    // discs grow by their sharp corners, so they stay conservative), 0 if the origin is inside, FLT_MAX if it is
+    // missed or only reached past tMax. Without a proxy everything may hit, so this returns 0.
+    float Intersect(const glm::vec3& origin, const glm::vec3& dir, float grow, float tMax) const
+    {
+        glm::vec3 o = glm::transpose(Axes) * (origin - Center);
+        glm::vec3 d = glm::transpose(Axes) * dir;
+        float t;
+        switch (Shape)
+        {
+        case PROXY_NONE:
+            return 0.0f;
+        case PROXY_SPHERE:
+            t = intersectSphere(o, d, Extents.x + grow);
+            break;
+        case PROXY_BOX:
+            t = intersectBox(o, d, Extents + glm::vec3(grow));
+            break;
+        case PROXY_CAPSULE:
+            t = intersectCapsule(o, d, Extents.x + grow, Extents.z);
+            break;
+        default:
+            t = intersectCylinder(o, d, Extents.x + grow, Extents.z + grow);
+            break;
+        }
+        return t < tMax ? t : FLT_MAX;
+    }
+
+    float Volume() const
+    {
+        const float PI = 3.14159265f;
+        switch (Shape)
+        {
+        case PROXY_SPHERE:
+            return 4.0f / 3.0f * PI * Extents.x * Extents.x * Extents.x;
+        case PROXY_BOX:
+            return 8.0f * Extents.x * Extents.y * Extents.z;
+        case PROXY_CAPSULE:
+            return PI * Extents.x * Extents.x * (2.0f * Extents.z + 4.0f / 3.0f * Extents.x);
+        case PROXY_DISC:
+            return PI * Extents.x * Extents.x * 2.0f * Extents.z;
+        default:
+            return FLT_MAX;
+        }
+    }
+
+    // sample points on the surface, in model space, for measuring the fit
+    void SampleSurface(vector<glm::vec3>& points) const
+    {
+        const int RINGS = 12, SEGMENTS = 24;
+        const float PI = 3.14159265f;
+        points.clear();
+        // every point is added in the local frame and moved to model space at the end
+        auto add = [&](const glm::vec3& p) {
+            points.push_back(Center + Axes * p);
+        };
+        switch (Shape)
+        {
+        case PROXY_SPHERE:
+        case PROXY_CAPSULE:
+            // two hemispheres moved apart by the capsule segment (0 for a sphere), plus the capsule's side
+            for (int i = 0; i < RINGS; i++)
+            {
+                float polar = PI * i / (RINGS - 1);
+                for (int j = 0; j < SEGMENTS; j++)
+                {
+                    float azimuth = 2.0f * PI * j / SEGMENTS;
+                    glm::vec3 n(sinf(polar) * cosf(azimuth), sinf(polar) * sinf(azimuth), cosf(polar));
+                    float shift = Shape == PROXY_CAPSULE ? (n.z >= 0.0f ? Extents.z : -Extents.z) : 0.0f;
+                    add(n * Extents.x + glm::vec3(0.0f, 0.0f, shift));
+                }
+            }
+            if (Shape == PROXY_CAPSULE)
+                for (int i = 0; i < RINGS; i++)
+                    for (int j = 0; j < SEGMENTS; j++)
+                    {
+                        float azimuth = 2.0f * PI * j / SEGMENTS;
+                        glm::vec3 n(cosf(azimuth), sinf(azimuth), 0.0f);
+                        add(n * Extents.x + glm::vec3(0.0f, 0.0f, Extents.z * ((float)i / (RINGS - 1) * 2.0f - 1.0f)));
+                    }
+            break;
+        case PROXY_BOX:
+            // a grid on each face, edges and corners included since they stray farthest from a rounded mesh
+            for (int axis = 0; axis < 3; axis++)
+                for (int side = -1; side <= 1; side += 2)
+                    for (int i = 0; i < RINGS; i++)
+                        for (int j = 0; j < RINGS; j++)
+                        {
+                            glm::vec3 p;
+                            p[axis] = side * Extents[axis];
+                            p[(axis + 1) % 3] = Extents[(axis + 1) % 3] * ((float)i / (RINGS - 1) * 2.0f - 1.0f);
+                            p[(axis + 2) % 3] = Extents[(axis + 2) % 3] * ((float)j / (RINGS - 1) * 2.0f - 1.0f);
+                            add(p);
+                        }
+            break;
+        case PROXY_DISC:
+            // rings on both caps and the side, rims included
+            for (int i = 0; i < RINGS; i++)
+                for (int j = 0; j < SEGMENTS; j++)
+                {
+                    float azimuth = 2.0f * PI * j / SEGMENTS;
+                    glm::vec3 radial(cosf(azimuth), sinf(azimuth), 0.0f);
+                    float r = Extents.x * i / (RINGS - 1);
+                    add(radial * r + glm::vec3(0.0f, 0.0f, Extents.z));
+                    add(radial * r - glm::vec3(0.0f, 0.0f, Extents.z));
+                    add(radial * Extents.x + glm::vec3(0.0f, 0.0f, Extents.z * ((float)i / (RINGS - 1) * 2.0f - 1.0f)));
+                }
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    static float intersectSphere(const glm::vec3& o, const glm::vec3& d, float radius)
+    {
+        float c = glm::dot(o, o) - radius * radius;
+        if (c <= 0.0f)
+            return 0.0f;
+        float a = glm::dot(d, d);
+        float b = glm::dot(o, d);
+        float discriminant = b * b - a * c;
+        if (b >= 0.0f || discriminant < 0.0f)
+            return FLT_MAX;
+        return (-b - sqrtf(discriminant)) / a;
+    }
+
+    static float intersectBox(const glm::vec3& o, const glm::vec3& d, const glm::vec3& half)
+    {
+        float tNear = 0.0f, tFar = FLT_MAX;
+        for (int i = 0; i < 3; i++)
+        {
+            if (fabsf(d[i]) < 1e-20f)
+            {
+                if (fabsf(o[i]) > half[i])
+                    return FLT_MAX;
+                continue;
+            }
+            float inv = 1.0f / d[i];
+            float t0 = (-half[i] - o[i]) * inv;
+            float t1 = (half[i] - o[i]) * inv;
+            tNear = glm::max(tNear, glm::min(t0, t1));
+            tFar = glm::min(tFar, glm::max(t0, t1));
+        }
+        return tNear <= tFar ? tNear : FLT_MAX;
+    }
+
+    // cylinder around the z axis, capped at z = +-halfHeight
+    static float intersectCylinder(const glm::vec3& o, const glm::vec3& d, float radius, float halfHeight)
+    {
+        float tNear = 0.0f, tFar = FLT_MAX;
+        float a = d.x * d.x + d.y * d.y;
+        float b = o.x * d.x + o.y * d.y;
+        float c = o.x * o.x + o.y * o.y - radius * radius;
+        if (a < 1e-20f)
+        {
+            if (c > 0.0f)
+                return FLT_MAX;
+        }
+        else
+        {
+            float discriminant = b * b - a * c;
+            if (discriminant < 0.0f)
+                return FLT_MAX;
+            float root = sqrtf(discriminant);
+            tNear = glm::max(tNear, (-b - root) / a);
+            tFar = (-b + root) / a;
+        }
+        if (fabsf(d.z) < 1e-20f)
+        {
+            if (fabsf(o.z) > halfHeight)
+                return FLT_MAX;
+        }
+        else
+        {
+            float t0 = (-halfHeight - o.z) / d.z;
+            float t1 = (halfHeight - o.z) / d.z;
+            tNear = glm::max(tNear, glm::min(t0, t1));
+            tFar = glm::min(tFar, glm::max(t0, t1));
+        }
+        return tNear <= tFar ? tNear : FLT_MAX;
+    }
+
+    // capsule around the segment z = -halfLength..halfLength: the side of the cylinder where it lies along the
+    // segment, or one of the end spheres
+    static float intersectCapsule(const glm::vec3& o, const glm::vec3& d, float radius, float halfLength)
+    {
+        glm::vec3 closest(0.0f, 0.0f, glm::clamp(o.z, -halfLength, halfLength));
+        if (glm::dot(o - closest, o - closest) <= radius * radius)
+            return 0.0f;
+        float best = FLT_MAX;
+        float a = d.x * d.x + d.y * d.y;
+        float b = o.x * d.x + o.y * d.y;
+        float c = o.x * o.x + o.y * o.y - radius * radius;
+        float discriminant = b * b - a * c;
+        if (a >= 1e-20f && b < 0.0f && discriminant >= 0.0f)
+        {
+            float t = (-b - sqrtf(discriminant)) / a;
+            if (fabsf(o.z + t * d.z) <= halfLength)
+                best = t;
+        }
+        glm::vec3 end(0.0f, 0.0f, halfLength);
+        best = glm::min(best, intersectSphere(o - end, d, radius));
+        best = glm::min(best, intersectSphere(o + end, d, radius));
+        return best;
+    }
+};
+
+// eigenvectors (columns of vectors) of a symmetric 3x3 matrix by cyclic Jacobi rotations
+inline void symmetricEigenvectors(glm::mat3 a, glm::mat3& vectors)
+{
+    vectors = glm::mat3(1.0f);
+    for (int sweep = 0; sweep < 16; sweep++)
+    {
+        for (int p = 0; p < 2; p++)
+            for (int q = p + 1; q < 3; q++)
+            {
+                if (fabsf(a[q][p]) < 1e-12f)
+                    continue;
+                float theta = (a[q][q] - a[p][p]) / (2.0f * a[q][p]);
+                float t = (theta >= 0.0f ? 1.0f : -1.0f) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+                float c = 1.0f / sqrtf(t * t + 1.0f), s = t * c;
+                glm::mat3 rotation(1.0f);
+                rotation[p][p] = c;
+                rotation[q][q] = c;
+                rotation[q][p] = s;
+                rotation[p][q] = -s;
+                a = glm::transpose(rotation) * a * rotation;
+                vectors = vectors * rotation;
+            }
+    }
+}
+
+// the proxy's axes must stay a right-handed rotation so transposing them inverts them
+inline glm::mat3 orderedAxes(const glm::mat3& frame, int zAxis)
+{
+    glm::mat3 axes;
+    axes[2] = frame[zAxis];
+    axes[0] = frame[(zAxis + 1) % 3];
+    axes[1] = glm::cross(axes[2], axes[0]);
+    return axes;
+}
+
+// the frame turned about its column axis to the angle where the vertices' bounding rectangle across that axis is
+// smallest, searched in 2 degree steps
+inline glm::mat3 tightestFrameAbout(const vector<glm::vec3>& points, const glm::mat3& frame, int axis)
+{
+    glm::vec3 a = frame[(axis + 1) % 3], b = frame[(axis + 2) % 3];
+    float bestArea = FLT_MAX;
+    glm::mat3 best = frame;
+    for (int step = 0; step < 45; step++)
+    {
+        float angle = glm::radians(2.0f * step);
+        glm::vec3 u = cosf(angle) * a + sinf(angle) * b;
+        glm::vec3 v = glm::cross(frame[axis], u);
+        glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            glm::vec2 q(glm::dot(points[i], u), glm::dot(points[i], v));
+            lo = glm::min(lo, q);
+            hi = glm::max(hi, q);
+        }
+        float area = (hi.x - lo.x) * (hi.y - lo.y);
+        if (area < bestArea)
+        {
+            bestArea = area;
+            best[(axis + 1) % 3] = u;
+            best[(axis + 2) % 3] = v;
+        }
+    }
+    return best;
+}
+
+// Fits every proxy shape to the vertices in the given frame (columns orthonormal) and appends them to candidates.
+inline void fitProxiesInFrame(const vector<glm::vec3>& points, const glm::mat3& frame, vector<CollisionProxy>& candidates)
+{
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        glm::vec3 q = glm::transpose(frame) * points[i];
+        lo = glm::min(lo, q);
+        hi = glm::max(hi, q);
+    }
+    glm::vec3 center = frame * ((lo + hi) * 0.5f);
+    glm::vec3 size = hi - lo;
+    int longest = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+    int shortest = size.x < size.y && size.x < size.z ? 0 : (size.y < size.z ? 1 : 2);
+
+    CollisionProxy box;
+    box.Shape = PROXY_BOX;
+    box.Center = center;
+    box.Axes = frame;
+    box.Extents = size * 0.5f;
+    candidates.push_back(box);
+
+    CollisionProxy sphere;
+    sphere.Shape = PROXY_SPHERE;
+    sphere.Center = center;
+    for (size_t i = 0; i < points.size(); i++)
+        sphere.Extents.x = glm::max(sphere.Extents.x, glm::length(points[i] - center));
+    candidates.push_back(sphere);
+
+    // the capsule runs along the longest side and the disc is normal to the shortest
+    CollisionProxy capsule;
+    capsule.Shape = PROXY_CAPSULE;
+    capsule.Center = center;
+    capsule.Axes = orderedAxes(frame, longest);
+    CollisionProxy disc;
+    disc.Shape = PROXY_DISC;
+    disc.Center = center;
+    disc.Axes = orderedAxes(frame, shortest);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        glm::vec3 q = glm::transpose(capsule.Axes) * (points[i] - center);
+        capsule.Extents.x = glm::max(capsule.Extents.x, glm::length(glm::vec2(q)));
+        q = glm::transpose(disc.Axes) * (points[i] - center);
+        disc.Extents.x = glm::max(disc.Extents.x, glm::length(glm::vec2(q)));
+        disc.Extents.z = glm::max(disc.Extents.z, fabsf(q.z));
+    }
+    // shortest segment that keeps every vertex within the radius: a vertex at height z and distance r from the
+    // axis needs a segment point within w = sqrt(radius^2 - r^2) of z
+    float segmentLo = FLT_MAX, segmentHi = -FLT_MAX;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        glm::vec3 q = glm::transpose(capsule.Axes) * (points[i] - center);
+        float r2 = q.x * q.x + q.y * q.y;
+        float w = sqrtf(glm::max(capsule.Extents.x * capsule.Extents.x - r2, 0.0f));
+        segmentLo = glm::min(segmentLo, q.z + w);
+        segmentHi = glm::max(segmentHi, q.z - w);
+    }
+    capsule.Center += capsule.Axes[2] * ((segmentLo + segmentHi) * 0.5f);
+    capsule.Extents.z = glm::max((segmentHi - segmentLo) * 0.5f, 0.0f);
+    candidates.push_back(capsule);
+    candidates.push_back(disc);
+}
+
+// Fits the smallest proxy whose surface stays within maxError (model units) of a mesh, given its vertices and a
+// proximity query: nearMesh(point, distance) is true if the mesh comes within distance of point. Every shape is
+// fitted in the model axes, in the mesh's principal axes, and in those axes turned about each one to the tightest
+// box, since the principal axes of a square board are ambiguous across it. A fit is checked on samples of its
+// surface, and the one kept gets its Error measured. If no fit is close enough the returned proxy is PROXY_NONE and
+// queries fall back to the mesh.
+template <typename NearMesh>
+CollisionProxy FitCollisionProxy(const vector<glm::vec3>& points, float maxError, NearMesh nearMesh)
+{
+    CollisionProxy best;
+    if (points.empty())
+        return best;
+    glm::vec3 mean(0.0f);
+    for (size_t i = 0; i < points.size(); i++)
+        mean += points[i];
+    mean /= (float)points.size();
+    glm::mat3 covariance(0.0f);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        glm::vec3 p = points[i] - mean;
+        covariance += glm::outerProduct(p, p);
+    }
+    glm::mat3 principal;
+    symmetricEigenvectors(covariance, principal);
+    principal[2] = glm::cross(principal[0], principal[1]);
+
+    vector<CollisionProxy> candidates;
+    fitProxiesInFrame(points, glm::mat3(1.0f), candidates);
+    fitProxiesInFrame(points, principal, candidates);
+    for (int axis = 0; axis < 3; axis++)
+        fitProxiesInFrame(points, tightestFrameAbout(points, principal, axis), candidates);
+
+    vector<glm::vec3> samples;
+    float bestVolume = FLT_MAX;
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        const CollisionProxy& proxy = candidates[c];
+        float volume = proxy.Volume();
+        if (volume >= bestVolume)
+            continue;
+        proxy.SampleSurface(samples);
+        size_t i = 0;
+        while (i < samples.size() && nearMesh(samples[i], maxError))
+            i++;
+        if (i == samples.size())
+        {
+            best = proxy;
+            bestVolume = volume;
+        }
+    }
+    if (best.Shape == PROXY_NONE)
+        return best;
+
+    // bisect the smallest distance every sample is within
+    best.SampleSurface(samples);
+    float lo = 0.0f, hi = maxError;
+    for (int step = 0; step < 8; step++)
+    {
+        float mid = (lo + hi) * 0.5f;
+        size_t i = 0;
+        while (i < samples.size() && nearMesh(samples[i], mid))
+            i++;
+        if (i == samples.size())
+            hi = mid;
+        else
+            lo = mid;
+    }
+    best.Error = hi;
+    return best;
+}
+#endif
@@ -0,0 +1,96 @@
+#ifndef COVERAGE_MASK_H
+#define COVERAGE_MASK_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+// Alpha coverage of a base color texture as one bit per texel, for every mip level, built once at load time from
+// the decoded image. Ray queries drop hits on transparent texels by looking up the hit's texture coordinates here,
+// a constant time bit test with no texture sampling. Row 0 is at v = 0 (the top row of the image, the models are
+// loaded with flipped UVs), and lookups repeat like the GL texture does.
+class CoverageMask {
+public:
+    struct Level {
+        int Width;
+        int Height;
+        vector<uint64_t> Bits;  // row major, texel (x, y) is bit y * Width + x
+    };
+
+    vector<Level> Levels;
+    float Cutoff;  // alpha the masks were built with, for passes that alpha test the texture itself
+
+    CoverageMask() : Cutoff(0.0f) {}
+
+    // builds the masks from an 8 bit image whose last channel is alpha (2 or 4 channels): a texel covers when its
+    // alpha reaches cutoff (0..1). The mip levels average alpha over 2x2 texels like glGenerateMipmap before the
+    // cutoff. Returns false, leaving the mask empty, if the image has no alpha or no transparent texel.
+    bool Build(const unsigned char* data, int width, int height, int nrComponents, float cutoff)
+    {
+        Levels.clear();
+        Cutoff = cutoff;
+        if (nrComponents != 2 && nrComponents != 4)
+            return false;
+        vector<float> alpha((size_t)width * height);
+        bool transparent = false;
+        for (size_t i = 0; i < alpha.size(); i++)
+        {
+            alpha[i] = data[i * nrComponents + nrComponents - 1] / 255.0f;
+            transparent |= alpha[i] < cutoff;
+        }
+        if (!transparent)
+            return false;
+
+        while (true)
+        {
+            Level level;
+            level.Width = width;
+            level.Height = height;
+            level.Bits.assign(((size_t)width * height + 63) / 64, 0);
+            for (size_t i = 0; i < alpha.size(); i++)
+                if (alpha[i] >= cutoff)
+                    level.Bits[i >> 6] |= (uint64_t)1 << (i & 63);
+            Levels.push_back(level);
+            if (width == 1 && height == 1)
+                break;
+
+            // next mip: average of the (up to) 2x2 texels below each texel
+            int nextWidth = glm::max(width / 2, 1), nextHeight = glm::max(height / 2, 1);
+            vector<float> next((size_t)nextWidth * nextHeight);
+            for (int y = 0; y < nextHeight; y++)
+                for (int x = 0; x < nextWidth; x++)
+                {
+                    int x0 = glm::min(2 * x, width - 1), x1 = glm::min(2 * x + 1, width - 1);
+                    int y0 = glm::min(2 * y, height - 1), y1 = glm::min(2 * y + 1, height - 1);
+                    next[(size_t)y * nextWidth + x] = 0.25f * (alpha[(size_t)y0 * width + x0] + alpha[(size_t)y0 * width + x1] +
+                                                               alpha[(size_t)y1 * width + x0] + alpha[(size_t)y1 * width + x1]);
+                }
+            alpha.swap(next);
+            width = nextWidth;
+            height = nextHeight;
+        }
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return Levels.empty();
+    }
+
+    // true if the texel under the given texture coordinates is opaque at that mip level (nearest texel). An empty
+    // mask covers everything.
+    bool Covered(const glm::vec2& uv, int level = 0) const
+    {
+        if (Levels.empty())
+            return true;
+        const Level& mask = Levels[glm::min(level, (int)Levels.size() - 1)];
+        glm::vec2 f = glm::fract(uv);
+        int x = glm::min((int)(f.x * mask.Width), mask.Width - 1);
+        int y = glm::min((int)(f.y * mask.Height), mask.Height - 1);
+        size_t i = (size_t)y * mask.Width + x;
+        return (mask.Bits[i >> 6] >> (i & 63)) & 1;
+    }
+};
+#endif
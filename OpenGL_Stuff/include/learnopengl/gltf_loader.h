@@ -0,0 +1,595 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mapped_file.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+using namespace std;
+
+// Native reader for the glTF 2.0 files the game ships: a .gltf JSON document with the geometry in external .bin
+// buffers. It produces the meshes ASSIMP does with Triangulate | GenSmoothNormals | FlipUVs | CalcTangentSpace
+// (one mesh per triangle primitive, in node order, in mesh space, with v = 0 at the top of the image as glTF
+// already has it) without ASSIMP's scene conversion: the buffers are memory mapped and every attribute is copied
+// with one strided pass into the Vertex records the ray queries need. The mapped buffers are handed back too, so
+// the model can upload each one as a single GL buffer that the meshes' VAOs read in place (see VertexSource).
+//
+// Anything outside that subset (other primitive modes, sparse or normalized accessors, embedded buffers or images,
+// required extensions other than material ones) makes LoadGltf return false, and the model is imported with ASSIMP
+// instead.
+
+// a parsed JSON value; object members keep their file order
+struct JsonValue {
+    enum Kind { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+    Kind Type;
+    double Number;              // 1 or 0 for booleans
+    string String;
+    vector<JsonValue> Items;    // array elements, or the values of an object's members
+    vector<string> Names;       // names of an object's members, parallel to Items
+
+    JsonValue() : Type(JSON_NULL), Number(0.0) {}
+
+    // the member with this name, or a null value
+    const JsonValue& Get(const char* name) const
+    {
+        if (Type == JSON_OBJECT)
+            for (size_t i = 0; i < Names.size(); i++)
+                if (Names[i] == name)
+                    return Items[i];
+        return null();
+    }
+
+    // the array element at i, or a null value
+    const JsonValue& At(int i) const
+    {
+        return Type == JSON_ARRAY && i >= 0 && i < (int)Items.size() ? Items[i] : null();
+    }
+
+    bool IsNull() const { return Type == JSON_NULL; }
+    int Size() const { return Type == JSON_ARRAY ? (int)Items.size() : 0; }
+
+    // the number as an index, count or offset; fallback if it is missing or not a non-negative integer
+    int Int(int fallback = -1) const
+    {
+        if (Type != JSON_NUMBER || Number < 0.0 || Number > (double)INT_MAX || Number != floor(Number))
+            return fallback;
+        return (int)Number;
+    }
+
+    double Double(double fallback) const
+    {
+        return Type == JSON_NUMBER ? Number : fallback;
+    }
+
+private:
+    static const JsonValue& null()
+    {
+        static const JsonValue value;
+        return value;
+    }
+};
+
+// recursive descent JSON parser over a range of characters (a mapped file, which has no terminating NUL)
+class JsonParser {
+public:
+    JsonParser(const char* begin, const char* last) : p(begin), end(last)
+    {
+        if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+            p += 3;
+    }
+
+    // parses the value that makes up the whole range; false on a syntax error
+    bool Parse(JsonValue& value)
+    {
+        if (!parseValue(value, 0))
+            return false;
+        skipSpace();
+        return p == end;
+    }
+
+private:
+    static const int MAX_DEPTH = 64;
+
+    const char* p;
+    const char* end;
+
+    void skipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    bool literal(const char* word)
+    {
+        size_t length = strlen(word);
+        if ((size_t)(end - p) < length || memcmp(p, word, length) != 0)
+            return false;
+        p += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, int depth)
+    {
+        skipSpace();
+        if (p == end || depth > MAX_DEPTH)
+            return false;
+        if (*p == '{')
+        {
+            value.Type = JsonValue::JSON_OBJECT;
+            p++;
+            skipSpace();
+            if (p < end && *p == '}')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                skipSpace();
+                value.Names.push_back(string());
+                if (p == end || *p != '"' || !parseString(value.Names.back()))
+                    return false;
+                skipSpace();
+                if (p == end || *p++ != ':')
+                    return false;
+                value.Items.push_back(JsonValue());
+                if (!parseValue(value.Items.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (p == end)
+                    return false;
+                char next = *p++;
+                if (next == '}')
+                    return true;
+                if (next != ',')
+                    return false;
+            }
+        }
+        if (*p == '[')
+        {
+            value.Type = JsonValue::JSON_ARRAY;
+            p++;
+            skipSpace();
+            if (p < end && *p == ']')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                value.Items.push_back(JsonValue());
+                if (!parseValue(value.Items.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (p == end)
+                    return false;
+                char next = *p++;
+                if (next == ']')
+                    return true;
+                if (next != ',')
+                    return false;
+            }
+        }
+        if (*p == '"')
+        {
+            value.Type = JsonValue::JSON_STRING;
+            return parseString(value.String);
+        }
+        if (literal("true"))
+        {
+            value.Type = JsonValue::JSON_BOOL;
+            value.Number = 1.0;
+            return true;
+        }
+        if (literal("false"))
+        {
+            value.Type = JsonValue::JSON_BOOL;
+            return true;
+        }
+        if (literal("null"))
+            return true;
+        return parseNumber(value);
+    }
+
+    // p is at the opening quote; escapes are decoded, \u to UTF-8 (surrogate pairs are not joined, names and URIs
+    // in the files don't need them)
+    bool parseString(string& out)
+    {
+        p++;
+        while (p < end && *p != '"')
+        {
+            char c = *p++;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (p == end)
+                return false;
+            char escape = *p++;
+            switch (escape)
+            {
+            case '"': case '\\': case '/': out += escape; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                if (end - p < 4)
+                    return false;
+                unsigned int code = 0;
+                for (int i = 0; i < 4; i++, p++)
+                {
+                    char h = *p;
+                    int digit = h >= '0' && h <= '9' ? h - '0' : h >= 'a' && h <= 'f' ? h - 'a' + 10 : h >= 'A' && h <= 'F' ? h - 'A' + 10 : -1;
+                    if (digit < 0)
+                        return false;
+                    code = code * 16 + digit;
+                }
+                if (code < 0x80)
+                    out += (char)code;
+                else if (code < 0x800)
+                {
+                    out += (char)(0xC0 | (code >> 6));
+                    out += (char)(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    out += (char)(0xE0 | (code >> 12));
+                    out += (char)(0x80 | ((code >> 6) & 0x3F));
+                    out += (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        if (p == end)
+            return false;
+        p++;
+        return true;
+    }
+
+    bool parseNumber(JsonValue& value)
+    {
+        char text[64];
+        size_t length = 0;
+        while (p < end && length < sizeof(text) - 1 && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E'))
+            text[length++] = *p++;
+        text[length] = '\0';
+        char* stop;
+        value.Number = strtod(text, &stop);
+        value.Type = JsonValue::JSON_NUMBER;
+        return length > 0 && stop == text + length;
+    }
+};
+
+// an accessor resolved to its bytes in a mapped buffer
+struct GltfAccessor {
+    const unsigned char* Data;  // first element
+    int Buffer;
+    size_t Offset;              // of the first element in the buffer
+    size_t Stride;
+    size_t Count;
+    GLenum ComponentType;       // glTF uses the GL enums: GL_FLOAT, GL_UNSIGNED_INT, ...
+    int Components;
+    size_t ComponentSize;
+};
+
+// looks up accessor index and checks that all its elements lie inside its buffer view and buffer
+inline bool resolveGltfAccessor(const JsonValue& doc, const vector<shared_ptr<MappedFile> >& buffers, int index, GltfAccessor& out)
+{
+    const JsonValue& accessor = doc.Get("accessors").At(index);
+    if (accessor.IsNull() || !accessor.Get("sparse").IsNull() || accessor.Get("normalized").Number != 0.0)
+        return false;
+    const JsonValue& view = doc.Get("bufferViews").At(accessor.Get("bufferView").Int());
+    out.Buffer = view.Get("buffer").Int();
+    if (view.IsNull() || out.Buffer < 0 || out.Buffer >= (int)buffers.size())
+        return false;
+
+    const string& type = accessor.Get("type").String;
+    out.Components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+    out.ComponentType = (GLenum)accessor.Get("componentType").Int(0);
+    out.ComponentSize = out.ComponentType == GL_FLOAT || out.ComponentType == GL_UNSIGNED_INT ? 4 :
+                        out.ComponentType == GL_UNSIGNED_SHORT ? 2 : out.ComponentType == GL_UNSIGNED_BYTE ? 1 : 0;
+    int count = accessor.Get("count").Int();
+    int viewOffset = view.Get("byteOffset").Int(0), viewLength = view.Get("byteLength").Int();
+    int accessorOffset = accessor.Get("byteOffset").Int(0);
+    if (out.Components == 0 || out.ComponentSize == 0 || count < 0 || viewOffset < 0 || viewLength < 0 || accessorOffset < 0)
+        return false;
+
+    uint64_t elementSize = out.ComponentSize * out.Components;
+    out.Stride = (size_t)view.Get("byteStride").Int(0);
+    if (out.Stride == 0)
+        out.Stride = (size_t)elementSize;
+    out.Count = (size_t)count;
+    if ((uint64_t)viewOffset + viewLength > buffers[out.Buffer]->Size() ||
+        (count > 0 && (uint64_t)accessorOffset + (uint64_t)(count - 1) * out.Stride + elementSize > (uint64_t)viewLength))
+        return false;
+    out.Offset = (size_t)viewOffset + accessorOffset;
+    out.Data = buffers[out.Buffer]->Data() + out.Offset;
+    return true;
+}
+
+// resolves attribute name of a primitive if it has it; present tells whether it does
+inline bool resolveGltfAttribute(const JsonValue& doc, const vector<shared_ptr<MappedFile> >& buffers, const JsonValue& primitive, const char* name,
+                                 int components, size_t count, GltfAccessor& out, bool& present)
+{
+    const JsonValue& attribute = primitive.Get("attributes").Get(name);
+    present = !attribute.IsNull();
+    if (!present)
+        return true;
+    return resolveGltfAccessor(doc, buffers, attribute.Int(), out) && out.ComponentType == GL_FLOAT && out.Components == components &&
+           (count == 0 || out.Count == count);
+}
+
+// the alpha cutoff of the diffuse map's coverage mask, as Model::coverageCutoff reads it from ASSIMP's material
+inline float gltfCoverageCutoff(const JsonValue& material)
+{
+    const string& mode = material.Get("alphaMode").String;
+    if (mode == "MASK")
+        return (float)material.Get("alphaCutoff").Double(0.5);
+    if (mode == "BLEND")
+        return 0.5f;
+    return -1.0f;
+}
+
+// adds the image a material's texture info points to; only external image files are supported
+inline bool addGltfTexture(const JsonValue& doc, const JsonValue& textureInfo, const char* type, float cutoff, vector<MaterialTexture>& textures)
+{
+    if (textureInfo.IsNull())
+        return true;
+    const JsonValue& texture = doc.Get("textures").At(textureInfo.Get("index").Int());
+    const string& uri = doc.Get("images").At(texture.Get("source").Int()).Get("uri").String;
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+        return false;
+    MaterialTexture record;
+    record.Type = type;
+    record.Path = uri;
+    record.Cutoff = cutoff;
+    textures.push_back(record);
+    return true;
+}
+
+// one triangle primitive to a mesh; the vertex records, then the smooth normals and tangents ASSIMP would add
+inline bool readGltfPrimitive(const JsonValue& doc, const vector<shared_ptr<MappedFile> >& buffers, const JsonValue& primitive, ImportedMesh& mesh)
+{
+    if (primitive.Get("mode").Int(GL_TRIANGLES) != GL_TRIANGLES)
+        return false;
+    GltfAccessor position, normal, texCoord, tangent, index;
+    bool hasPosition, hasNormals, hasTexCoords, hasTangents;
+    if (!resolveGltfAttribute(doc, buffers, primitive, "POSITION", 3, 0, position, hasPosition) || !hasPosition)
+        return false;
+    size_t count = position.Count;
+    if (!resolveGltfAttribute(doc, buffers, primitive, "NORMAL", 3, count, normal, hasNormals) ||
+        !resolveGltfAttribute(doc, buffers, primitive, "TEXCOORD_0", 2, count, texCoord, hasTexCoords) ||
+        !resolveGltfAttribute(doc, buffers, primitive, "TANGENT", 4, count, tangent, hasTangents))
+        return false;
+    bool hasIndices = !primitive.Get("indices").IsNull();
+    if (hasIndices && (!resolveGltfAccessor(doc, buffers, primitive.Get("indices").Int(), index) || index.Components != 1 || index.ComponentType == GL_FLOAT))
+        return false;
+
+    // one strided pass per attribute, from the mapped buffer straight into the interleaved records
+    mesh.Vertices.resize(count);
+    Vertex* vertices = mesh.Vertices.empty() ? NULL : &mesh.Vertices[0];
+    for (size_t i = 0; i < count; i++)
+    {
+        memcpy(&vertices[i].Position, position.Data + i * position.Stride, sizeof(glm::vec3));
+        vertices[i].Normal = glm::vec3(0.0f);
+        vertices[i].TexCoords = glm::vec2(0.0f);
+        vertices[i].Tangent = glm::vec3(0.0f);
+        vertices[i].Bitangent = glm::vec3(0.0f);
+    }
+    if (hasNormals)
+        for (size_t i = 0; i < count; i++)
+            memcpy(&vertices[i].Normal, normal.Data + i * normal.Stride, sizeof(glm::vec3));
+    if (hasTexCoords)
+        for (size_t i = 0; i < count; i++)
+            memcpy(&vertices[i].TexCoords, texCoord.Data + i * texCoord.Stride, sizeof(glm::vec2));
+
+    if (hasIndices)
+    {
+        mesh.Indices.resize(index.Count);
+        for (size_t i = 0; i < index.Count; i++)
+        {
+            const unsigned char* element = index.Data + i * index.Stride;
+            if (index.ComponentType == GL_UNSIGNED_INT)
+                memcpy(&mesh.Indices[i], element, 4);
+            else if (index.ComponentType == GL_UNSIGNED_SHORT)
+            {
+                unsigned short value;
+                memcpy(&value, element, 2);
+                mesh.Indices[i] = value;
+            }
+            else
+                mesh.Indices[i] = *element;
+            if (mesh.Indices[i] >= count)
+                return false;
+        }
+    }
+    else
+    {
+        mesh.Indices.resize(count);
+        for (size_t i = 0; i < count; i++)
+            mesh.Indices[i] = (unsigned int)i;
+    }
+    if (mesh.Indices.size() % 3 != 0)
+        return false;
+
+    const unsigned int* indices = mesh.Indices.empty() ? NULL : &mesh.Indices[0];
+    if (!hasNormals)
+    {
+        // GenSmoothNormals: the average of the face normals around each vertex
+        for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+        {
+            Vertex& a = vertices[indices[i]];
+            Vertex& b = vertices[indices[i + 1]];
+            Vertex& c = vertices[indices[i + 2]];
+            glm::vec3 face = glm::cross(b.Position - a.Position, c.Position - a.Position);
+            float length = glm::length(face);
+            if (length > 0.0f)
+            {
+                face /= length;
+                a.Normal += face;
+                b.Normal += face;
+                c.Normal += face;
+            }
+        }
+        for (size_t i = 0; i < count; i++)
+            if (glm::length(vertices[i].Normal) > 0.0f)
+                vertices[i].Normal = glm::normalize(vertices[i].Normal);
+    }
+    if (hasTangents)
+    {
+        // as ASSIMP reads them: the bitangent from the normal and the tangent's handedness in w
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec4 t;
+            memcpy(&t, tangent.Data + i * tangent.Stride, sizeof(glm::vec4));
+            vertices[i].Tangent = glm::vec3(t);
+            vertices[i].Bitangent = glm::cross(vertices[i].Normal, glm::vec3(t)) * t.w;
+        }
+    }
+    else if (hasTexCoords)
+    {
+        // CalcTangentSpace: per face from the texture coordinates, summed at the vertices
+        for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+        {
+            Vertex& a = vertices[indices[i]];
+            Vertex& b = vertices[indices[i + 1]];
+            Vertex& c = vertices[indices[i + 2]];
+            glm::vec3 e1 = b.Position - a.Position, e2 = c.Position - a.Position;
+            glm::vec2 d1 = b.TexCoords - a.TexCoords, d2 = c.TexCoords - a.TexCoords;
+            float det = d1.x * d2.y - d2.x * d1.y;
+            if (fabs(det) < 1e-12f)
+                continue;
+            glm::vec3 t = (e1 * d2.y - e2 * d1.y) / det;
+            glm::vec3 bt = (e2 * d1.x - e1 * d2.x) / det;
+            a.Tangent += t; b.Tangent += t; c.Tangent += t;
+            a.Bitangent += bt; b.Bitangent += bt; c.Bitangent += bt;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            if (glm::length(vertices[i].Tangent) > 0.0f)
+                vertices[i].Tangent = glm::normalize(vertices[i].Tangent);
+            if (glm::length(vertices[i].Bitangent) > 0.0f)
+                vertices[i].Bitangent = glm::normalize(vertices[i].Bitangent);
+        }
+    }
+
+    // the textures Model::processMesh collects: the diffuse map (base color, or the diffuse texture of the
+    // specular-glossiness extension) with its coverage cutoff, and the specular-glossiness map
+    const JsonValue& material = doc.Get("materials").At(primitive.Get("material").Int());
+    const JsonValue& specularGlossiness = material.Get("extensions").Get("KHR_materials_pbrSpecularGlossiness");
+    const JsonValue& diffuse = specularGlossiness.Get("diffuseTexture").IsNull() ? material.Get("pbrMetallicRoughness").Get("baseColorTexture")
+                                                                               : specularGlossiness.Get("diffuseTexture");
+    if (!addGltfTexture(doc, diffuse, "texture_diffuse", gltfCoverageCutoff(material), mesh.Textures) ||
+        !addGltfTexture(doc, specularGlossiness.Get("specularGlossinessTexture"), "texture_specular", -1.0f, mesh.Textures))
+        return false;
+
+    // the VAO can read the file's bytes as they are when they are all in one buffer, aligned the way GL needs
+    if (hasNormals && hasTexCoords && hasIndices && normal.Buffer == position.Buffer && texCoord.Buffer == position.Buffer &&
+        index.Buffer == position.Buffer && position.Offset % 4 == 0 && normal.Offset % 4 == 0 && texCoord.Offset % 4 == 0 &&
+        position.Stride % 4 == 0 && normal.Stride % 4 == 0 && texCoord.Stride % 4 == 0 && index.Stride == index.ComponentSize &&
+        index.Offset % index.ComponentSize == 0)
+    {
+        mesh.Source.Buffer = position.Buffer;
+        mesh.Source.PositionOffset = position.Offset;
+        mesh.Source.PositionStride = (GLsizei)position.Stride;
+        mesh.Source.NormalOffset = normal.Offset;
+        mesh.Source.NormalStride = (GLsizei)normal.Stride;
+        mesh.Source.TexCoordOffset = texCoord.Offset;
+        mesh.Source.TexCoordStride = (GLsizei)texCoord.Stride;
+        mesh.Source.IndexOffset = index.Offset;
+        mesh.Source.IndexType = index.ComponentType;
+    }
+    return true;
+}
+
+// the primitives of node and of its children, depth first, the order Model::processNode visits ASSIMP's nodes in
+inline bool addGltfNode(const JsonValue& doc, const vector<shared_ptr<MappedFile> >& buffers, int node, int depth, vector<ImportedMesh>& meshes)
+{
+    const JsonValue& nodes = doc.Get("nodes");
+    const JsonValue& current = nodes.At(node);
+    if (current.IsNull() || depth > nodes.Size())  // deeper than the node count means a cycle
+        return false;
+    if (!current.Get("mesh").IsNull())
+    {
+        const JsonValue& primitives = doc.Get("meshes").At(current.Get("mesh").Int()).Get("primitives");
+        if (primitives.Size() == 0)
+            return false;
+        for (int i = 0; i < primitives.Size(); i++)
+        {
+            meshes.push_back(ImportedMesh());
+            if (!readGltfPrimitive(doc, buffers, primitives.At(i), meshes.back()))
+                return false;
+        }
+    }
+    const JsonValue& children = current.Get("children");
+    for (int i = 0; i < children.Size(); i++)
+        if (!addGltfNode(doc, buffers, children.At(i).Int(), depth + 1, meshes))
+            return false;
+    return true;
+}
+
+// Reads the meshes of the .gltf file at path and maps its buffers, which the meshes' VertexSource refers to by
+// index. Returns false, with both left empty, for a file this loader does not handle; makes no GL calls.
+inline bool LoadGltf(const string& path, vector<ImportedMesh>& meshes, vector<shared_ptr<MappedFile> >& buffers)
+{
+    meshes.clear();
+    buffers.clear();
+    MappedFile file;
+    if (path.size() < 5 || path.compare(path.size() - 5, 5, ".gltf") != 0 || !file.Open(path))
+        return false;
+    JsonValue doc;
+    JsonParser parser((const char*)file.Data(), (const char*)file.Data() + file.Size());
+    if (!parser.Parse(doc) || doc.Get("asset").Get("version").String.compare(0, 2, "2.") != 0)
+        return false;
+    // material extensions leave the geometry alone, and only textures are read from materials
+    const JsonValue& required = doc.Get("extensionsRequired");
+    for (int i = 0; i < required.Size(); i++)
+        if (required.At(i).String.compare(0, 14, "KHR_materials_") != 0)
+            return false;
+
+    string directory = path.substr(0, path.find_last_of('/'));
+    const JsonValue& bufferList = doc.Get("buffers");
+    for (int i = 0; i < bufferList.Size(); i++)
+    {
+        const string& uri = bufferList.At(i).Get("uri").String;
+        shared_ptr<MappedFile> buffer = make_shared<MappedFile>();
+        if (uri.empty() || uri.compare(0, 5, "data:") == 0 || !buffer->Open(directory + '/' + uri) ||
+            (double)buffer->Size() < bufferList.At(i).Get("byteLength").Double(0.0))
+        {
+            buffers.clear();
+            return false;
+        }
+        buffers.push_back(buffer);
+    }
+
+    const JsonValue& roots = doc.Get("scenes").At(doc.Get("scene").Int(0)).Get("nodes");
+    bool read = roots.Size() > 0;
+    for (int i = 0; read && i < roots.Size(); i++)
+        read = addGltfNode(doc, buffers, roots.At(i).Int(), 0, meshes);
+    if (!read || meshes.empty())
+    {
+        meshes.clear();
+        buffers.clear();
+        return false;
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,281 @@
+#ifndef ID_PICKER_H
+#define ID_PICKER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/model.h>
+
+#include <memory>
+#include <cstdint>
+using namespace std;
+
+// what the id pass left under one pixel: Object is the id the model was drawn with (0 where nothing was drawn),
+// Mesh the index of the mesh in its model and Triangle the triangle in that mesh's index buffer. TexCoords are
+// wrapped to [0, 1) and kept to 16 bits per coordinate.
+struct PickSample {
+    unsigned int Object;
+    unsigned int Mesh;
+    unsigned int Triangle;
+    glm::vec2 TexCoords;
+};
+
+struct PickResult {
+    static const int MAX_SAMPLES = 64;
+    int Count;
+    PickSample Samples[MAX_SAMPLES];
+};
+
+// GPU picking for dense scenes: the scene is drawn again with an id shader into a small integer framebuffer that
+// only covers the pixels to pick (one for a single ray, the box around the pellets for a spread shot), so the pass
+// costs about the vertex work of the draw list. The picked pixels are copied into a pixel pack buffer behind a
+// fence and mapped once the fence has signalled, usually one or two frames later: the CPU never waits for the GPU.
+// Results come back in the order the picks were made.
+class IdPicker {
+public:
+    static const int MAX_REGION = 256;  // side of the largest region rendered, in pixels
+    static const int RING = 3;          // picks in flight; Pick fails while all of them wait for the GPU
+
+    IdPicker() : fbo(0), ids(0), depth(0), head(0), pending(0), regionViewProjection(1.0f)
+    {
+        for (int i = 0; i < RING; i++)
+        {
+            slots[i].Buffer = 0;
+            slots[i].Fence = 0;
+            slots[i].Count = 0;
+            slots[i].Inside = 0;
+        }
+    }
+
+    // needs a current GL context; returns false if the framebuffer is not complete
+    bool Init(const char* vertexPath, const char* fragmentPath)
+    {
+        shader.reset(new Shader(vertexPath, fragmentPath));
+
+        glGenTextures(1, &ids);
+        glBindTexture(GL_TEXTURE_2D, ids);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, MAX_REGION, MAX_REGION, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, MAX_REGION, MAX_REGION);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ids, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        for (int i = 0; i < RING; i++)
+        {
+            glGenBuffers(1, &slots[i].Buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].Buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, PickResult::MAX_SAMPLES * 4 * sizeof(GLuint), NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (!complete)
+            Release();
+        return complete;
+    }
+
+    bool Ready() const
+    {
+        return fbo != 0;
+    }
+
+    // Picks the given window pixels (origin at the bottom left, like gl_FragCoord) of a viewport of the given size
+    // seen through view and projection. draw(shader) issues the draw list with DrawModel; the picker has already
+    // bound its shader and set "view" and "projection". Pixels farther apart than
+    // MAX_REGION keep the region around the first one and come back as misses. Returns false, drawing nothing,
+    // while RING picks are still waiting for the GPU.
+    template<typename DrawScene>
+    bool Pick(const glm::mat4& view, const glm::mat4& projection, const glm::ivec2& viewport, const glm::vec2* pixels, int count,
+              DrawScene draw)
+    {
+        if (fbo == 0 || pending == RING || count <= 0)
+            return false;
+        count = glm::min(count, (int)PickResult::MAX_SAMPLES);
+
+        // the region is the box of the pixels, shrunk around the first one when it does not fit
+        glm::ivec2 first = glm::ivec2(glm::floor(pixels[0]));
+        glm::ivec2 low = first, high = first;
+        for (int i = 1; i < count; i++)
+        {
+            glm::ivec2 pixel = glm::ivec2(glm::floor(pixels[i]));
+            low = glm::min(low, pixel);
+            high = glm::max(high, pixel);
+        }
+        for (int axis = 0; axis < 2; axis++)
+        {
+            if (high[axis] - low[axis] < MAX_REGION)
+                continue;
+            low[axis] = glm::max(low[axis], first[axis] - MAX_REGION / 2);
+            high[axis] = glm::min(high[axis], low[axis] + MAX_REGION - 1);
+        }
+        glm::ivec2 size = high - low + glm::ivec2(1);
+
+        // projection of just the region: scales the viewport so the region fills the framebuffer (the pick matrix)
+        glm::vec2 scale = glm::vec2(viewport) / glm::vec2(size);
+        glm::vec2 offset = (glm::vec2(viewport) - 2.0f * glm::vec2(low)) / glm::vec2(size) - glm::vec2(1.0f);
+        glm::mat4 region = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(scale, 1.0f));
+
+        GLint previousViewport[4];
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, size.x, size.y);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, size.x, size.y);
+        const GLuint none[4] = { 0, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 0, none);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        regionViewProjection = region * projection * view;
+        shader->use();
+        shader->setMat4("view", view);
+        shader->setMat4("projection", region * projection);
+        draw(*shader);
+        glDisable(GL_SCISSOR_TEST);
+
+        // one texel per pixel into the slot's buffer; the copies are queued, nothing is read back yet
+        Slot& slot = slots[(head + pending) % RING];
+        slot.Count = count;
+        slot.Inside = 0;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+        for (int i = 0; i < count; i++)
+        {
+            glm::ivec2 pixel = glm::ivec2(glm::floor(pixels[i])) - low;
+            if (pixel.x < 0 || pixel.y < 0 || pixel.x >= size.x || pixel.y >= size.y)
+                continue;
+            glReadPixels(pixel.x, pixel.y, 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_INT, (void*)(i * 4 * sizeof(GLuint)));
+            slot.Inside |= (uint64_t)1 << i;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // a fence that never reaches the GPU never signals; the flush only submits, it does not wait
+        glFlush();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+        pending++;
+        return true;
+    }
+
+    // the oldest pick if the GPU has finished it, without waiting; false otherwise
+    bool Poll(PickResult& result)
+    {
+        if (pending == 0)
+            return false;
+        Slot& slot = slots[head];
+        GLenum status = glClientWaitSync(slot.Fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+        glDeleteSync(slot.Fence);
+        slot.Fence = 0;
+
+        result.Count = slot.Count;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.Buffer);
+        const GLuint* data = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.Count * 4 * sizeof(GLuint), GL_MAP_READ_BIT);
+        for (int i = 0; i < slot.Count; i++)
+        {
+            PickSample& sample = result.Samples[i];
+            if (!data || !((slot.Inside >> i) & 1))
+            {
+                sample.Object = 0;
+                sample.Mesh = 0;
+                sample.Triangle = 0;
+                sample.TexCoords = glm::vec2(0.0f);
+                continue;
+            }
+            const GLuint* texel = data + i * 4;
+            sample.Object = texel[0];
+            sample.Mesh = texel[1];
+            sample.Triangle = texel[2];
+            sample.TexCoords = glm::vec2(texel[3] & 0xffff, texel[3] >> 16) / 65536.0f;
+        }
+        if (data)
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        head = (head + 1) % RING;
+        pending--;
+        return true;
+    }
+
+    // draws a model with the given world matrix for the id pass, mesh by mesh so every fragment knows its mesh.
+    // Models whose bounds miss the region are skipped: the region is a few pixels wide, so that is most of the draw
+    // list. Alpha tested meshes discard the texels their coverage mask drops, so the pass agrees with the ray queries.
+    void DrawModel(Shader& shader, Model& model, const glm::mat4& world, unsigned int object) const
+    {
+        if (!overlapsRegion(regionViewProjection * world, model.Bounds))
+            return;
+        shader.setMat4("model", world);
+        shader.setInt("objectId", (int)object);
+        for (unsigned int i = 0; i < model.meshes.size(); i++)
+        {
+            shader.setInt("meshIndex", (int)i);
+            shader.setFloat("alphaCutoff", model.meshes[i].coverage ? model.meshes[i].coverage->Cutoff : 0.0f);
+            model.meshes[i].Draw(shader);
+        }
+    }
+
+private:
+    struct Slot {
+        GLuint Buffer;
+        GLsync Fence;
+        int Count;
+        uint64_t Inside;  // bit i is set if pixel i was inside the region and copied
+    };
+
+    unique_ptr<Shader> shader;
+    GLuint fbo;
+    GLuint ids;
+    GLuint depth;
+    Slot slots[RING];
+    int head;     // oldest pick in flight
+    int pending;  // picks in flight
+    glm::mat4 regionViewProjection;
+
+    // false if all eight corners of the box are outside the same clip plane
+    static bool overlapsRegion(const glm::mat4& clip, const AABB& box)
+    {
+        unsigned int outside = 0x3f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec4 corner = clip * glm::vec4(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z, 1.0f);
+            unsigned int planes = (corner.x < -corner.w ? 1 : 0) | (corner.x > corner.w ? 2 : 0) | (corner.y < -corner.w ? 4 : 0) |
+                                  (corner.y > corner.w ? 8 : 0) | (corner.z < -corner.w ? 16 : 0) | (corner.z > corner.w ? 32 : 0);
+            outside &= planes;
+        }
+        return outside == 0;
+    }
+
+    void Release()
+    {
+        for (int i = 0; i < RING; i++)
+        {
+            if (slots[i].Fence)
+                glDeleteSync(slots[i].Fence);
+            if (slots[i].Buffer)
+                glDeleteBuffers(1, &slots[i].Buffer);
+            slots[i].Fence = 0;
+            slots[i].Buffer = 0;
+        }
+        if (fbo)
+            glDeleteFramebuffers(1, &fbo);
+        if (ids)
+            glDeleteTextures(1, &ids);
+        if (depth)
+            glDeleteRenderbuffers(1, &depth);
+        fbo = ids = depth = 0;
+        head = pending = 0;
+    }
+};
+#endif
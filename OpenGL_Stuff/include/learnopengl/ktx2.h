@@ -0,0 +1,281 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/block_compress.h>
+#include <learnopengl/mapped_file.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+using namespace std;
+
+// S3TC is an extension rather than core GL, so glad leaves these out; every desktop driver exposes it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// KTX 2.0 files of block compressed 2D textures with their whole mip chain, as tools/texture_compress writes
+// them next to each source image (e.g. textures/wall.png.ktx2):
+//
+//   header | level index (level 0 first) | data format descriptor | key/value data | levels, smallest first
+//
+// No supercompression, one layer, one face. The key/value data holds "SourceHash", the hashFileContents of the
+// image the levels were encoded from, so a texture edited after the last encoding is decoded from the source
+// again instead of showing the stale copy. The formats are UNORM, like the uncompressed textures.
+const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Ktx2Header {
+    unsigned char Identifier[12];
+    uint32_t VkFormat;
+    uint32_t TypeSize;
+    uint32_t PixelWidth;
+    uint32_t PixelHeight;
+    uint32_t PixelDepth;
+    uint32_t LayerCount;
+    uint32_t FaceCount;
+    uint32_t LevelCount;
+    uint32_t SupercompressionScheme;
+    uint32_t DfdByteOffset;
+    uint32_t DfdByteLength;
+    uint32_t KvdByteOffset;
+    uint32_t KvdByteLength;
+    uint64_t SgdByteOffset;
+    uint64_t SgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+    uint64_t ByteOffset;
+    uint64_t ByteLength;
+    uint64_t UncompressedByteLength;
+};
+
+// a KTX2 file mapped for upload; the levels point into the mapping
+struct Ktx2Texture {
+    BlockFormat Format;
+    int Width;
+    int Height;
+    uint64_t SourceHash;                  // hashFileContents of the image it was encoded from, 0 if not recorded
+    vector<const unsigned char*> Levels;  // level 0 first, CompressedSize bytes each
+    shared_ptr<MappedFile> File;
+};
+
+// how each BlockFormat is described: Vulkan format, DFD color model, samples (bit offset, channel id) and GL format
+struct ktx2FormatInfo {
+    uint32_t VkFormat;
+    uint32_t ColorModel;
+    int Samples;
+    uint32_t SampleOffsets[2];
+    uint32_t SampleChannels[2];
+    GLenum GlFormat;
+};
+
+inline const ktx2FormatInfo& ktx2Format(BlockFormat format)
+{
+    // KHR_DF_MODEL_BC1A..BC7 are 128..134; channel 15 is BC3's alpha, 1 BC5's green
+    static const ktx2FormatInfo infos[] = {
+        { 131, 128, 1, { 0, 0 }, { 0, 0 }, GL_COMPRESSED_RGB_S3TC_DXT1_EXT },    // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+        { 137, 130, 2, { 0, 64 }, { 15, 0 }, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT }, // VK_FORMAT_BC3_UNORM_BLOCK
+        { 139, 131, 1, { 0, 0 }, { 0, 0 }, GL_COMPRESSED_RED_RGTC1 },            // VK_FORMAT_BC4_UNORM_BLOCK
+        { 141, 132, 2, { 0, 64 }, { 0, 1 }, GL_COMPRESSED_RG_RGTC2 },            // VK_FORMAT_BC5_UNORM_BLOCK
+        { 145, 134, 1, { 0, 0 }, { 0, 0 }, GL_COMPRESSED_RGBA_BPTC_UNORM },      // VK_FORMAT_BC7_UNORM_BLOCK
+    };
+    return infos[format];
+}
+
+// the Basic Data Format Descriptor of a block format, total size word included
+inline vector<uint32_t> ktx2Descriptor(BlockFormat format)
+{
+    const ktx2FormatInfo& info = ktx2Format(format);
+    uint32_t blockBits = (uint32_t)BlockBytes(format) * 8;
+    vector<uint32_t> dfd;
+    dfd.push_back(0);                                           // total size, below
+    dfd.push_back(0);                                           // vendor Khronos, descriptor type basic
+    dfd.push_back(2 | (uint32_t)(24 + 16 * info.Samples) << 16); // version 1.3, block size
+    dfd.push_back(info.ColorModel | 1u << 8 | 1u << 16);        // BT.709 primaries, linear transfer, straight alpha
+    dfd.push_back(3 | 3u << 8);                                 // 4x4x1x1 texel blocks
+    dfd.push_back((uint32_t)BlockBytes(format));                // bytes in plane 0
+    dfd.push_back(0);
+    for (int s = 0; s < info.Samples; s++)
+    {
+        uint32_t bits = info.Samples == 1 ? blockBits : blockBits / 2;
+        dfd.push_back(info.SampleOffsets[s] | (bits - 1) << 16 | info.SampleChannels[s] << 24);
+        dfd.push_back(0);                                       // sample position 0, 0
+        dfd.push_back(0);                                       // lower
+        dfd.push_back(0xFFFFFFFFu);                             // upper
+    }
+    dfd[0] = (uint32_t)(dfd.size() * 4);
+    return dfd;
+}
+
+inline size_t ktx2Align(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Writes the levels (level 0 first, each CompressedSize bytes of its size) to path; false if it can't
+inline bool WriteKtx2(const string& path, BlockFormat format, int width, int height, const vector<vector<unsigned char> >& levels, uint64_t sourceHash)
+{
+    vector<uint32_t> dfd = ktx2Descriptor(format);
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)sourceHash);
+    string pair = string("SourceHash") + '\0' + hash + '\0';
+    vector<unsigned char> kvd(4);
+    uint32_t pairLength = (uint32_t)pair.size();
+    memcpy(kvd.data(), &pairLength, 4);
+    kvd.insert(kvd.end(), pair.begin(), pair.end());
+    kvd.resize(ktx2Align(kvd.size(), 4), 0);
+
+    Ktx2Header header;
+    memcpy(header.Identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.VkFormat = ktx2Format(format).VkFormat;
+    header.TypeSize = 1;
+    header.PixelWidth = width;
+    header.PixelHeight = height;
+    header.PixelDepth = 0;
+    header.LayerCount = 0;
+    header.FaceCount = 1;
+    header.LevelCount = (uint32_t)levels.size();
+    header.SupercompressionScheme = 0;
+    header.DfdByteOffset = (uint32_t)(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2LevelIndex));
+    header.DfdByteLength = (uint32_t)(dfd.size() * 4);
+    header.KvdByteOffset = header.DfdByteOffset + header.DfdByteLength;
+    header.KvdByteLength = (uint32_t)kvd.size();
+    header.SgdByteOffset = 0;
+    header.SgdByteLength = 0;
+
+    // the smallest level goes first; every level starts on a block boundary
+    vector<Ktx2LevelIndex> index(levels.size());
+    size_t offset = header.KvdByteOffset + header.KvdByteLength;
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+        offset = ktx2Align(offset, BlockBytes(format));
+        index[i].ByteOffset = offset;
+        index[i].ByteLength = levels[i].size();
+        index[i].UncompressedByteLength = levels[i].size();
+        offset += levels[i].size();
+    }
+
+    ofstream out(path.c_str(), ios::binary | ios::trunc);
+    if (!out)
+    {
+        std::cout << "KTX2 file could not be written: " << path << std::endl;
+        return false;
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)index.data(), index.size() * sizeof(Ktx2LevelIndex));
+    out.write((const char*)dfd.data(), dfd.size() * 4);
+    out.write((const char*)kvd.data(), kvd.size());
+    size_t written = header.KvdByteOffset + header.KvdByteLength;
+    static const char zeros[16] = { 0 };
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+        out.write(zeros, (streamsize)(index[i].ByteOffset - written));
+        out.write((const char*)levels[i].data(), levels[i].size());
+        written = index[i].ByteOffset + levels[i].size();
+    }
+    if (!out)
+    {
+        std::cout << "KTX2 file could not be written: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Maps a KTX2 file written by WriteKtx2. Returns false, with no message, if there is no such file or it is not a
+// layout this reader handles (any supercompression, arrays, cube maps, 3D, other formats). The caller compares
+// SourceHash with the image the file stands for.
+inline bool ReadKtx2(const string& path, Ktx2Texture& texture)
+{
+    texture.Levels.clear();
+    texture.File.reset();
+    shared_ptr<MappedFile> file = make_shared<MappedFile>();
+    if (!file->Open(path))
+        return false;
+    const unsigned char* data = file->Data();
+    size_t size = file->Size();
+    if (size < sizeof(Ktx2Header))
+        return false;
+    Ktx2Header header;
+    memcpy(&header, data, sizeof(header));
+    int format = 0;
+    while (format <= BLOCK_BC7 && ktx2Format((BlockFormat)format).VkFormat != header.VkFormat)
+        format++;
+    if (memcmp(header.Identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 || format > BLOCK_BC7 || header.PixelWidth == 0 ||
+        header.PixelHeight == 0 || header.PixelDepth != 0 || header.LayerCount > 1 || header.FaceCount != 1 || header.LevelCount == 0 ||
+        header.LevelCount > (uint32_t)MipLevelCount(header.PixelWidth, header.PixelHeight) || header.SupercompressionScheme != 0 ||
+        sizeof(Ktx2Header) + (uint64_t)header.LevelCount * sizeof(Ktx2LevelIndex) > size ||
+        (uint64_t)header.DfdByteOffset + header.DfdByteLength > size || (uint64_t)header.KvdByteOffset + header.KvdByteLength > size)
+        return false;
+
+    // the descriptor must say what the format does: same color model and block size
+    vector<uint32_t> expected = ktx2Descriptor((BlockFormat)format);
+    if (header.DfdByteLength < 7 * 4 || memcmp(data + header.DfdByteOffset + 12, &expected[3], 4 * 4) != 0)
+        return false;
+
+    // "SourceHash" among the key/value pairs
+    texture.SourceHash = 0;
+    for (size_t at = header.KvdByteOffset; at + 4 <= (size_t)header.KvdByteOffset + header.KvdByteLength;)
+    {
+        uint32_t length;
+        memcpy(&length, data + at, 4);
+        if (at + 4 + length > (size_t)header.KvdByteOffset + header.KvdByteLength)
+            break;
+        string pair((const char*)data + at + 4, length);
+        if (pair.size() == 28 && pair.compare(0, 11, string("SourceHash") + '\0') == 0)
+            texture.SourceHash = strtoull(pair.c_str() + 11, NULL, 16);
+        at = ktx2Align(at + 4 + length, 4);
+    }
+
+    Ktx2LevelIndex index;
+    for (uint32_t i = 0; i < header.LevelCount; i++)
+    {
+        memcpy(&index, data + sizeof(Ktx2Header) + i * sizeof(Ktx2LevelIndex), sizeof(index));
+        int width = glm::max((int)header.PixelWidth >> i, 1), height = glm::max((int)header.PixelHeight >> i, 1);
+        if (index.ByteLength != CompressedSize((BlockFormat)format, width, height) || index.ByteOffset + index.ByteLength > size)
+        {
+            texture.Levels.clear();
+            return false;
+        }
+        texture.Levels.push_back(data + index.ByteOffset);
+    }
+    texture.Format = (BlockFormat)format;
+    texture.Width = header.PixelWidth;
+    texture.Height = header.PixelHeight;
+    texture.File = file;
+    return true;
+}
+
+// Creates a texture from the compressed levels, sampled like the uncompressed ones (repeat, trilinear). Missing
+// small levels are left out of the sampling range rather than generated. Needs the GL context.
+inline unsigned int UploadKtx2(const Ktx2Texture& texture)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    GLenum format = ktx2Format(texture.Format).GlFormat;
+    for (size_t i = 0; i < texture.Levels.size(); i++)
+    {
+        int width = glm::max(texture.Width >> i, 1), height = glm::max(texture.Height >> i, 1);
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, format, width, height, 0, (GLsizei)CompressedSize(texture.Format, width, height),
+                               texture.Levels[i]);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.Levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return textureID;
+}
+#endif
@@ -7,9 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/bvh.h>
+#include <learnopengl/coverage_mask.h>
 
 #include <string>
 #include <vector>
+#include <memory>
 using namespace std;
 
 struct Vertex {
@@ -29,6 +32,22 @@ struct Texture {
     unsigned int id;
     string type;
     string path;
+    shared_ptr<CoverageMask> coverage;  // alpha coverage for ray queries, only for diffuse maps with transparency
+};
+
+// Where the vertex attributes and indices of a mesh already are in one of its model's GL buffers (a glTF buffer
+// uploaded as it is, see gltf_loader.h), for a VAO that reads them in place. Buffer is -1 for a mesh that uploads
+// its own interleaved vertices and indices. Only what the shaders read is described: positions, normals and the
+// first texture coordinates.
+struct VertexSource {
+    int Buffer;
+    size_t PositionOffset, NormalOffset, TexCoordOffset;
+    GLsizei PositionStride, NormalStride, TexCoordStride;
+    size_t IndexOffset;
+    GLenum IndexType;       // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+
+    VertexSource() : Buffer(-1), PositionOffset(0), NormalOffset(0), TexCoordOffset(0), PositionStride(0), NormalStride(0),
+                     TexCoordStride(0), IndexOffset(0), IndexType(GL_UNSIGNED_INT) {}
 };
 
 class Mesh {
@@ -37,17 +56,36 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    BVH                  bvh;
+    shared_ptr<const CoverageMask> coverage;  // of the diffuse map; null if ray hits are never alpha tested
     unsigned int VAO;
+    VertexSource source;    // set by the model before Upload when the data is in one of its buffers
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor; touches no GL state, so meshes can be built on a loader thread (see Upload)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) : VAO(0), VBO(0), EBO(0)
     {
-        this->vertices = vertices;
-        this->indices = indices;
+        // the arguments are this mesh's own copies already; take them over instead of copying again
+        this->vertices.swap(vertices);
+        this->indices.swap(indices);
         this->textures = textures;
+        for(unsigned int i = 0; i < textures.size(); i++)
+            if(textures[i].type == "texture_diffuse" && textures[i].coverage)
+                coverage = textures[i].coverage;
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        // the acceleration structure for ray queries is filled in by the model, from its BVH cache when possible
+    }
+
+    // creates the vertex buffers and their attribute pointers; must run on the thread that owns the GL context.
+    // buffers are the model's GL buffers that source.Buffer refers to.
+    void Upload(const vector<unsigned int>& buffers = vector<unsigned int>())
+    {
+        if(source.Buffer >= 0 && source.Buffer < (int)buffers.size())
+            setupSharedMesh(buffers[source.Buffer]);
+        else
+        {
+            source = VertexSource();
+            setupMesh();
+        }
     }
 
     // render the mesh
@@ -81,7 +119,7 @@ public:
         
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indices.size(), source.IndexType, (void*)source.IndexOffset);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
@@ -130,5 +168,22 @@ private:
 
         glBindVertexArray(0);
     }
+
+    // a VAO over the model's buffer: the attribute pointers and the element buffer use the offsets and strides of
+    // the file, so nothing is converted or uploaded per mesh
+    void setupSharedMesh(unsigned int buffer)
+    {
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, source.PositionStride, (void*)source.PositionOffset);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, source.NormalStride, (void*)source.NormalOffset);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, source.TexCoordStride, (void*)source.TexCoordOffset);
+        glBindVertexArray(0);
+    }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,226 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/bvh_cache.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+using namespace std;
+
+// On-disk cache of what the importer made of a model, stored next to the model file (e.g. scene.gltf.mesh), so a
+// warm start maps one file instead of running Assimp and converting the meshes vertex by vertex:
+//
+//   MeshCacheHeader | MeshCacheEntry per mesh | MeshCacheTexture records | per mesh: vertices, indices
+//
+// Every section starts on a 64 byte boundary. The file is keyed by a hash of the source file and the .bin buffers
+// it names (HashModelSource) and by the import flags, so an edited model or a different post-processing simply
+// imports again. Textures are only referenced by path; they are decoded as usual. Bump MESH_CACHE_VERSION whenever
+// Vertex or the records change.
+const uint32_t MESH_CACHE_VERSION = 1;
+
+struct MeshCacheHeader {
+    char Magic[8];          // "MESHCACH"
+    uint32_t Version;
+    uint32_t Endian;        // BVH_CACHE_ENDIAN as written by the machine that built the file
+    uint32_t VertexSize;    // sizeof(Vertex)
+    uint32_t ImportFlags;   // the aiProcess flags the meshes were imported with
+    uint64_t SourceHash;    // HashModelSource of the model
+    uint32_t MeshCount;
+    uint32_t TextureCount;
+};
+
+struct MeshCacheEntry {
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    uint32_t FirstTexture;  // index of the mesh's first MeshCacheTexture
+    uint32_t TextureCount;
+    uint64_t VertexOffset;
+    uint64_t IndexOffset;
+};
+
+struct MeshCacheTexture {
+    char Type[32];          // sampler prefix, e.g. "texture_diffuse"
+    char Path[220];         // as written in the material, relative to the model's directory
+    float Cutoff;           // alpha cutoff of the coverage mask, negative for none
+};
+
+// a texture a mesh's material refers to, not loaded yet
+struct MaterialTexture {
+    string Type;
+    string Path;
+    float Cutoff;
+};
+
+// one mesh as the importer produced it, before its textures are loaded
+struct ImportedMesh {
+    vector<Vertex> Vertices;
+    vector<unsigned int> Indices;
+    vector<MaterialTexture> Textures;
+    VertexSource Source;    // where the GL data already is, if the loader can tell (not cached)
+};
+
+// 64 bit FNV-1a over a block of bytes, continuing from hash
+inline uint64_t hashBytes(const unsigned char* p, size_t bytes, uint64_t hash)
+{
+    for (size_t b = 0; b < bytes; b++)
+        hash = (hash ^ p[b]) * 1099511628211ull;
+    return hash;
+}
+
+// hash of a model file and of the .bin buffers it refers to ("uri": "scene.bin" in glTF); images are left out,
+// the cache does not hold their pixels. 0 if the model can't be read.
+inline uint64_t HashModelSource(const string& path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+        return 0;
+    uint64_t hash = hashBytes(file.Data(), file.Size(), 14695981039346656037ull);
+    string text((const char*)file.Data(), file.Size());
+    string directory = path.substr(0, path.find_last_of('/'));
+    for (size_t at = text.find("\"uri\""); at != string::npos; at = text.find("\"uri\"", at + 5))
+    {
+        size_t open = text.find('"', text.find(':', at + 5));
+        size_t close = open == string::npos ? string::npos : text.find('"', open + 1);
+        if (close == string::npos)
+            break;
+        string uri = text.substr(open + 1, close - open - 1);
+        if (uri.size() <= 4 || uri.compare(uri.size() - 4, 4, ".bin") != 0)
+            continue;
+        MappedFile buffer;
+        if (buffer.Open(directory + '/' + uri))
+            hash = hashBytes(buffer.Data(), buffer.Size(), hash);
+        else
+            hash = hashBytes((const unsigned char*)uri.c_str(), uri.size(), hash);  // a missing buffer is part of the key too
+    }
+    return hash;
+}
+
+// Maps the cache and fills meshes from it if it was written for this source hash and these import flags.
+// Returns false, leaving meshes empty, if there is no usable cache.
+inline bool ReadMeshCache(const string& cachePath, uint64_t sourceHash, uint32_t importFlags, vector<ImportedMesh>& meshes)
+{
+    meshes.clear();
+    MappedFile file;
+    if (!file.Open(cachePath))
+        return false;
+    const unsigned char* data = file.Data();
+    size_t size = file.Size();
+    const MeshCacheHeader* header = (const MeshCacheHeader*)data;
+    if (size < sizeof(MeshCacheHeader) || memcmp(header->Magic, "MESHCACH", 8) != 0 || header->Version != MESH_CACHE_VERSION ||
+        header->Endian != BVH_CACHE_ENDIAN || header->VertexSize != sizeof(Vertex) || header->ImportFlags != importFlags ||
+        header->SourceHash != sourceHash)
+        return false;
+    uint64_t texturesOffset = sizeof(MeshCacheHeader) + (uint64_t)header->MeshCount * sizeof(MeshCacheEntry);
+    if (texturesOffset + (uint64_t)header->TextureCount * sizeof(MeshCacheTexture) > size)
+        return false;
+    const MeshCacheEntry* entries = (const MeshCacheEntry*)(data + sizeof(MeshCacheHeader));
+    const MeshCacheTexture* textures = (const MeshCacheTexture*)(data + texturesOffset);
+    for (uint32_t i = 0; i < header->MeshCount; i++)
+    {
+        const MeshCacheEntry& e = entries[i];
+        if (e.VertexOffset + (uint64_t)e.VertexCount * sizeof(Vertex) > size || e.IndexOffset + (uint64_t)e.IndexCount * sizeof(unsigned int) > size ||
+            (uint64_t)e.FirstTexture + e.TextureCount > header->TextureCount)
+        {
+            meshes.clear();
+            return false;
+        }
+    }
+
+    // one bulk copy per section: the meshes keep their vertices on the CPU for the ray queries
+    meshes.resize(header->MeshCount);
+    for (uint32_t i = 0; i < header->MeshCount; i++)
+    {
+        const MeshCacheEntry& e = entries[i];
+        const Vertex* vertices = (const Vertex*)(data + e.VertexOffset);
+        const unsigned int* indices = (const unsigned int*)(data + e.IndexOffset);
+        meshes[i].Vertices.assign(vertices, vertices + e.VertexCount);
+        meshes[i].Indices.assign(indices, indices + e.IndexCount);
+        for (uint32_t t = e.FirstTexture; t < e.FirstTexture + e.TextureCount; t++)
+        {
+            MaterialTexture texture;
+            texture.Type = string(textures[t].Type, strnlen(textures[t].Type, sizeof(textures[t].Type)));
+            texture.Path = string(textures[t].Path, strnlen(textures[t].Path, sizeof(textures[t].Path)));
+            texture.Cutoff = textures[t].Cutoff;
+            meshes[i].Textures.push_back(texture);
+        }
+    }
+    return true;
+}
+
+// writes the cache for the next run; returns false (and the next run imports again) if it can't
+inline bool WriteMeshCache(const string& cachePath, uint64_t sourceHash, uint32_t importFlags, const vector<ImportedMesh>& meshes)
+{
+    MeshCacheHeader header;
+    memcpy(header.Magic, "MESHCACH", 8);
+    header.Version = MESH_CACHE_VERSION;
+    header.Endian = BVH_CACHE_ENDIAN;
+    header.VertexSize = sizeof(Vertex);
+    header.ImportFlags = importFlags;
+    header.SourceHash = sourceHash;
+    header.MeshCount = (uint32_t)meshes.size();
+    header.TextureCount = 0;
+
+    vector<MeshCacheEntry> entries(meshes.size());
+    vector<MeshCacheTexture> textures;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        entries[i].FirstTexture = (uint32_t)textures.size();
+        entries[i].TextureCount = (uint32_t)meshes[i].Textures.size();
+        for (size_t t = 0; t < meshes[i].Textures.size(); t++)
+        {
+            const MaterialTexture& texture = meshes[i].Textures[t];
+            MeshCacheTexture record;
+            memset(&record, 0, sizeof(record));
+            // paths that don't fit are rare enough to just not cache the model
+            if (texture.Type.size() >= sizeof(record.Type) || texture.Path.size() >= sizeof(record.Path))
+                return false;
+            memcpy(record.Type, texture.Type.c_str(), texture.Type.size());
+            memcpy(record.Path, texture.Path.c_str(), texture.Path.size());
+            record.Cutoff = texture.Cutoff;
+            textures.push_back(record);
+        }
+    }
+    header.TextureCount = (uint32_t)textures.size();
+
+    uint64_t offset = alignCacheOffset(sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry) + textures.size() * sizeof(MeshCacheTexture));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        MeshCacheEntry& e = entries[i];
+        e.VertexCount = (uint32_t)meshes[i].Vertices.size();
+        e.IndexCount = (uint32_t)meshes[i].Indices.size();
+        e.VertexOffset = offset;
+        offset = alignCacheOffset(offset + (uint64_t)e.VertexCount * sizeof(Vertex));
+        e.IndexOffset = offset;
+        offset = alignCacheOffset(offset + (uint64_t)e.IndexCount * sizeof(unsigned int));
+    }
+
+    ofstream out(cachePath.c_str(), ios::binary | ios::trunc);
+    if (!out)
+    {
+        std::cout << "Mesh cache could not be written: " << cachePath << std::endl;
+        return false;
+    }
+    uint64_t written = 0;
+    writeCacheBlock(out, written, 0, &header, sizeof(header));
+    writeCacheBlock(out, written, written, entries.data(), entries.size() * sizeof(MeshCacheEntry));
+    writeCacheBlock(out, written, written, textures.data(), textures.size() * sizeof(MeshCacheTexture));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        writeCacheBlock(out, written, entries[i].VertexOffset, meshes[i].Vertices.data(), (uint64_t)entries[i].VertexCount * sizeof(Vertex));
+        writeCacheBlock(out, written, entries[i].IndexOffset, meshes[i].Indices.data(), (uint64_t)entries[i].IndexCount * sizeof(unsigned int));
+    }
+    writeCacheBlock(out, written, offset, NULL, 0);
+    if (!out)
+    {
+        std::cout << "Mesh cache could not be written: " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
+#endif
@@ -9,19 +9,37 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/GltfMaterial.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/bvh_cache.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/gltf_loader.h>
+#include <learnopengl/collision_proxy.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/transform.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/texture_registry.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+bool DecodeImage(const char *path, const string &directory, DecodedImage &image, CoverageMask* coverage = NULL, float alphaCutoff = 0.5f);
+unsigned int UploadTexture(DecodedImage &image);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, CoverageMask* coverage = NULL, float alphaCutoff = 0.5f);
+
+// how a model reads its file: through ASSIMP (and the mesh cache), or with the native glTF loader (gltf_loader.h),
+// which hands the files it does not handle to ASSIMP
+enum ModelLoader {
+    LOADER_ASSIMP,
+    LOADER_GLTF
+};
 
 class Model 
 {
@@ -31,7 +49,9 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
-    glm::mat4 ModelMatrix;
+    ObjectTransform Transform;
+    AABB Bounds;        // model space bounds of all meshes, used by the scene level BVH
+    CollisionProxy Proxy;   // analytic shape enclosing the meshes, PROXY_NONE until FitProxy finds one
 
     // Constructor predeterminado
     Model() : gammaCorrection(false) {
@@ -39,9 +59,105 @@ public:
     }
 
     // Constructor existente que carga un modelo desde una ruta de archivo.
-    Model(string const& path, bool gamma = false) {
-        loadModel(path);
-        ModelMatrix = glm::mat4(1.0f); // Inicializa la matriz de modelo a la identidad
+    Model(string const& path, bool gamma = false, ModelLoader loader = LOADER_GLTF) : gammaCorrection(gamma) {
+        Import(path, loader);
+        Upload();
+    }
+
+    // first half of the loading, with no GL calls so models can be imported concurrently on loader threads: parses
+    // the file, converts the meshes, decodes the textures (and their coverage masks) and builds or maps the BVHs
+    void Import(string const& path, ModelLoader loader = LOADER_GLTF)
+    {
+        loadModel(path, loader);
+        // the mesh BVHs are mapped from <path>.bvh, or built and saved there if it is missing or out of date
+        LoadOrBuildBVHs(meshes, path + ".bvh");
+#if defined(BVH_COMPRESSED_NODES)
+        // quantized 4-wide nodes: less memory and fewer node visits per shot, see BVH::Compress
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].bvh.Compress();
+#endif
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            Bounds.Grow(meshes[i].bvh.Bounds());
+        Transform.Set(glm::mat4(1.0f)); // Inicializa la matriz de modelo a la identidad
+        Transform.Refresh();   // la inversa y la matriz normal, para los rayos
+    }
+
+    // second half, on the thread that owns the GL context once Import has finished: creates the textures from the
+    // decoded images and the vertex buffers. With a streamer the textures start as placeholders and their pixels
+    // are uploaded over the next frames (see TextureStreamer); without one they are uploaded here. Textures another
+    // model already uploaded (same file contents, see TextureRegistry) are reused as they are.
+    void Upload(TextureStreamer* streamer = NULL)
+    {
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            textures_loaded[i].id = SharedTextures().Upload(*sharedTextures[i], streamer);
+        // glTF buffers go to the GPU as they are, one GL buffer each straight from the mapping; the meshes whose
+        // accessors GL can read point their VAOs into them
+        vector<unsigned int> buffers(sourceBuffers.size());
+        for(unsigned int i = 0; i < sourceBuffers.size(); i++)
+        {
+            glGenBuffers(1, &buffers[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, sourceBuffers[i]->Size(), sourceBuffers[i]->Data(), GL_STATIC_DRAW);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        sourceBuffers.clear();
+        // the meshes hold copies of the texture records; give them the ids
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+                meshes[i].textures[j].id = textures_loaded[loadedPaths[meshes[i].textures[j].path]].id;
+            meshes[i].Upload(buffers);
+        }
+    }
+
+    // calls use(image) with the decoded pixels of textures_loaded[i] if they are still held (TextureRegistry::Read),
+    // i.e. between Import and Upload; returns whether it did
+    template <typename Use>
+    bool ReadTexture(unsigned int i, Use use) const
+    {
+        return i < sharedTextures.size() && SharedTextures().Read(*sharedTextures[i], use);
+    }
+
+    // gives the model's textures back to the registry, which deletes those no other model still uses; on the GL
+    // thread, once per imported model (copies of a Model share its references)
+    void ReleaseTextures()
+    {
+        for(unsigned int i = 0; i < sharedTextures.size(); i++)
+            SharedTextures().Release(sharedTextures[i]);
+        sharedTextures.clear();
+        loadedPaths.clear();
+        textures_loaded.clear();
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].textures.clear();
+    }
+
+    // the meshes of a model file as the loader reads them, before their textures are loaded; no GL calls. The glTF
+    // loader also keeps its mapped buffers for Upload. False, after printing why, if the file could not be read.
+    // The processed meshes of ASSIMP are mapped from <path>.mesh when it was written for this very file and import
+    // flags (see mesh_cache.h); otherwise ASSIMP imports the file and the cache is written for the next run.
+    bool ReadMeshes(string const &path, ModelLoader loader, vector<ImportedMesh> &imported)
+    {
+        if(loader == LOADER_GLTF && LoadGltf(path, imported, sourceBuffers))
+            return true;
+        const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+        string cachePath = path + ".mesh";
+        uint64_t sourceHash = HashModelSource(path);
+        if(sourceHash == 0 || !ReadMeshCache(cachePath, sourceHash, importFlags, imported))
+        {
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, importFlags);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return false;
+            }
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene, imported);
+            WriteMeshCache(cachePath, sourceHash, importFlags, imported);
+        }
+        return true;
     }
 
     // draws the model, and thus all its meshes
@@ -52,35 +168,208 @@ public:
     }
 
     void SetPosition(const glm::vec3& position) {
-        ModelMatrix = glm::translate(glm::mat4(1.0f), position); // Establece la posicin del modelo
+        Transform.Set(glm::translate(glm::mat4(1.0f), position)); // Establece la posicin del modelo
+        Transform.Refresh();
     }
 
     glm::vec3 GetPosition() const {
-        return glm::vec3(ModelMatrix[3]); // Obtiene la posicin del modelo
+        return Transform.Position(); // Obtiene la posicin del modelo
+    }
+
+    // true if a model space ray hits any mesh closer than tMax
+    bool IntersectAny(const glm::vec3& origin, const glm::vec3& dir, float tMax = FLT_MAX) const
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(meshes[i].coverage)
+            {
+                // the first covered hit is enough: a cut-off of 0 ends the traversal
+                bool covered = false;
+                meshes[i].bvh.IntersectAll(origin, dir, tMax, [&](HitRecord& hit) {
+                    hit.Mesh = i;
+                    interpolateTexCoords(hit);
+                    covered = meshes[i].coverage->Covered(hit.TexCoords);
+                    return covered ? 0.0f : tMax;
+                });
+                if(covered)
+                    return true;
+            }
+            else if(meshes[i].bvh.IntersectAny(origin, dir, tMax))
+                return true;
+        }
+        return false;
+    }
+
+    // fits the collision proxy that hit tests can try before the meshes (see FitCollisionProxy). maxError is a
+    // fraction of the diagonal of Bounds; returns false if no shape stays that close to the meshes.
+    bool FitProxy(float maxError)
+    {
+        vector<glm::vec3> points;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            for(unsigned int j = 0; j < meshes[i].vertices.size(); j++)
+                points.push_back(meshes[i].vertices[j].Position);
+        Proxy = FitCollisionProxy(points, maxError * glm::length(Bounds.max - Bounds.min), [&](const glm::vec3& point, float distance) {
+            // a sphere of that radius overlapping a mesh touches it at t = 0; the tiny oblique motion only keeps
+            // the slab tests away from zero direction components
+            HitRecord hit;
+            return SweepSphere(point, glm::vec3(1e-6f * distance), distance, hit, 1.0f);
+        });
+        return Proxy.Shape != PROXY_NONE;
+    }
+
+    // closest hit of a model space ray against every mesh. Besides the BVH result the record gets the mesh index
+    // and the texture coordinates interpolated from the hit triangle's vertices; the hit point is left to the
+    // caller, which knows the world space ray. Meshes with a coverage mask skip hits on transparent texels.
+    bool IntersectClosest(const glm::vec3& origin, const glm::vec3& dir, HitRecord& hit, float tMax = FLT_MAX) const
+    {
+        bool found = false;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(meshes[i].coverage)
+                found |= coveredClosest(i, origin, dir, hit, tMax);
+            else if(meshes[i].bvh.IntersectClosest(origin, dir, hit, tMax))
+            {
+                tMax = hit.T;
+                hit.Mesh = i;
+                found = true;
+            }
+        }
+        if(found)
+            interpolateTexCoords(hit);
+        return found;
+    }
+
+    // closest hit for many model space rays at once, each like IntersectClosest: found[i] tells whether rays[i] hit
+    // a mesh closer than its TMax, and then hits[i] has the record. Meshes without a coverage mask take the rays in
+    // packets (see BVH::IntersectClosest); alpha tested ones go one ray at a time.
+    void IntersectClosest(const Ray* rays, unsigned int count, HitRecord* hits, bool* found) const
+    {
+        const unsigned int CHUNK = 64;
+        Ray chunk[CHUNK];
+        HitRecord meshHits[CHUNK];
+        bool meshFound[CHUNK];
+        for(unsigned int first = 0; first < count; first += CHUNK)
+        {
+            unsigned int n = count - first < CHUNK ? count - first : CHUNK;
+            for(unsigned int j = 0; j < n; j++)
+            {
+                chunk[j] = rays[first + j];
+                found[first + j] = false;
+            }
+            for(unsigned int i = 0; i < meshes.size(); i++)
+            {
+                if(meshes[i].coverage)
+                {
+                    for(unsigned int j = 0; j < n; j++)
+                        if(coveredClosest(i, chunk[j].Origin, chunk[j].Direction, hits[first + j], chunk[j].TMax))
+                            found[first + j] = true;
+                    continue;
+                }
+                meshes[i].bvh.IntersectClosest(chunk, n, meshHits, meshFound);
+                for(unsigned int j = 0; j < n; j++)
+                {
+                    if(!meshFound[j])
+                        continue;
+                    hits[first + j] = meshHits[j];
+                    hits[first + j].Mesh = i;
+                    chunk[j].TMax = meshHits[j].T;
+                    found[first + j] = true;
+                }
+            }
+            for(unsigned int j = 0; j < n; j++)
+                if(found[first + j])
+                    interpolateTexCoords(hits[first + j]);
+        }
+    }
+
+    // closest contact of a sphere swept along a model space ray (see BVH::SweepSphere); radius is in model units.
+    // Not alpha tested: the sphere touches an area of the texture, not one texel.
+    bool SweepSphere(const glm::vec3& origin, const glm::vec3& dir, float radius, HitRecord& hit, float tMax = FLT_MAX) const
+    {
+        bool found = false;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(meshes[i].bvh.SweepSphere(origin, dir, radius, hit, tMax))
+            {
+                tMax = hit.T;
+                hit.Mesh = i;
+                found = true;
+            }
+        }
+        if(found)
+            interpolateTexCoords(hit);
+        return found;
+    }
+
+    // every hit of a model space ray closer than tMax, over all meshes but the transparent texels of alpha tested
+    // ones; onHit gets each record with Mesh and TexCoords filled and returns the distance past which it wants no
+    // more hits (see BVH::IntersectAll)
+    template <typename OnHit>
+    float IntersectAll(const glm::vec3& origin, const glm::vec3& dir, float tMax, OnHit onHit) const
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            tMax = meshes[i].bvh.IntersectAll(origin, dir, tMax, [&](HitRecord& hit) {
+                hit.Mesh = i;
+                interpolateTexCoords(hit);
+                if(meshes[i].coverage && !meshes[i].coverage->Covered(hit.TexCoords))
+                    return tMax;
+                return tMax = onHit(hit);
+            });
+        }
+        return tMax;
     }
     
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    vector<shared_ptr<SharedTexture> > sharedTextures;  // registry entry of textures_loaded[i]
+    unordered_map<string, unsigned int> loadedPaths;    // index in textures_loaded by material path
+    vector<shared_ptr<MappedFile> > sourceBuffers;  // glTF buffers the meshes' VertexSource refers to, until Upload
+
+    // texture coordinates at the hit point, from the barycentrics and the hit triangle's vertices
+    void interpolateTexCoords(HitRecord& hit) const
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        const Mesh& mesh = meshes[hit.Mesh];
+        const unsigned int* tri = &mesh.indices[hit.Triangle * 3];
+        float u = hit.Barycentric.x, v = hit.Barycentric.y;
+        hit.TexCoords = (1.0f - u - v) * mesh.vertices[tri[0]].TexCoords + u * mesh.vertices[tri[1]].TexCoords + v * mesh.vertices[tri[2]].TexCoords;
+    }
+
+    // closest covered hit of mesh i (which has a coverage mask) nearer than tMax, alpha tested like an any-hit
+    // shader: the BVH reports every hit, covered ones shrink the search. Lowers tMax and fills hit on a find.
+    bool coveredClosest(unsigned int i, const glm::vec3& origin, const glm::vec3& dir, HitRecord& hit, float& tMax) const
+    {
+        bool found = false;
+        tMax = meshes[i].bvh.IntersectAll(origin, dir, tMax, [&](HitRecord& candidate) {
+            candidate.Mesh = i;
+            interpolateTexCoords(candidate);
+            if(!meshes[i].coverage->Covered(candidate.TexCoords))
+                return tMax;
+            hit = candidate;
+            found = true;
+            return tMax = candidate.T;
+        });
+        return found;
+    }
+
+    // loads a model with supported ASSIMP extensions, or a glTF file with the native loader, from file and stores
+    // the resulting meshes in the meshes vector.
+    void loadModel(string const &path, ModelLoader loader)
+    {
+        vector<ImportedMesh> imported;
+        if(!ReadMeshes(path, loader, imported))
             return;
-        }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        for(unsigned int i = 0; i < imported.size(); i++)
+        {
+            meshes.push_back(Mesh(std::move(imported[i].Vertices), std::move(imported[i].Indices), loadMaterialTextures(imported[i].Textures)));
+            meshes.back().source = imported[i].Source;
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    void processNode(aiNode *node, const aiScene *scene, vector<ImportedMesh> &imported)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -88,22 +377,22 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            imported.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, imported);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    ImportedMesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        ImportedMesh result;
+        vector<Vertex>& vertices = result.Vertices;
+        vector<unsigned int>& indices = result.Indices;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -166,79 +455,148 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", result.Textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", result.Textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", result.Textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", result.Textures);
+
+        // the textures are loaded once the mesh data is known, from ASSIMP or from the cache
+        return result;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // lists all material textures of a given type; diffuse maps of alpha tested or blended materials also carry
+    // the cutoff of the coverage mask for ray queries
+    void collectMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<MaterialTexture> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
+            MaterialTexture texture;
+            texture.Type = typeName;
+            texture.Path = str.C_Str();
+            texture.Cutoff = typeName == "texture_diffuse" ? coverageCutoff(mat) : -1.0f;
+            textures.push_back(texture);
+        }
+    }
+
+    // loads the textures of a mesh if they're not loaded yet.
+    // the required info is returned as a Texture struct.
+    vector<Texture> loadMaterialTextures(const vector<MaterialTexture> &materialTextures)
+    {
+        vector<Texture> textures;
+        for(unsigned int i = 0; i < materialTextures.size(); i++)
+        {
+            const MaterialTexture& material = materialTextures[i];
             // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
+            unordered_map<string, unsigned int>::const_iterator loaded = loadedPaths.find(material.Path);
+            if(loaded != loadedPaths.end())
+                textures.push_back(textures_loaded[loaded->second]);
+            else
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
+                // the registry decodes each distinct image once for all models; diffuse maps of alpha tested or
+                // blended materials also get the coverage mask for ray queries
+                shared_ptr<CoverageMask> coverage;
+                sharedTextures.push_back(SharedTextures().Acquire(material.Path, this->directory, material.Cutoff, coverage));
+                // Upload creates the GL texture, or finds it, and fills in the id
+                texture.id = 0;
+                texture.coverage = coverage;
+                texture.type = material.Type;
+                texture.path = material.Path;
                 textures.push_back(texture);
+                loadedPaths[material.Path] = textures_loaded.size();
                 textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
             }
         }
         return textures;
     }
+
+    // alpha below which a diffuse texel stops ray hits: the glTF alphaCutoff of MASK materials, and 0.5 for BLEND
+    // ones (hits count where the surface is drawn at least half opaque). Negative for opaque materials, whose
+    // alpha channel is ignored, and for formats without an alpha mode.
+    float coverageCutoff(aiMaterial *mat) const
+    {
+        aiString mode;
+        if(mat->Get(AI_MATKEY_GLTF_ALPHAMODE, mode) != AI_SUCCESS || std::strcmp(mode.C_Str(), "OPAQUE") == 0)
+            return -1.0f;
+        float cutoff = 0.5f;
+        if(std::strcmp(mode.C_Str(), "MASK") == 0)
+            mat->Get(AI_MATKEY_GLTF_ALPHACUTOFF, cutoff);
+        return cutoff;
+    }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// decodes the image at directory/path into image; with a coverage mask given, also builds it from the image's
+// alpha channel (see CoverageMask::Build) while the decoded pixels are at hand. Makes no GL calls. If
+// tools/texture_compress left a block compressed copy of this version of the image (path + ".ktx2"), that copy
+// is what gets uploaded, and the image itself is only decoded for the coverage mask.
+bool DecodeImage(const char *path, const string &directory, DecodedImage &image, CoverageMask* coverage, float alphaCutoff)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    image.Data = NULL;
+    image.Compressed.reset();
+    shared_ptr<Ktx2Texture> compressed = make_shared<Ktx2Texture>();
+    MappedFile source;
+    if (ReadKtx2(filename + ".ktx2", *compressed) && source.Open(filename) &&
+        compressed->SourceHash == hashFileContents(source.Data(), source.Size()))
+    {
+        image.Compressed = compressed;
+        image.Width = compressed->Width;
+        image.Height = compressed->Height;
+        image.Components = 0;
+        if (!coverage)
+            return true;
+    }
+
+    image.Data = stbi_load(filename.c_str(), &image.Width, &image.Height, &image.Components, 0);
+    if (!image.Data)
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return image.Compressed.get() != NULL;
+    }
+    if (coverage)
+        coverage->Build(image.Data, image.Width, image.Height, image.Components, alphaCutoff);
+    if (image.Compressed)
+    {
+        stbi_image_free(image.Data);
+        image.Data = NULL;
+    }
+    return true;
+}
+
+// creates a texture with mipmaps from a decoded image and frees the pixels, or from its block compressed copy.
+// An image that failed to decode still gets a texture name, with no storage, like before.
+unsigned int UploadTexture(DecodedImage &image)
+{
+    if (image.Compressed)
+    {
+        unsigned int textureID = UploadKtx2(*image.Compressed);
+        image.Compressed.reset();
+        return textureID;
+    }
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    if (image.Data)
     {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.Components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.Components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.Components == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.Width, image.Height, 0, format, GL_UNSIGNED_BYTE, image.Data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -246,14 +604,19 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        stbi_image_free(image.Data);
+        image.Data = NULL;
     }
 
     return textureID;
 }
+
+// uploads the image at directory/path with mipmaps, from its KTX2 copy if there is an up to date one; with a
+// coverage mask given, also builds it from the image's alpha channel (see CoverageMask::Build)
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, CoverageMask* coverage, float alphaCutoff)
+{
+    DecodedImage image;
+    DecodeImage(path, directory, image, coverage, alphaCutoff);
+    return UploadTexture(image);
+}
 #endif
\ No newline at end of file
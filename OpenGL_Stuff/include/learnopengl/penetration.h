@@ -0,0 +1,72 @@
+#ifndef PENETRATION_H
+#define PENETRATION_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bvh.h>
+
+#include <cfloat>
+using namespace std;
+
+// how hard a surface is to shoot through: a bullet pays SurfaceCost to enter it and CostPerUnit for every world
+// unit it travels inside it
+struct PenetrationMaterial {
+    float SurfaceCost;
+    float CostPerUnit;
+
+    PenetrationMaterial(float surfaceCost = 0.0f, float costPerUnit = 0.0f) : SurfaceCost(surfaceCost), CostPerUnit(costPerUnit) {}
+};
+
+// Walks the hits of a ray front to back (as collected by an IntersectAll query into a HitList) and spends the
+// bullet's power on every surface it goes through. The odd hits of an instance enter it and the even ones leave
+// it, so the meshes must be closed. materialOf(instance) gives the PenetrationMaterial of a scene instance.
+// Returns the ray distance where the bullet stops, or FLT_MAX if it gets through every hit. A full list may have
+// dropped farther hits, so then the bullet is assumed to stop at the last one.
+template <unsigned int Capacity, typename MaterialOf>
+float ResolvePenetration(const HitList<Capacity>& hits, const glm::vec3& dir, float power, MaterialOf materialOf)
+{
+    const unsigned int MAX_INSIDE = Capacity;
+    unsigned int inside[MAX_INSIDE];   // instances the bullet is currently in
+    float entry[MAX_INSIDE];           // and where it entered them
+    unsigned int insideCount = 0;
+    float length = glm::length(dir);
+    float lastT = -FLT_MAX;
+    unsigned int lastInstance = ~0u;
+    for (unsigned int i = 0; i < hits.Count; i++)
+    {
+        const HitRecord& hit = hits.Hits[i];
+        // a ray through a shared edge reports both triangles; count it once
+        if (hit.Instance == lastInstance && hit.T - lastT <= 1e-5f * hit.T)
+            continue;
+        lastT = hit.T;
+        lastInstance = hit.Instance;
+        PenetrationMaterial material = materialOf(hit.Instance);
+
+        unsigned int k = 0;
+        while (k < insideCount && inside[k] != hit.Instance)
+            k++;
+        if (k == insideCount)
+        {
+            // entering
+            power -= material.SurfaceCost;
+            if (power <= 0.0f)
+                return hit.T;
+            inside[insideCount] = hit.Instance;
+            entry[insideCount] = hit.T;
+            insideCount++;
+            continue;
+        }
+        // leaving: pay for the thickness, or stop inside
+        float cost = material.CostPerUnit * (hit.T - entry[k]) * length;
+        if (cost >= power)
+            return entry[k] + power / (material.CostPerUnit * length);
+        power -= cost;
+        insideCount--;
+        inside[k] = inside[insideCount];
+        entry[k] = entry[insideCount];
+    }
+    if (hits.Full())
+        return hits.Hits[hits.Count - 1].T;
+    return FLT_MAX;
+}
+#endif
@@ -0,0 +1,119 @@
+#ifndef QUERY_WORKER_H
+#define QUERY_WORKER_H
+
+#include <learnopengl/spsc_queue.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+using namespace std;
+
+// Runs queries on a dedicated thread. The render thread submits requests and polls results through two lock-free
+// SPSC rings, so it never waits for the worker; whatever a query reads must be immutable or owned by the worker.
+// The worker's state is changed only by updates the render thread publishes through a third ring: they are applied
+// on the worker, in order, and all those published before a request was submitted are applied before it is
+// resolved (see the target moves in the main program). While idle the worker yields for a while and then naps
+// briefly.
+template <typename Request, typename Result, typename Update, unsigned int N>
+class QueryWorker {
+public:
+    typedef function<void(const Request&, Result&)> Resolver;
+    typedef function<void(const Update&)> Updater;
+
+    QueryWorker() : running(false) {}
+
+    ~QueryWorker()
+    {
+        Stop();
+    }
+
+    void Start(Resolver resolver, Updater updater)
+    {
+        Stop();
+        resolve = resolver;
+        apply = updater;
+        running.store(true);
+        worker = std::thread(&QueryWorker::run, this);
+    }
+
+    // asks the thread to finish and waits for it; requests and updates still queued are dropped
+    void Stop()
+    {
+        if (!worker.joinable())
+            return;
+        running.store(false);
+        worker.join();
+    }
+
+    // render thread: returns false if the request ring is full
+    bool Submit(const Request& request)
+    {
+        return requests.TryPush(request);
+    }
+
+    // render thread: queues a change to the worker's state; returns false if the update ring is full. Updates may be
+    // published before Start, e.g. the initial state.
+    bool Publish(const Update& update)
+    {
+        return updates.TryPush(update);
+    }
+
+    // render thread: takes one finished result, if any
+    bool Poll(Result& result)
+    {
+        return results.TryPop(result);
+    }
+
+private:
+    SpscQueue<Request, N> requests;
+    SpscQueue<Result, N> results;
+    SpscQueue<Update, N> updates;
+    Resolver resolve;
+    Updater apply;
+    atomic<bool> running;
+    std::thread worker;
+
+    void run()
+    {
+        const int SPINS = 1000;
+        int idle = 0;
+        Request request;
+        Result result;
+        while (running.load(memory_order_relaxed))
+        {
+            // updates are applied as they come, so their ring doesn't fill up while no requests arrive
+            bool updated = applyUpdates();
+            if (!requests.TryPop(request))
+            {
+                if (updated)
+                    idle = 0;
+                else if (++idle < SPINS)
+                    this_thread::yield();
+                else
+                    this_thread::sleep_for(chrono::microseconds(200));
+                continue;
+            }
+            idle = 0;
+            // the request was pushed after the updates published before it, so they are in the ring by now
+            applyUpdates();
+            resolve(request, result);
+            // the render thread drains results every frame; if it fell behind, wait instead of losing a result
+            while (!results.TryPush(result) && running.load(memory_order_relaxed))
+                this_thread::yield();
+        }
+    }
+
+    bool applyUpdates()
+    {
+        bool applied = false;
+        Update update;
+        while (updates.TryPop(update))
+        {
+            apply(update);
+            applied = true;
+        }
+        return applied;
+    }
+};
+#endif
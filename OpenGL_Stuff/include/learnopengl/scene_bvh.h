@@ -0,0 +1,258 @@
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/transform.h>
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+using namespace std;
+
+// Top level of a two level acceleration structure. Every Model keeps its own per mesh BVHs in model space (the
+// bottom level); the scene only stores instances, i.e. a model plus the id of its transform in a TransformCache,
+// so a model drawn several times shares its BVHs. The top level tree over the instances' world space boxes holds
+// a handful of entries and is rebuilt from scratch by Update, which is cheap enough to do every frame.
+class SceneBVH {
+public:
+    struct Instance {
+        const Model* Geometry;
+        unsigned int TransformId;
+        glm::mat4 InverseWorld;   // copied on Update so queries don't need the transform cache
+        AABB Bounds;              // world space
+    };
+
+    static const int MAX_DEPTH = 64;
+
+    vector<Instance> instances;
+    vector<BVHNode> nodes;
+    vector<unsigned int> instIndices;
+
+    // registers an instance of model placed by the given transform; returns the instance id reported in hits
+    unsigned int AddInstance(const Model& model, unsigned int transformId)
+    {
+        Instance instance;
+        instance.Geometry = &model;
+        instance.TransformId = transformId;
+        instances.push_back(instance);
+        return (unsigned int)(instances.size() - 1);
+    }
+
+    // picks up the current transforms and rebuilds the tree
+    void Update(TransformCache& transforms)
+    {
+        for (unsigned int i = 0; i < instances.size(); i++)
+        {
+            const ObjectTransform& transform = transforms.Get(instances[i].TransformId);
+            instances[i].InverseWorld = transform.InverseWorld;
+            instances[i].Bounds = instances[i].Geometry->Bounds.Transformed(transform.World);
+        }
+        build();
+    }
+
+    // closest hit over all instances. Fills the whole record, with Instance set and Point in world space.
+    bool IntersectClosest(const glm::vec3& origin, const glm::vec3& dir, HitRecord& hit, float tMax = FLT_MAX) const
+    {
+        if (nodes.empty())
+            return false;
+        glm::vec3 invDir = 1.0f / dir;
+        if (IntersectRayAABB(origin, invDir, nodes[0].boundsMin, nodes[0].boundsMax, tMax) == FLT_MAX)
+            return false;
+
+        unsigned int stack[MAX_DEPTH];
+        float stackDist[MAX_DEPTH];
+        int stackPtr = 0;
+        unsigned int nodeIdx = 0;
+        bool found = false;
+        while (true)
+        {
+            const BVHNode& node = nodes[nodeIdx];
+            if (node.IsLeaf())
+            {
+                for (unsigned int i = 0; i < node.triCount; i++)
+                {
+                    unsigned int id = instIndices[node.leftFirst + i];
+                    const Instance& instance = instances[id];
+                    if (IntersectRayAABB(origin, invDir, instance.Bounds.min, instance.Bounds.max, tMax) == FLT_MAX)
+                        continue;
+                    // directions stay unnormalized, so t is the same in world and model space
+                    glm::vec3 localOrigin = glm::vec3(instance.InverseWorld * glm::vec4(origin, 1.0f));
+                    glm::vec3 localDir = glm::vec3(instance.InverseWorld * glm::vec4(dir, 0.0f));
+                    if (instance.Geometry->IntersectClosest(localOrigin, localDir, hit, tMax))
+                    {
+                        tMax = hit.T;
+                        hit.Instance = id;
+                        found = true;
+                    }
+                }
+            }
+            else
+            {
+                unsigned int child1 = node.leftFirst;
+                unsigned int child2 = node.leftFirst + 1;
+                float dist1 = IntersectRayAABB(origin, invDir, nodes[child1].boundsMin, nodes[child1].boundsMax, tMax);
+                float dist2 = IntersectRayAABB(origin, invDir, nodes[child2].boundsMin, nodes[child2].boundsMax, tMax);
+                if (dist1 > dist2)
+                {
+                    swap(dist1, dist2);
+                    swap(child1, child2);
+                }
+                if (dist1 != FLT_MAX)
+                {
+                    if (dist2 != FLT_MAX)
+                    {
+                        stackDist[stackPtr] = dist2;
+                        stack[stackPtr++] = child2;
+                    }
+                    nodeIdx = child1;
+                    continue;
+                }
+            }
+            while (stackPtr > 0 && stackDist[stackPtr - 1] > tMax)
+                stackPtr--;
+            if (stackPtr == 0)
+                break;
+            nodeIdx = stack[--stackPtr];
+        }
+        if (found)
+            hit.Point = origin + hit.T * dir;
+        return found;
+    }
+
+    // every hit closer than tMax over all instances, for bullets that go through things. onHit gets each record with
+    // Instance and the world space Point filled and returns the distance past which it wants no more hits
+    // (e.g. HitList::Add); returns the final cut-off.
+    template <typename OnHit>
+    float IntersectAll(const glm::vec3& origin, const glm::vec3& dir, float tMax, OnHit onHit) const
+    {
+        if (nodes.empty())
+            return tMax;
+        glm::vec3 invDir = 1.0f / dir;
+        unsigned int stack[MAX_DEPTH];
+        int stackPtr = 0;
+        stack[stackPtr++] = 0;
+        while (stackPtr > 0)
+        {
+            const BVHNode& node = nodes[stack[--stackPtr]];
+            if (IntersectRayAABB(origin, invDir, node.boundsMin, node.boundsMax, tMax) == FLT_MAX)
+                continue;
+            if (!node.IsLeaf())
+            {
+                stack[stackPtr++] = node.leftFirst;
+                stack[stackPtr++] = node.leftFirst + 1;
+                continue;
+            }
+            for (unsigned int i = 0; i < node.triCount; i++)
+            {
+                unsigned int id = instIndices[node.leftFirst + i];
+                const Instance& instance = instances[id];
+                glm::vec3 localOrigin = glm::vec3(instance.InverseWorld * glm::vec4(origin, 1.0f));
+                glm::vec3 localDir = glm::vec3(instance.InverseWorld * glm::vec4(dir, 0.0f));
+                tMax = instance.Geometry->IntersectAll(localOrigin, localDir, tMax, [&](HitRecord& hit) {
+                    hit.Instance = id;
+                    hit.Point = origin + hit.T * dir;
+                    return onHit(hit);
+                });
+            }
+        }
+        return tMax;
+    }
+
+    // true if anything in the scene is hit closer than tMax, e.g. to test line of sight
+    bool IntersectAny(const glm::vec3& origin, const glm::vec3& dir, float tMax = FLT_MAX) const
+    {
+        if (nodes.empty())
+            return false;
+        glm::vec3 invDir = 1.0f / dir;
+        unsigned int stack[MAX_DEPTH];
+        int stackPtr = 0;
+        stack[stackPtr++] = 0;
+        while (stackPtr > 0)
+        {
+            const BVHNode& node = nodes[stack[--stackPtr]];
+            if (IntersectRayAABB(origin, invDir, node.boundsMin, node.boundsMax, tMax) == FLT_MAX)
+                continue;
+            if (!node.IsLeaf())
+            {
+                stack[stackPtr++] = node.leftFirst;
+                stack[stackPtr++] = node.leftFirst + 1;
+                continue;
+            }
+            for (unsigned int i = 0; i < node.triCount; i++)
+            {
+                const Instance& instance = instances[instIndices[node.leftFirst + i]];
+                glm::vec3 localOrigin = glm::vec3(instance.InverseWorld * glm::vec4(origin, 1.0f));
+                glm::vec3 localDir = glm::vec3(instance.InverseWorld * glm::vec4(dir, 0.0f));
+                if (instance.Geometry->IntersectAny(localOrigin, localDir, tMax))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static const unsigned int LEAF_SIZE = 2;
+
+    // median split along the widest axis of the instance centers. With so few instances this beats a SAH build
+    // on rebuild time and the query cost is dominated by the bottom level anyway.
+    void build()
+    {
+        nodes.clear();
+        instIndices.resize(instances.size());
+        for (unsigned int i = 0; i < instances.size(); i++)
+            instIndices[i] = i;
+        if (instances.empty())
+            return;
+        nodes.reserve(instances.size() * 2);
+        BVHNode root;
+        root.leftFirst = 0;
+        root.triCount = (unsigned int)instances.size();
+        nodes.push_back(root);
+        subdivide(0, 0);
+    }
+
+    void subdivide(unsigned int nodeIdx, int depth)
+    {
+        unsigned int first = nodes[nodeIdx].leftFirst;
+        unsigned int count = nodes[nodeIdx].triCount;
+        AABB bounds, centers;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const AABB& b = instances[instIndices[first + i]].Bounds;
+            bounds.Grow(b);
+            centers.Grow(b.Center());
+        }
+        nodes[nodeIdx].boundsMin = bounds.min;
+        nodes[nodeIdx].boundsMax = bounds.max;
+        if (count <= LEAF_SIZE || depth >= MAX_DEPTH - 1)
+            return;
+
+        glm::vec3 extent = centers.max - centers.min;
+        int axis = 0;
+        if (extent.y > extent.x)
+            axis = 1;
+        if (extent.z > extent[axis])
+            axis = 2;
+        unsigned int half = count / 2;
+        const vector<Instance>& inst = instances;
+        nth_element(instIndices.begin() + first, instIndices.begin() + first + half, instIndices.begin() + first + count,
+                    [&inst, axis](unsigned int a, unsigned int b) { return inst[a].Bounds.Center()[axis] < inst[b].Bounds.Center()[axis]; });
+
+        unsigned int leftChildIdx = (unsigned int)nodes.size();
+        BVHNode left, right;
+        left.leftFirst = first;
+        left.triCount = half;
+        right.leftFirst = first + half;
+        right.triCount = count - half;
+        nodes.push_back(left);
+        nodes.push_back(right);
+        nodes[nodeIdx].leftFirst = leftChildIdx;
+        nodes[nodeIdx].triCount = 0;
+        subdivide(leftChildIdx, depth + 1);
+        subdivide(leftChildIdx + 1, depth + 1);
+    }
+};
+#endif
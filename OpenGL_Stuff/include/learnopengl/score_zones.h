@@ -0,0 +1,123 @@
+#ifndef SCORE_ZONES_H
+#define SCORE_ZONES_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/stb_image.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cfloat>
+using namespace std;
+
+// Score lookup table for the archery target. The base color texture is decoded once at load time and every cell
+// of a SIZE x SIZE grid over UV space gets the score of the ring color covering most of its texels, so scoring a
+// shot is one array lookup with the hit's texture coordinates instead of a texture fetch.
+class ScoreZones {
+public:
+    static const int SIZE = 256;
+
+    // score per cell, row 0 at v = 0 (the top row of the image, the model is loaded with flipped UVs)
+    vector<unsigned char> Zones;
+
+    ScoreZones() {}
+
+    // builds the table from the target's base color texture file; returns false if the image can't be read
+    bool Load(const string& path)
+    {
+        int width, height, nrComponents;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
+        if (!data)
+        {
+            std::cout << "Score zones failed to load at path: " << path << std::endl;
+            return false;
+        }
+        Build(data, width, height, nrComponents);
+        stbi_image_free(data);
+        return true;
+    }
+
+    // builds the table from the already decoded pixels of the base color texture
+    void Build(const unsigned char* data, int width, int height, int nrComponents)
+    {
+        Zones.assign(SIZE * SIZE, 0);
+        for (int y = 0; y < SIZE; y++)
+        {
+            int y0 = y * height / SIZE, y1 = glm::max(y0 + 1, (y + 1) * height / SIZE);
+            for (int x = 0; x < SIZE; x++)
+            {
+                int x0 = x * width / SIZE, x1 = glm::max(x0 + 1, (x + 1) * width / SIZE);
+                // majority vote of the texels under the cell, so ring borders don't leak into their neighbours
+                unsigned int votes[PALETTE_SIZE] = { 0 };
+                for (int ty = y0; ty < y1; ty++)
+                    for (int tx = x0; tx < x1; tx++)
+                        votes[classify(&data[(ty * width + tx) * nrComponents], nrComponents)]++;
+                int best = 0;
+                for (int i = 1; i < PALETTE_SIZE; i++)
+                    if (votes[i] > votes[best])
+                        best = i;
+                Zones[y * SIZE + x] = palette()[best].score;
+            }
+        }
+    }
+
+    bool Empty() const
+    {
+        return Zones.empty();
+    }
+
+    // score of the zone under the given texture coordinates; the texture repeats, so only the fraction is used
+    int Score(const glm::vec2& uv) const
+    {
+        if (Zones.empty())
+            return 0;
+        glm::vec2 f = glm::fract(uv);
+        int x = glm::min((int)(f.x * SIZE), SIZE - 1);
+        int y = glm::min((int)(f.y * SIZE), SIZE - 1);
+        return Zones[y * SIZE + x];
+    }
+
+private:
+    struct PaletteColor {
+        glm::vec3 color;
+        unsigned char score;
+    };
+    static const int PALETTE_SIZE = 8;
+
+    // ring colors of the target texture and their score; the wooden stand and anything unrecognised is worth 0
+    static const PaletteColor* palette()
+    {
+        static const PaletteColor colors[PALETTE_SIZE] = {
+            { glm::vec3(232.0f, 200.0f,   0.0f), 10 }, // gold
+            { glm::vec3(224.0f,  16.0f,   0.0f),  8 }, // red
+            { glm::vec3(  0.0f,  24.0f, 240.0f),  6 }, // blue
+            { glm::vec3( 40.0f, 120.0f, 216.0f),  6 }, // blue ring lines
+            { glm::vec3(  0.0f,   0.0f,   0.0f),  4 }, // black
+            { glm::vec3(224.0f, 224.0f, 224.0f),  2 }, // white
+            { glm::vec3(192.0f, 192.0f, 192.0f),  2 }, // shaded white
+            { glm::vec3(144.0f,  96.0f,  56.0f),  0 }  // wood
+        };
+        return colors;
+    }
+
+    // index of the palette color nearest to a texel
+    static int classify(const unsigned char* texel, int nrComponents)
+    {
+        glm::vec3 c = nrComponents >= 3 ? glm::vec3(texel[0], texel[1], texel[2]) : glm::vec3(texel[0]);
+        int best = 0;
+        float bestDist = FLT_MAX;
+        for (int i = 0; i < PALETTE_SIZE; i++)
+        {
+            glm::vec3 d = c - palette()[i].color;
+            float dist = glm::dot(d, d);
+            if (dist < bestDist)
+            {
+                bestDist = dist;
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+#endif
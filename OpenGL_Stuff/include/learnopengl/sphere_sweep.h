@@ -0,0 +1,137 @@
+#ifndef SPHERE_SWEEP_H
+#define SPHERE_SWEEP_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cfloat>
+using namespace std;
+
+// earliest t in [0, tMax) with a t'^2 + b t' + c <= 0, where t = offset + t', or false. Writing the quadratic
+// around a point of the sweep close to the feature (offset) keeps the radius from vanishing in the rounding of
+// large distances when a small sphere comes from far away. With a = 0 the sphere does not move relative to the
+// feature and touches it throughout if c <= 0.
+inline bool smallestSweepRoot(float a, float b, float c, float offset, float tMax, float& t)
+{
+    float entry = -FLT_MAX, exit = FLT_MAX;
+    if (a > 0.0f)
+    {
+        float discriminant = b * b - 4.0f * a * c;
+        if (discriminant < 0.0f)
+            return false;
+        float root = sqrtf(discriminant);
+        entry = offset + (-b - root) / (2.0f * a);
+        exit = offset + (-b + root) / (2.0f * a);
+    }
+    else if (c > 0.0f)
+        return false;
+    if (exit < 0.0f || entry >= tMax)
+        return false;
+    t = glm::max(entry, 0.0f);
+    return true;
+}
+
+// Exact sweep of a sphere of the given radius whose center moves along origin + t * dir against triangle v0 v1 v2
+// (the capsule test: the sphere touches the triangle at the smallest such t). The face is tested first; if the
+// first contact with the triangle's plane is outside the triangle, the sphere can only touch an edge or a vertex,
+// which are swept as cylinders and spheres. On a hit closer than tMax returns true with the contact distance t and
+// the barycentrics u, v (weights of v1 and v2) of the touched point of the triangle.
+inline bool SweepSphereTriangle(const glm::vec3& origin, const glm::vec3& dir, float radius, const glm::vec3& v0, const glm::vec3& v1,
+                                const glm::vec3& v2, float tMax, float& t, float& u, float& v)
+{
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    glm::vec3 normal = glm::cross(edge1, edge2);
+    float area2 = glm::dot(normal, normal);
+    // slivers (an edge shrunk to rounding noise) have no usable plane; their edges belong to the neighbours too
+    if (area2 <= 1e-10f * glm::dot(edge1, edge1) * glm::dot(edge2, edge2))
+        return false;
+    normal *= 1.0f / sqrtf(area2);
+
+    // signed distance of the center to the plane is dist0 + t * speed; find when it is within radius
+    float dist0 = glm::dot(normal, origin - v0);
+    float speed = glm::dot(normal, dir);
+    float tEnter, tExit;
+    if (fabsf(speed) < 1e-12f)
+    {
+        if (fabsf(dist0) > radius)
+            return false;
+        tEnter = 0.0f;
+        tExit = FLT_MAX;
+    }
+    else
+    {
+        float t0 = (radius - dist0) / speed;
+        float t1 = (-radius - dist0) / speed;
+        tEnter = glm::min(t0, t1);
+        tExit = glm::max(t0, t1);
+    }
+    // this early out rejects almost every triangle of a leaf
+    if (tEnter >= tMax || tExit < 0.0f)
+        return false;
+    tEnter = glm::max(tEnter, 0.0f);
+
+    // face: the point of the plane under the center when the sphere reaches it
+    glm::vec3 center = origin + tEnter * dir;
+    glm::vec3 p = center - (glm::dot(normal, center - v0)) * normal;
+    float d00 = glm::dot(edge1, edge1), d01 = glm::dot(edge1, edge2), d11 = glm::dot(edge2, edge2);
+    glm::vec3 w = p - v0;
+    float d20 = glm::dot(w, edge1), d21 = glm::dot(w, edge2);
+    float invDenom = 1.0f / (d00 * d11 - d01 * d01);
+    float bu = (d11 * d20 - d01 * d21) * invDenom;
+    float bv = (d00 * d21 - d01 * d20) * invDenom;
+    if (bu >= 0.0f && bv >= 0.0f && bu + bv <= 1.0f)
+    {
+        t = tEnter;
+        u = bu;
+        v = bv;
+        return true;
+    }
+
+    // vertices and edges; the earliest contact wins
+    const glm::vec3 vertices[3] = { v0, v1, v2 };
+    const glm::vec2 weights[3] = { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.0f, 1.0f) };
+    float dd = glm::dot(dir, dir);
+    float best = tMax;
+    glm::vec2 bestWeights(0.0f);
+    bool found = false;
+    for (int i = 0; i < 3; i++)
+    {
+        // relative to the center where it passes closest to the vertex, which is perpendicular to dir
+        float offset = dd > 0.0f ? glm::dot(vertices[i] - origin, dir) / dd : 0.0f;
+        glm::vec3 rel = origin + offset * dir - vertices[i];
+        float tv;
+        if (smallestSweepRoot(dd, 0.0f, glm::dot(rel, rel) - radius * radius, offset, best, tv))
+        {
+            best = tv;
+            bestWeights = weights[i];
+            found = true;
+        }
+        // edge i -> i + 1 as an infinite cylinder, then keep the contact only if it lies on the segment; the
+        // cross products measure distances across the edge without the cancellation of the dot product forms
+        int j = (i + 1) % 3;
+        glm::vec3 edge = vertices[j] - vertices[i];
+        float ee = glm::dot(edge, edge);
+        glm::vec3 edgeDir = glm::cross(edge, dir);
+        glm::vec3 edgeRel = glm::cross(edge, rel);
+        float te;
+        if (smallestSweepRoot(glm::dot(edgeDir, edgeDir), 2.0f * glm::dot(edgeDir, edgeRel), glm::dot(edgeRel, edgeRel) - ee * radius * radius,
+                              offset, best, te))
+        {
+            float f = glm::dot(edge, rel + (te - offset) * dir) / ee;
+            if (f >= 0.0f && f <= 1.0f)
+            {
+                best = te;
+                bestWeights = (1.0f - f) * weights[i] + f * weights[j];
+                found = true;
+            }
+        }
+    }
+    if (!found)
+        return false;
+    t = best;
+    u = bestWeights.x;
+    v = bestWeights.y;
+    return true;
+}
+#endif
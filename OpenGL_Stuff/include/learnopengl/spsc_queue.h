@@ -0,0 +1,54 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+using namespace std;
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread. N must be a power of two; one
+// slot is always kept free to tell a full ring from an empty one. The producer only writes tail and the consumer
+// only writes head, so each side needs a single acquire load of the other's index and a release store of its own.
+template <typename T, unsigned int N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // producer side; returns false if the ring is full
+    bool TryPush(const T& item)
+    {
+        unsigned int t = tail.load(memory_order_relaxed);
+        unsigned int next = (t + 1) & (N - 1);
+        if (next == head.load(memory_order_acquire))
+            return false;
+        items[t] = item;
+        tail.store(next, memory_order_release);
+        return true;
+    }
+
+    // consumer side; returns false if the ring is empty. The item is moved out, so a slot doesn't keep what it
+    // owned (e.g. a shared_ptr) alive until it is reused.
+    bool TryPop(T& item)
+    {
+        unsigned int h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire))
+            return false;
+        item = std::move(items[h]);
+        head.store((h + 1) & (N - 1), memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+    }
+
+private:
+    // the indices live on separate cache lines so producer and consumer don't invalidate each other's line
+    alignas(64) atomic<unsigned int> head;
+    alignas(64) atomic<unsigned int> tail;
+    alignas(64) T items[N];
+};
+#endif
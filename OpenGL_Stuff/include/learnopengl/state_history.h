@@ -0,0 +1,82 @@
+#ifndef STATE_HISTORY_H
+#define STATE_HISTORY_H
+
+#include <cstddef>
+using namespace std;
+
+// Fixed size ring buffer of timestamped states, oldest samples are overwritten. Used to rewind the camera and the
+// targets to the moment an input event happened. A sample pushed with cut = true starts a discontinuity (e.g. a
+// teleport): the state before it is held up to its time instead of being blended into it.
+template <typename T, unsigned int N>
+class StateHistory {
+public:
+    struct Sample {
+        double Time;
+        T State;
+        bool Cut;
+    };
+
+    StateHistory() : head(0), count(0) {}
+
+    // samples are kept in time order: a time older than the newest sample is clamped to it
+    void Push(double time, const T& state, bool cut = false)
+    {
+        if (count > 0 && time < samples[head].Time)
+            time = samples[head].Time;
+        head = (head + 1) % N;
+        samples[head].Time = time;
+        samples[head].State = state;
+        samples[head].Cut = cut;
+        if (count < N)
+            count++;
+    }
+
+    // i = 0 is the newest sample
+    const Sample& Get(unsigned int i) const
+    {
+        return samples[(head + N - i) % N];
+    }
+
+    unsigned int Size() const
+    {
+        return count;
+    }
+
+    void Clear()
+    {
+        count = 0;
+    }
+
+    // state at the given time: blended with lerp(a, b, f) between the samples around it, clamped to the oldest and
+    // newest samples outside the recorded range. Returns false if nothing was recorded yet.
+    template <typename Lerp>
+    bool At(double time, T& state, Lerp lerp) const
+    {
+        if (count == 0)
+            return false;
+        // walk back from the newest sample; rewinds are usually short
+        unsigned int i = 0;
+        while (i + 1 < count && Get(i).Time > time)
+            i++;
+        const Sample& before = Get(i);
+        if (i == 0 || before.Time > time)
+        {
+            state = before.State;
+            return true;
+        }
+        const Sample& after = Get(i - 1);
+        if (after.Cut || after.Time <= before.Time)
+        {
+            state = before.State;
+            return true;
+        }
+        state = lerp(before.State, after.State, (float)((time - before.Time) / (after.Time - before.Time)));
+        return true;
+    }
+
+private:
+    Sample samples[N];
+    unsigned int head;
+    unsigned int count;
+};
+#endif
@@ -0,0 +1,370 @@
+#ifndef TARGET_GRID_H
+#define TARGET_GRID_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bvh.h>
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+using namespace std;
+
+// Uniform grid broadphase for many moving objects (the targets). Each object is referenced from every cell its
+// world space box overlaps; a ray walks the cells it crosses front to back (3D DDA) and only objects whose box
+// it hits reach the narrow phase. Moving an object only touches the cells it leaves and enters, so updates are
+// O(cells covered) and the cost of a shot depends on the cells crossed, not on the number of objects.
+// Objects that stick out of the grid bounds are kept in a separate list that every query tests.
+class TargetGrid {
+public:
+    static const unsigned int NONE = 0xffffffffu;
+
+    TargetGrid() : cellSize(1.0f), invCellSize(1.0f), resolution(0), queryStamp(0) {}
+
+    TargetGrid(const AABB& area, float cellSize)
+    {
+        Init(area, cellSize);
+    }
+
+    // sets the covered area and drops all objects
+    void Init(const AABB& area, float size)
+    {
+        bounds = area;
+        cellSize = size;
+        invCellSize = 1.0f / size;
+        glm::vec3 extent = area.max - area.min;
+        resolution = glm::max(glm::ivec3(1), glm::ivec3(glm::ceil(extent * invCellSize)));
+        bounds.max = bounds.min + glm::vec3(resolution) * cellSize;
+        cells.assign((size_t)resolution.x * resolution.y * resolution.z, vector<unsigned int>());
+        entries.clear();
+        outside.clear();
+        stamps.clear();
+        queryStamp = 0;
+    }
+
+    // adds (or re-adds) object id with the given world space box
+    void Insert(unsigned int id, const AABB& box)
+    {
+        if (id >= entries.size())
+        {
+            entries.resize(id + 1);
+            stamps.resize(id + 1, 0);
+        }
+        Entry& e = entries[id];
+        if (e.Active)
+            Remove(id);
+        e.Bounds = box;
+        e.Active = true;
+        e.Outside = !contains(box);
+        cellRange(box, e.CellMin, e.CellMax);
+        if (e.Outside)
+            outside.push_back(id);
+        else
+            link(id, e.CellMin, e.CellMax);
+    }
+
+    // moves an object; cells are only relinked if the box now overlaps a different set of cells
+    void Update(unsigned int id, const AABB& box)
+    {
+        if (id >= entries.size() || !entries[id].Active)
+        {
+            Insert(id, box);
+            return;
+        }
+        Entry& e = entries[id];
+        glm::ivec3 cellMin, cellMax;
+        cellRange(box, cellMin, cellMax);
+        bool outsideNow = !contains(box);
+        if (outsideNow == e.Outside && cellMin == e.CellMin && cellMax == e.CellMax)
+        {
+            e.Bounds = box;
+            return;
+        }
+        Insert(id, box);
+    }
+
+    void Remove(unsigned int id)
+    {
+        if (id >= entries.size() || !entries[id].Active)
+            return;
+        Entry& e = entries[id];
+        if (e.Outside)
+            eraseFrom(outside, id);
+        else
+            unlink(id, e.CellMin, e.CellMax);
+        e.Active = false;
+    }
+
+    size_t Size() const
+    {
+        return entries.size();
+    }
+
+    // Closest hit along a ray. narrowPhase(id, tMax) is called for every object whose box the ray hits closer than
+    // the current tMax and returns the distance of its hit (or FLT_MAX); the grid keeps the nearest one and stops
+    // walking once it is inside the current cell. Returns the id of the hit object and lowers tMax, or NONE.
+    // The mailbox stamps are scratch state, so one grid must not be queried from two threads at the same time.
+    template <typename NarrowPhase>
+    unsigned int IntersectClosest(const glm::vec3& origin, const glm::vec3& dir, float& tMax, NarrowPhase narrowPhase) const
+    {
+        return SweepClosest(origin, dir, 0.0f, tMax, narrowPhase);
+    }
+
+    // Same query for a sphere of the given radius swept along the ray. Object boxes are grown by the radius, and
+    // in every cell the ray crosses, the cells overlapping that piece of the ray grown by the radius are tested,
+    // so only objects the sphere can reach get to the narrow phase.
+    template <typename NarrowPhase>
+    unsigned int SweepClosest(const glm::vec3& origin, const glm::vec3& dir, float radius, float& tMax, NarrowPhase narrowPhase) const
+    {
+        // mailbox: an object overlapping several cells is only tested once per query
+        if (++queryStamp == 0)
+        {
+            fill(stamps.begin(), stamps.end(), 0);
+            queryStamp = 1;
+        }
+        glm::vec3 invDir = 1.0f / dir;
+        glm::vec3 grow(radius);
+        unsigned int best = NONE;
+        for (unsigned int i = 0; i < outside.size(); i++)
+            test(outside[i], origin, invDir, grow, tMax, best, narrowPhase);
+
+        Walk walk;
+        if (cells.empty() || !start(walk, origin, dir, radius, tMax))
+            return best;
+        float pieceStart = walk.Enter;
+        while (true)
+        {
+            float cellExit = walk.CellExit();
+            if (radius <= 0.0f)
+            {
+                const vector<unsigned int>& cellEntries = cells[cellIndex(walk.Cell)];
+                for (unsigned int i = 0; i < cellEntries.size(); i++)
+                    test(cellEntries[i], origin, invDir, grow, tMax, best, narrowPhase);
+            }
+            else
+            {
+                float pieceEnd = glm::min(glm::min(cellExit, walk.Exit), tMax);
+                AABB piece;
+                piece.Grow(origin + pieceStart * dir);
+                piece.Grow(origin + pieceEnd * dir);
+                glm::ivec3 cellMin, cellMax;
+                cellRange(AABB(piece.min - grow, piece.max + grow), cellMin, cellMax);
+                for (int z = cellMin.z; z <= cellMax.z; z++)
+                    for (int y = cellMin.y; y <= cellMax.y; y++)
+                        for (int x = cellMin.x; x <= cellMax.x; x++)
+                        {
+                            const vector<unsigned int>& cellEntries = cells[cellIndex(glm::ivec3(x, y, z))];
+                            for (unsigned int i = 0; i < cellEntries.size(); i++)
+                                test(cellEntries[i], origin, invDir, grow, tMax, best, narrowPhase);
+                        }
+                pieceStart = cellExit;
+            }
+
+            // a hit before the far side of this cell can't be beaten by objects in later cells
+            if (!advance(walk, radius, tMax))
+                break;
+        }
+        return best;
+    }
+
+    // A ray's front to back walk through the cells, one cell at a time, for queries that interleave the walks of
+    // several rays (the pellets of a shot) and decide themselves how far each ray still needs to go. There is no
+    // mailbox: an object overlapping several cells is reported for each of them, so the caller skips repeats.
+    struct Walk {
+        glm::vec3 Origin, InvDir;
+        glm::ivec3 Cell, Step;
+        glm::vec3 TNext, TDelta;
+        float Enter;    // where the ray enters the current cell; boxes reported later start no nearer
+        float Exit;     // where it leaves the grid
+        bool Done;
+
+        float CellExit() const
+        {
+            return glm::min(glm::min(TNext.x, TNext.y), TNext.z);
+        }
+    };
+
+    // starts a walk and reports, through visit(id, tEnter), the objects outside the grid whose boxes the ray hits
+    // closer than tMax
+    template <typename Visit>
+    void BeginWalk(Walk& walk, const glm::vec3& origin, const glm::vec3& dir, float tMax, Visit visit) const
+    {
+        walk.Done = cells.empty() || !start(walk, origin, dir, 0.0f, tMax);
+        walk.Origin = origin;
+        walk.InvDir = 1.0f / dir;
+        for (unsigned int i = 0; i < outside.size(); i++)
+            report(outside[i], walk, tMax, visit);
+    }
+
+    // reports the objects of the walk's current cell whose boxes the ray hits closer than tMax, then moves to the
+    // next cell. Done is set once the ray leaves the grid or the next cell starts beyond tMax.
+    template <typename Visit>
+    void StepWalk(Walk& walk, float tMax, Visit visit) const
+    {
+        if (walk.Done)
+            return;
+        const vector<unsigned int>& cellEntries = cells[cellIndex(walk.Cell)];
+        for (unsigned int i = 0; i < cellEntries.size(); i++)
+            report(cellEntries[i], walk, tMax, visit);
+        walk.Done = !advance(walk, 0.0f, tMax);
+    }
+
+private:
+    struct Entry {
+        AABB Bounds;
+        glm::ivec3 CellMin;
+        glm::ivec3 CellMax;
+        bool Active;
+        bool Outside;
+
+        Entry() : CellMin(0), CellMax(-1), Active(false), Outside(false) {}
+    };
+
+    AABB bounds;
+    float cellSize;
+    float invCellSize;
+    glm::ivec3 resolution;
+    vector<vector<unsigned int> > cells;
+    vector<Entry> entries;
+    vector<unsigned int> outside;
+    mutable vector<unsigned int> stamps;
+    mutable unsigned int queryStamp;
+
+    template <typename NarrowPhase>
+    void test(unsigned int id, const glm::vec3& origin, const glm::vec3& invDir, const glm::vec3& grow, float& tMax, unsigned int& best,
+              NarrowPhase& narrowPhase) const
+    {
+        if (stamps[id] == queryStamp)
+            return;
+        stamps[id] = queryStamp;
+        const Entry& e = entries[id];
+        if (IntersectRayAABB(origin, invDir, e.Bounds.min - grow, e.Bounds.max + grow, tMax) == FLT_MAX)
+            return;
+        float t = narrowPhase(id, tMax);
+        if (t < tMax)
+        {
+            tMax = t;
+            best = id;
+        }
+    }
+
+    template <typename Visit>
+    void report(unsigned int id, const Walk& walk, float tMax, Visit& visit) const
+    {
+        const Entry& e = entries[id];
+        float tEnter = IntersectRayAABB(walk.Origin, walk.InvDir, e.Bounds.min, e.Bounds.max, tMax);
+        if (tEnter != FLT_MAX)
+            visit(id, tEnter);
+    }
+
+    // Amanatides & Woo: start in the cell where the ray enters the grid (grown by radius) and step across the
+    // nearest face. A sweep may enter up to radius outside the grid, so its walk is not clamped to the grid's
+    // cells. Returns false if the ray misses the grid before tMax.
+    bool start(Walk& walk, const glm::vec3& origin, const glm::vec3& dir, float radius, float tMax) const
+    {
+        glm::vec3 invDir = 1.0f / dir;
+        glm::vec3 grow(radius);
+        glm::vec3 t0 = (bounds.min - grow - origin) * invDir;
+        glm::vec3 t1 = (bounds.max + grow - origin) * invDir;
+        glm::vec3 tSmall = glm::min(t0, t1);
+        glm::vec3 tBig = glm::max(t0, t1);
+        walk.Enter = glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f));
+        walk.Exit = glm::min(glm::min(tBig.x, tBig.y), tBig.z);
+        if (walk.Enter > walk.Exit || walk.Enter > tMax)
+            return false;
+
+        glm::vec3 p = origin + walk.Enter * dir;
+        walk.Cell = glm::ivec3(glm::floor((p - bounds.min) * invCellSize));
+        if (radius <= 0.0f)
+            walk.Cell = glm::clamp(walk.Cell, glm::ivec3(0), resolution - 1);
+        for (int a = 0; a < 3; a++)
+        {
+            if (dir[a] > 0.0f)
+            {
+                walk.Step[a] = 1;
+                walk.TNext[a] = (bounds.min[a] + (walk.Cell[a] + 1) * cellSize - origin[a]) * invDir[a];
+                walk.TDelta[a] = cellSize * invDir[a];
+            }
+            else if (dir[a] < 0.0f)
+            {
+                walk.Step[a] = -1;
+                walk.TNext[a] = (bounds.min[a] + walk.Cell[a] * cellSize - origin[a]) * invDir[a];
+                walk.TDelta[a] = -cellSize * invDir[a];
+            }
+            else
+            {
+                walk.Step[a] = 0;
+                walk.TNext[a] = FLT_MAX;
+                walk.TDelta[a] = FLT_MAX;
+            }
+        }
+        return true;
+    }
+
+    // moves the walk across the nearest face of its cell; false once the cell's far side is beyond tMax or the
+    // grid's exit, or a ray steps out of the grid
+    bool advance(Walk& walk, float radius, float tMax) const
+    {
+        int axis = 0;
+        if (walk.TNext.y < walk.TNext[axis])
+            axis = 1;
+        if (walk.TNext.z < walk.TNext[axis])
+            axis = 2;
+        float cellExit = walk.TNext[axis];
+        if (cellExit >= tMax || cellExit > walk.Exit)
+            return false;
+        walk.Cell[axis] += walk.Step[axis];
+        if (radius <= 0.0f && (walk.Cell[axis] < 0 || walk.Cell[axis] >= resolution[axis]))
+            return false;
+        walk.TNext[axis] += walk.TDelta[axis];
+        walk.Enter = cellExit;
+        return true;
+    }
+
+    bool contains(const AABB& box) const
+    {
+        return glm::all(glm::greaterThanEqual(box.min, bounds.min)) && glm::all(glm::lessThanEqual(box.max, bounds.max));
+    }
+
+    void cellRange(const AABB& box, glm::ivec3& cellMin, glm::ivec3& cellMax) const
+    {
+        cellMin = glm::clamp(glm::ivec3(glm::floor((box.min - bounds.min) * invCellSize)), glm::ivec3(0), resolution - 1);
+        cellMax = glm::clamp(glm::ivec3(glm::floor((box.max - bounds.min) * invCellSize)), glm::ivec3(0), resolution - 1);
+    }
+
+    size_t cellIndex(const glm::ivec3& c) const
+    {
+        return ((size_t)c.z * resolution.y + c.y) * resolution.x + c.x;
+    }
+
+    void link(unsigned int id, const glm::ivec3& cellMin, const glm::ivec3& cellMax)
+    {
+        for (int z = cellMin.z; z <= cellMax.z; z++)
+            for (int y = cellMin.y; y <= cellMax.y; y++)
+                for (int x = cellMin.x; x <= cellMax.x; x++)
+                    cells[cellIndex(glm::ivec3(x, y, z))].push_back(id);
+    }
+
+    void unlink(unsigned int id, const glm::ivec3& cellMin, const glm::ivec3& cellMax)
+    {
+        for (int z = cellMin.z; z <= cellMax.z; z++)
+            for (int y = cellMin.y; y <= cellMax.y; y++)
+                for (int x = cellMin.x; x <= cellMax.x; x++)
+                    eraseFrom(cells[cellIndex(glm::ivec3(x, y, z))], id);
+    }
+
+    // order inside a cell doesn't matter, so removal swaps with the last element
+    static void eraseFrom(vector<unsigned int>& list, unsigned int id)
+    {
+        for (unsigned int i = 0; i < list.size(); i++)
+        {
+            if (list[i] == id)
+            {
+                list[i] = list.back();
+                list.pop_back();
+                return;
+            }
+        }
+    }
+};
+#endif
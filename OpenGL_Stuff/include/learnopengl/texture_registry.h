@@ -0,0 +1,236 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/coverage_mask.h>
+#include <learnopengl/texture_streamer.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+using namespace std;
+
+// defined in model.h
+bool DecodeImage(const char *path, const string &directory, DecodedImage &image, CoverageMask* coverage, float alphaCutoff);
+unsigned int UploadTexture(DecodedImage &image);
+
+// one image shared by every model whose texture file has the same contents, whatever the file is called
+struct SharedTexture {
+    uint64_t Hash;              // of the file contents (hashFileContents)
+    size_t Size;                // file size in bytes
+    string Path;                // first file found with these contents
+    unsigned int Id;            // GL texture, 0 until the first Upload
+    bool Decoded;
+    DecodedImage Image;         // pixels between decoding and the first Upload
+    vector<shared_ptr<CoverageMask> > Masks;  // one per alpha cutoff asked for, empty ones included
+    int References;             // Acquire calls not released yet
+    mutex Guard;                // held while decoding and uploading
+};
+
+// 64 bit hash of a file's bytes, eight at a time; equal hashes are confirmed by comparing the bytes
+inline uint64_t hashFileContents(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull ^ size;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t word;
+        memcpy(&word, data + i * 8, 8);
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    for (size_t i = words * 8; i < size; i++)
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Process wide set of the textures the models use, keyed by the contents of the image files so an image found at
+// several paths, or used by several models, is decoded once and lives in VRAM once. Loader threads Acquire (the
+// lookup is a hash of the file, then a hash table probe); the GL thread uploads and releases. Entries are
+// reference counted: the last Release deletes the GL texture. A texture must not be released while the streamer
+// is still filling it.
+class TextureRegistry {
+public:
+    TextureRegistry() {}
+
+    // The texture for the image file directory/path, decoded now unless a file with the same contents was acquired
+    // before (a concurrent Acquire of the same contents waits for that decode instead of repeating it). With cutoff
+    // >= 0, coverage gets the image's coverage mask for that cutoff, or null if no texel is transparent. Makes no GL
+    // calls; every Acquire needs a Release.
+    shared_ptr<SharedTexture> Acquire(const string& path, const string& directory, float cutoff, shared_ptr<CoverageMask>& coverage)
+    {
+        shared_ptr<SharedTexture> texture = find(directory + '/' + path);
+        lock_guard<mutex> lock(texture->Guard);
+        if (!texture->Decoded)
+        {
+            DecodeImage(path.c_str(), directory, texture->Image, NULL, 0.0f);
+            texture->Decoded = true;
+        }
+        coverage.reset();
+        if (cutoff >= 0.0f)
+            coverage = mask(*texture, cutoff);
+        return texture;
+    }
+
+    // GL thread: the texture's GL name. The first call creates it from the decoded pixels, through the streamer if
+    // one is given (see Model::Upload), and the pixels are freed.
+    unsigned int Upload(SharedTexture& texture, TextureStreamer* streamer)
+    {
+        lock_guard<mutex> lock(texture.Guard);
+        if (texture.Id == 0)
+            texture.Id = streamer ? streamer->Submit(texture.Image) : UploadTexture(texture.Image);
+        return texture.Id;
+    }
+
+    // Calls use(image) with the texture's decoded pixels, under its lock, while they are still held: between
+    // Acquire and the first Upload, and only if the GPU doesn't get a block compressed copy instead. Returns
+    // whether it did, so callers that need the pixels anyway can decode the file themselves.
+    template <typename Use>
+    bool Read(SharedTexture& texture, Use use)
+    {
+        lock_guard<mutex> lock(texture.Guard);
+        if (!texture.Image.Data)
+            return false;
+        use((const DecodedImage&)texture.Image);
+        return true;
+    }
+
+    // GL thread: drops one reference; the last one deletes the GL texture and forgets the contents
+    void Release(const shared_ptr<SharedTexture>& texture)
+    {
+        lock_guard<mutex> lock(guard);
+        if (--texture->References > 0)
+            return;
+        if (texture->Id != 0)
+            glDeleteTextures(1, &texture->Id);
+        texture->Id = 0;
+        if (texture->Image.Data)
+            stbi_image_free(texture->Image.Data);
+        texture->Image.Data = NULL;
+        texture->Image.Compressed.reset();
+        unordered_map<uint64_t, vector<shared_ptr<SharedTexture> > >::iterator bucket = textures.find(texture->Hash);
+        if (bucket == textures.end())
+            return;
+        for (size_t i = 0; i < bucket->second.size(); i++)
+            if (bucket->second[i] == texture)
+            {
+                bucket->second.erase(bucket->second.begin() + i);
+                break;
+            }
+        if (bucket->second.empty())
+            textures.erase(bucket);
+    }
+
+    // distinct images held
+    size_t Size()
+    {
+        lock_guard<mutex> lock(guard);
+        size_t count = 0;
+        for (unordered_map<uint64_t, vector<shared_ptr<SharedTexture> > >::const_iterator i = textures.begin(); i != textures.end(); ++i)
+            count += i->second.size();
+        return count;
+    }
+
+private:
+    unordered_map<uint64_t, vector<shared_ptr<SharedTexture> > > textures;  // by contents hash; collisions share a bucket
+    mutex guard;
+
+    TextureRegistry(const TextureRegistry&);
+    TextureRegistry& operator=(const TextureRegistry&);
+
+    // the entry for the file's contents with one more reference, added if they are new. Files that can't be read
+    // get an entry of their own that is not shared; decoding them reports the error like before. The bytes of an
+    // entry with the same hash and size are compared without holding the lock, then the lock is taken again to
+    // take the reference; an entry released meanwhile, or added by another thread, sends the search round again.
+    shared_ptr<SharedTexture> find(const string& fullPath)
+    {
+        MappedFile file;
+        if (!file.Open(fullPath))
+            return create(0, 0, fullPath);
+        uint64_t hash = hashFileContents(file.Data(), file.Size());
+
+        vector<shared_ptr<SharedTexture> > different;
+        while (true)
+        {
+            shared_ptr<SharedTexture> candidate;
+            {
+                lock_guard<mutex> lock(guard);
+                vector<shared_ptr<SharedTexture> >& bucket = textures[hash];
+                for (size_t i = 0; i < bucket.size() && !candidate; i++)
+                    if (bucket[i]->Size == file.Size() && std::find(different.begin(), different.end(), bucket[i]) == different.end())
+                        candidate = bucket[i];
+                if (!candidate)
+                {
+                    shared_ptr<SharedTexture> texture = create(hash, file.Size(), fullPath);
+                    bucket.push_back(texture);
+                    return texture;
+                }
+            }
+            if (sameContents(candidate->Path, file))
+            {
+                lock_guard<mutex> lock(guard);
+                if (candidate->References > 0)
+                {
+                    candidate->References++;
+                    return candidate;
+                }
+            }
+            different.push_back(candidate);
+        }
+    }
+
+    static shared_ptr<SharedTexture> create(uint64_t hash, size_t size, const string& fullPath)
+    {
+        shared_ptr<SharedTexture> texture = make_shared<SharedTexture>();
+        texture->Hash = hash;
+        texture->Size = size;
+        texture->Path = fullPath;
+        texture->Id = 0;
+        texture->Decoded = false;
+        texture->Image.Data = NULL;
+        texture->References = 1;
+        return texture;
+    }
+
+    static bool sameContents(const string& path, const MappedFile& file)
+    {
+        MappedFile other;
+        return other.Open(path) && other.Size() == file.Size() && memcmp(other.Data(), file.Data(), file.Size()) == 0;
+    }
+
+    // the coverage mask for cutoff, built on first use from the decoded pixels. Once they are uploaded and freed,
+    // or if the GPU gets a block compressed copy instead, the file is decoded again only for the mask.
+    static shared_ptr<CoverageMask> mask(SharedTexture& texture, float cutoff)
+    {
+        for (size_t i = 0; i < texture.Masks.size(); i++)
+            if (texture.Masks[i]->Cutoff == cutoff)
+                return texture.Masks[i]->Empty() ? shared_ptr<CoverageMask>() : texture.Masks[i];
+        shared_ptr<CoverageMask> built = make_shared<CoverageMask>();
+        built->Cutoff = cutoff;
+        if (texture.Image.Data)
+            built->Build(texture.Image.Data, texture.Image.Width, texture.Image.Height, texture.Image.Components, cutoff);
+        else if (texture.Id != 0 || texture.Image.Compressed)
+        {
+            DecodedImage image;
+            if (DecodeImage(texture.Path.c_str(), ".", image, built.get(), cutoff))
+                stbi_image_free(image.Data);
+        }
+        texture.Masks.push_back(built);
+        return built->Empty() ? shared_ptr<CoverageMask>() : built;
+    }
+};
+
+// the registry every Model loads its textures through
+inline TextureRegistry& SharedTextures()
+{
+    static TextureRegistry registry;
+    return registry;
+}
+#endif
@@ -0,0 +1,239 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/stb_image.h>
+#include <learnopengl/ktx2.h>
+
+#include <deque>
+#include <memory>
+#include <cstring>
+using namespace std;
+
+// pixels of an image file decoded on a loader thread, kept until its texture is created on the GL thread
+struct DecodedImage {
+    unsigned char* Data;    // from stbi_load, NULL if the file could not be read or Compressed stands for it
+    int Width;
+    int Height;
+    int Components;
+    shared_ptr<Ktx2Texture> Compressed;  // block compressed copy with its mip chain, if one is up to date (see ktx2.h)
+};
+
+// Creates textures from decoded images without stalling a frame. Submit hands out the final texture name at once:
+// its mip chain is allocated (immutable glTexStorage2D storage on GL 4.2+) and only the 1x1 last level is filled,
+// with the image's average color, and made the base level, so the texture can be bound right away as a placeholder.
+// Update, once per frame, copies a budget of rows into a ring of pixel unpack buffers (persistently mapped on GL
+// 4.4+) and uploads them from there; a ring slot is reused only after the fence behind its upload has signalled.
+// Once level 0 is complete the mipmaps are generated, and when that fence signals the base level goes back to 0.
+// Update never waits for the GPU: if the next slot is still in use it returns and tries again next frame.
+class TextureStreamer {
+public:
+    static const int SLOTS = 4;
+    static const size_t SLOT_BYTES = 4 << 20;  // one band of rows; a 2048x2048 RGB image takes 3 of them
+
+    TextureStreamer() : buffer(0), mapped(NULL), persistent(false), immutable(false), next(0)
+    {
+        for (int i = 0; i < SLOTS; i++)
+            fences[i] = 0;
+    }
+
+    // needs a current GL context
+    void Init()
+    {
+        immutable = GLAD_GL_VERSION_4_2 != 0;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        if (GLAD_GL_VERSION_4_4)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, SLOTS * SLOT_BYTES, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SLOTS * SLOT_BYTES, flags);
+            persistent = mapped != NULL;
+        }
+        if (!persistent)
+        {
+            // storage made with glBufferStorage can't be respecified; start over with a plain buffer
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, SLOTS * SLOT_BYTES, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // takes over the image's pixels (image.Data is NULL afterwards) and returns the texture, showing the average
+    // color until it is streamed in. An image that failed to decode still gets a texture name, with no storage.
+    // Block compressed images are a quarter of the size or less and come with their mipmaps: they go in at once.
+    unsigned int Submit(DecodedImage& image)
+    {
+        if (image.Compressed)
+        {
+            unsigned int texture = UploadKtx2(*image.Compressed);
+            image.Compressed.reset();
+            return texture;
+        }
+
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        if (!image.Data)
+            return texture;
+
+        Job job;
+        job.Texture = texture;
+        job.Image = image;
+        job.Row = 0;
+        const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+        const GLenum internalFormats[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+        int format = glm::clamp(image.Components, 1, 4) - 1;
+        job.Format = formats[format];
+        GLenum internalFormat = internalFormats[format];
+        job.Levels = 1;
+        while ((glm::max(image.Width, image.Height) >> job.Levels) > 0)
+            job.Levels++;
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (immutable)
+            glTexStorage2D(GL_TEXTURE_2D, job.Levels, internalFormat, image.Width, image.Height);
+        else
+            for (int level = 0; level < job.Levels; level++)
+                glTexImage2D(GL_TEXTURE_2D, level, internalFormat, glm::max(image.Width >> level, 1), glm::max(image.Height >> level, 1), 0,
+                             job.Format, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.Levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, job.Levels - 1);
+
+        unsigned char average[4];
+        averageColor(image, average);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, job.Levels - 1, 0, 0, 1, 1, job.Format, GL_UNSIGNED_BYTE, average);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        jobs.push_back(job);
+        image.Data = NULL;
+        return texture;
+    }
+
+    // once per frame: switches finished textures to their full mip chain and uploads up to budget bytes of rows
+    void Update(size_t budget = 2 * SLOT_BYTES)
+    {
+        while (!finishing.empty() && signalled(finishing.front().Fence))
+        {
+            glBindTexture(GL_TEXTURE_2D, finishing.front().Texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+            glDeleteSync(finishing.front().Fence);
+            finishing.pop_front();
+        }
+
+        size_t sent = 0;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        while (!jobs.empty() && sent < budget)
+        {
+            if (fences[next])
+            {
+                if (!signalled(fences[next]))
+                    break;
+                glDeleteSync(fences[next]);
+                fences[next] = 0;
+            }
+
+            // the next band of rows goes through slot `next`
+            Job& job = jobs.front();
+            size_t rowBytes = (size_t)job.Image.Width * job.Image.Components;
+            int rows = glm::min(job.Image.Height - job.Row, glm::max((int)(SLOT_BYTES / rowBytes), 1));
+            size_t bytes = rows * rowBytes;
+            size_t offset = next * SLOT_BYTES;
+            unsigned char* slot = persistent ? mapped + offset
+                                             : (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, bytes,
+                                                                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (!slot)
+                break;
+            memcpy(slot, job.Image.Data + job.Row * rowBytes, bytes);
+            if (!persistent)
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindTexture(GL_TEXTURE_2D, job.Texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.Row, job.Image.Width, rows, job.Format, GL_UNSIGNED_BYTE, (void*)offset);
+            fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            next = (next + 1) % SLOTS;
+            sent += bytes;
+            job.Row += rows;
+
+            if (job.Row == job.Image.Height)
+            {
+                // level 0 is complete; the mipmaps are generated from it, the placeholder stays the base meanwhile
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.Levels - 1);
+                Finishing done = { job.Texture, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+                finishing.push_back(done);
+                stbi_image_free(job.Image.Data);
+                jobs.pop_front();
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        // a fence that never reaches the GPU never signals; the flush only submits, it does not wait
+        if (sent > 0)
+            glFlush();
+    }
+
+    // true once every submitted texture shows its own pixels
+    bool Idle() const
+    {
+        return jobs.empty() && finishing.empty();
+    }
+
+private:
+    struct Job {
+        GLuint Texture;
+        DecodedImage Image;
+        GLenum Format;
+        int Levels;
+        int Row;  // first row of level 0 not uploaded yet
+    };
+    struct Finishing {
+        GLuint Texture;
+        GLsync Fence;  // behind the mipmap generation
+    };
+
+    GLuint buffer;
+    unsigned char* mapped;  // whole ring, when persistently mapped
+    bool persistent;
+    bool immutable;
+    GLsync fences[SLOTS];  // behind the last upload from each slot, 0 if the slot is free
+    int next;              // slot the next band goes through
+    deque<Job> jobs;       // textures still uploading level 0, in submission order
+    deque<Finishing> finishing;
+
+    static bool signalled(GLsync fence)
+    {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+
+    // mean of up to 32x32 evenly spaced texels; enough for a placeholder
+    static void averageColor(const DecodedImage& image, unsigned char* average)
+    {
+        unsigned int sums[4] = { 0, 0, 0, 0 };
+        int stepX = glm::max(image.Width / 32, 1), stepY = glm::max(image.Height / 32, 1);
+        unsigned int samples = 0;
+        for (int y = 0; y < image.Height; y += stepY)
+            for (int x = 0; x < image.Width; x += stepX)
+            {
+                const unsigned char* texel = image.Data + ((size_t)y * image.Width + x) * image.Components;
+                for (int c = 0; c < image.Components; c++)
+                    sums[c] += texel[c];
+                samples++;
+            }
+        for (int c = 0; c < image.Components; c++)
+            average[c] = (unsigned char)(sums[c] / samples);
+    }
+};
+#endif
@@ -0,0 +1,89 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Fixed set of worker threads running queued tasks in submission order, for load time work such as model import.
+// Unlike QueryWorker this one blocks: idle workers sleep on a condition variable and Wait() is the barrier the
+// submitting thread uses before touching the results. Tasks must not use the GL context.
+class ThreadPool {
+public:
+    // threads = 0 picks one per hardware thread (4 if the count is unknown)
+    explicit ThreadPool(unsigned int threads = 0) : busy(0), stopping(false)
+    {
+        if (threads == 0)
+            threads = thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 4;
+        for (unsigned int i = 0; i < threads; i++)
+            workers.push_back(std::thread(&ThreadPool::run, this));
+    }
+
+    // finishes the queued tasks, then joins the workers
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(guard);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    void Submit(function<void()> task)
+    {
+        {
+            lock_guard<mutex> lock(guard);
+            tasks.push_back(task);
+        }
+        wake.notify_one();
+    }
+
+    // blocks until every submitted task has finished; what the tasks wrote is visible to the caller afterwards
+    void Wait()
+    {
+        unique_lock<mutex> lock(guard);
+        done.wait(lock, [this]() { return tasks.empty() && busy == 0; });
+    }
+
+private:
+    vector<std::thread> workers;
+    deque<function<void()> > tasks;
+    unsigned int busy;  // tasks taken from the queue and still running
+    bool stopping;
+    mutex guard;
+    condition_variable wake;
+    condition_variable done;
+
+    void run()
+    {
+        unique_lock<mutex> lock(guard);
+        while (true)
+        {
+            wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            function<void()> task = tasks.front();
+            tasks.pop_front();
+            busy++;
+            lock.unlock();
+            task();
+            lock.lock();
+            if (--busy == 0 && tasks.empty())
+                done.notify_all();
+        }
+    }
+};
+#endif
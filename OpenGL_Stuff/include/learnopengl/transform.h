@@ -0,0 +1,120 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+using namespace std;
+
+// world matrix of an object together with the matrices derived from it. The inverse and the normal matrix are
+// only recomputed when the world matrix changed (Dirty), so neither the ray queries nor the vertex shader have
+// to invert anything per vertex.
+struct ObjectTransform {
+    glm::mat4 World;
+    glm::mat4 InverseWorld;
+    glm::mat3 Normal;
+    bool Dirty;
+
+    ObjectTransform(const glm::mat4& world = glm::mat4(1.0f)) : World(world), Dirty(true)
+    {
+        Refresh();
+    }
+
+    void Set(const glm::mat4& world)
+    {
+        World = world;
+        Dirty = true;
+    }
+
+    // recomputes the derived matrices if the world matrix changed since the last refresh
+    void Refresh()
+    {
+        if (!Dirty)
+            return;
+        InverseWorld = glm::inverse(World);
+        Normal = glm::mat3(glm::transpose(InverseWorld));
+        Dirty = false;
+    }
+
+    glm::vec3 Position() const
+    {
+        return glm::vec3(World[3]);
+    }
+
+    // moves a world space ray into model space; directions are not normalized so the ray parameter t is
+    // the same in both spaces.
+    glm::vec3 ToLocalPoint(const glm::vec3& p) const
+    {
+        return glm::vec3(InverseWorld * glm::vec4(p, 1.0f));
+    }
+
+    glm::vec3 ToLocalDirection(const glm::vec3& d) const
+    {
+        return glm::vec3(InverseWorld * glm::vec4(d, 0.0f));
+    }
+
+    // a world space length (e.g. the radius of a swept sphere) in model units; assumes a uniform scale
+    float ToLocalLength(float length) const
+    {
+        return length * glm::length(glm::vec3(InverseWorld[0]));
+    }
+};
+
+// blends two world matrices made of translation, rotation and (positive) scale: translation and scale are
+// interpolated linearly and rotation with a quaternion slerp, so the result stays a rigid transform.
+inline glm::mat4 InterpolateTransform(const glm::mat4& a, const glm::mat4& b, float f)
+{
+    glm::vec3 scaleA(glm::length(glm::vec3(a[0])), glm::length(glm::vec3(a[1])), glm::length(glm::vec3(a[2])));
+    glm::vec3 scaleB(glm::length(glm::vec3(b[0])), glm::length(glm::vec3(b[1])), glm::length(glm::vec3(b[2])));
+    glm::quat rotA = glm::quat_cast(glm::mat3(glm::vec3(a[0]) / scaleA.x, glm::vec3(a[1]) / scaleA.y, glm::vec3(a[2]) / scaleA.z));
+    glm::quat rotB = glm::quat_cast(glm::mat3(glm::vec3(b[0]) / scaleB.x, glm::vec3(b[1]) / scaleB.y, glm::vec3(b[2]) / scaleB.z));
+
+    glm::mat4 m = glm::mat4_cast(glm::slerp(rotA, rotB, f));
+    glm::vec3 scale = glm::mix(scaleA, scaleB, f);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    m[3] = glm::vec4(glm::mix(glm::vec3(a[3]), glm::vec3(b[3]), f), 1.0f);
+    return m;
+}
+
+// stores the transforms of every object in the scene, addressed by the id returned from Add.
+class TransformCache {
+public:
+    unsigned int Add(const glm::mat4& world = glm::mat4(1.0f))
+    {
+        transforms.push_back(ObjectTransform(world));
+        return (unsigned int)(transforms.size() - 1);
+    }
+
+    // replaces the world matrix of an object and marks it dirty
+    void Set(unsigned int id, const glm::mat4& world)
+    {
+        transforms[id].Set(world);
+    }
+
+    // returns the transform of an object with up to date inverse and normal matrices
+    const ObjectTransform& Get(unsigned int id)
+    {
+        transforms[id].Refresh();
+        return transforms[id];
+    }
+
+    // refreshes every dirty transform, e.g. once per frame before the scene is queried
+    void Refresh()
+    {
+        for (unsigned int i = 0; i < transforms.size(); i++)
+            transforms[i].Refresh();
+    }
+
+    size_t Size() const
+    {
+        return transforms.size();
+    }
+
+private:
+    vector<ObjectTransform> transforms;
+};
+#endif
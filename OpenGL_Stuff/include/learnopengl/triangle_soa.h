@@ -0,0 +1,905 @@
+#ifndef TRIANGLE_SOA_H
+#define TRIANGLE_SOA_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/sphere_sweep.h>
+
+#include <vector>
+#include <memory>
+#include <cfloat>
+using namespace std;
+
+// pick the widest kernel the compiler was allowed to use. /arch:AVX2 (MSVC) or -mavx2 (gcc/clang) selects the
+// 8-wide path, /arch:AVX or SSE4.1 the 4-wide one; everything else falls back to scalar code. There is no runtime
+// CPU check, so the game builds with /arch:AVX, which every x64 CPU it targets has. Define TRIANGLE_SOA_SCALAR to
+// force the scalar kernel, e.g. to compare results.
+// Triangles are tested with the watertight test of Woop, Benthin and Wald (TRIANGLE_SOA_WATERTIGHT): rays can't
+// slip between triangles that share an edge, where Möller–Trumbore with its epsilon lost about 12% of the rays
+// aimed at them. It costs 1.6-2.5x the per triangle work of Möller–Trumbore on precomputed edges, still well under
+// the old per call intersectRayTriangle. Define TRIANGLE_SOA_MOLLER_TRUMBORE to get that kernel back for comparisons.
+#if !defined(TRIANGLE_SOA_MOLLER_TRUMBORE) && !defined(TRIANGLE_SOA_WATERTIGHT)
+#define TRIANGLE_SOA_WATERTIGHT
+#endif
+#if !defined(TRIANGLE_SOA_SCALAR) && defined(__AVX2__)
+#define TRIANGLE_SOA_AVX2
+#define TRIANGLE_SOA_SIMD
+#include <immintrin.h>
+#elif !defined(TRIANGLE_SOA_SCALAR) && (defined(__SSE4_1__) || defined(__AVX__))
+#define TRIANGLE_SOA_SSE4
+#define TRIANGLE_SOA_SIMD
+#include <smmintrin.h>
+#endif
+
+// thin wrappers so the AVX2 and SSE4.1 paths share the same kernels
+#if defined(TRIANGLE_SOA_AVX2)
+typedef __m256 SimdFloat;
+inline SimdFloat simdSet(float x) { return _mm256_set1_ps(x); }
+inline SimdFloat simdLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void simdStore(float* p, SimdFloat a) { _mm256_storeu_ps(p, a); }
+inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a, b); }
+inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a, b); }
+inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+inline SimdFloat simdDiv(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a, b); }
+inline SimdFloat simdSqrt(SimdFloat a) { return _mm256_sqrt_ps(a); }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a, b); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a, b); }
+inline SimdFloat simdAnd(SimdFloat a, SimdFloat b) { return _mm256_and_ps(a, b); }
+inline SimdFloat simdOr(SimdFloat a, SimdFloat b) { return _mm256_or_ps(a, b); }
+inline SimdFloat simdXor(SimdFloat a, SimdFloat b) { return _mm256_xor_ps(a, b); }
+inline SimdFloat simdEqual(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline SimdFloat simdLessEqual(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b, a, mask); }
+inline unsigned int simdMask(SimdFloat a) { return (unsigned int)_mm256_movemask_ps(a); }
+#elif defined(TRIANGLE_SOA_SSE4)
+typedef __m128 SimdFloat;
+inline SimdFloat simdSet(float x) { return _mm_set1_ps(x); }
+inline SimdFloat simdLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void simdStore(float* p, SimdFloat a) { _mm_storeu_ps(p, a); }
+inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+inline SimdFloat simdDiv(SimdFloat a, SimdFloat b) { return _mm_div_ps(a, b); }
+inline SimdFloat simdSqrt(SimdFloat a) { return _mm_sqrt_ps(a); }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm_min_ps(a, b); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm_max_ps(a, b); }
+inline SimdFloat simdAnd(SimdFloat a, SimdFloat b) { return _mm_and_ps(a, b); }
+inline SimdFloat simdOr(SimdFloat a, SimdFloat b) { return _mm_or_ps(a, b); }
+inline SimdFloat simdXor(SimdFloat a, SimdFloat b) { return _mm_xor_ps(a, b); }
+inline SimdFloat simdEqual(SimdFloat a, SimdFloat b) { return _mm_cmpeq_ps(a, b); }
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a, b); }
+inline SimdFloat simdLessEqual(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a, b); }
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm_blendv_ps(b, a, mask); }
+inline unsigned int simdMask(SimdFloat a) { return (unsigned int)_mm_movemask_ps(a); }
+#endif
+
+#if defined(TRIANGLE_SOA_SIMD)
+// Möller–Trumbore on one register of (ray, triangle) pairs. Any operand can be a broadcast, so the same kernel
+// tests one ray against several triangles or several rays against one triangle. Operation order and epsilon
+// follow intersectRayTriangle() so both give the same answers. Returns the lane mask of hits in (EPSILON, tMax).
+inline SimdFloat simdIntersectRayTriangle(SimdFloat ox, SimdFloat oy, SimdFloat oz, SimdFloat dx, SimdFloat dy, SimdFloat dz,
+                                          SimdFloat px, SimdFloat py, SimdFloat pz, SimdFloat ax, SimdFloat ay, SimdFloat az,
+                                          SimdFloat bx, SimdFloat by, SimdFloat bz, SimdFloat tMax, SimdFloat& t, SimdFloat& u, SimdFloat& v)
+{
+    const SimdFloat eps = simdSet(0.0000001f);
+    const SimdFloat negEps = simdSet(-0.0000001f);
+    const SimdFloat zero = simdSet(0.0f);
+    const SimdFloat one = simdSet(1.0f);
+    // h = cross(dir, edge2)
+    SimdFloat hx = simdSub(simdMul(dy, bz), simdMul(by, dz));
+    SimdFloat hy = simdSub(simdMul(dz, bx), simdMul(bz, dx));
+    SimdFloat hz = simdSub(simdMul(dx, by), simdMul(bx, dy));
+    SimdFloat a = simdAdd(simdAdd(simdMul(ax, hx), simdMul(ay, hy)), simdMul(az, hz));
+    SimdFloat valid = simdOr(simdLessEqual(a, negEps), simdLessEqual(eps, a));
+    SimdFloat f = simdDiv(one, a);
+    // s = origin - v0
+    SimdFloat sx = simdSub(ox, px);
+    SimdFloat sy = simdSub(oy, py);
+    SimdFloat sz = simdSub(oz, pz);
+    u = simdMul(f, simdAdd(simdAdd(simdMul(sx, hx), simdMul(sy, hy)), simdMul(sz, hz)));
+    valid = simdAnd(valid, simdAnd(simdLessEqual(zero, u), simdLessEqual(u, one)));
+    // q = cross(s, edge1)
+    SimdFloat qx = simdSub(simdMul(sy, az), simdMul(ay, sz));
+    SimdFloat qy = simdSub(simdMul(sz, ax), simdMul(az, sx));
+    SimdFloat qz = simdSub(simdMul(sx, ay), simdMul(ax, sy));
+    v = simdMul(f, simdAdd(simdAdd(simdMul(dx, qx), simdMul(dy, qy)), simdMul(dz, qz)));
+    valid = simdAnd(valid, simdAnd(simdLessEqual(zero, v), simdLessEqual(simdAdd(u, v), one)));
+    t = simdMul(f, simdAdd(simdAdd(simdMul(bx, qx), simdMul(by, qy)), simdMul(bz, qz)));
+    return simdAnd(valid, simdAnd(simdLess(eps, t), simdLess(t, tMax)));
+}
+
+// watertight test (see WatertightRay) on one register of (ray, triangle) pairs, with the coordinates already
+// permuted: x, y, z are the ray's kx, ky, kz axes, o the origin and s the shear. As above any operand can be a
+// broadcast. Returns the lane mask of hits in (0, tMax); lanes the float kernel can't decide (the ray exactly on
+// an edge) are left out of it and flagged in exact, for the scalar test.
+inline SimdFloat simdIntersectWatertight(SimdFloat ox, SimdFloat oy, SimdFloat oz, SimdFloat sx, SimdFloat sy, SimdFloat sz,
+                                         const SimdFloat x[3], const SimdFloat y[3], const SimdFloat z[3], SimdFloat tMax,
+                                         SimdFloat& t, SimdFloat& u, SimdFloat& v, unsigned int& exact)
+{
+    SimdFloat px[3], py[3], pz[3];
+    for (int k = 0; k < 3; k++)
+    {
+        pz[k] = simdSub(z[k], oz);
+        px[k] = simdSub(simdSub(x[k], ox), simdMul(sx, pz[k]));
+        py[k] = simdSub(simdSub(y[k], oy), simdMul(sy, pz[k]));
+    }
+    SimdFloat U = simdSub(simdMul(px[2], py[1]), simdMul(py[2], px[1]));
+    SimdFloat V = simdSub(simdMul(px[0], py[2]), simdMul(py[0], px[2]));
+    SimdFloat W = simdSub(simdMul(px[1], py[0]), simdMul(py[1], px[0]));
+    const SimdFloat zero = simdSet(0.0f);
+    SimdFloat onEdge = simdOr(simdOr(simdEqual(U, zero), simdEqual(V, zero)), simdEqual(W, zero));
+    exact = simdMask(onEdge);
+    SimdFloat anyNegative = simdOr(simdOr(simdLess(U, zero), simdLess(V, zero)), simdLess(W, zero));
+    SimdFloat anyPositive = simdOr(simdOr(simdLess(zero, U), simdLess(zero, V)), simdLess(zero, W));
+    SimdFloat det = simdAdd(simdAdd(U, V), W);
+    SimdFloat T = simdMul(sz, simdAdd(simdAdd(simdMul(U, pz[0]), simdMul(V, pz[1])), simdMul(W, pz[2])));
+    // compare T against tMax * det with det's sign folded in, so no division is needed to reject
+    SimdFloat sign = simdAnd(det, simdSet(-0.0f));
+    SimdFloat absDet = simdXor(det, sign);
+    SimdFloat signedT = simdXor(T, sign);
+    SimdFloat valid = simdAnd(simdLess(zero, signedT), simdLess(signedT, simdMul(tMax, absDet)));
+    valid = simdAnd(valid, simdLess(zero, absDet));
+    // the ray passes outside if the edge values have mixed signs; a & ~b is written as a ^ (a & b)
+    valid = simdXor(valid, simdAnd(valid, simdAnd(anyNegative, anyPositive)));
+    valid = simdXor(valid, simdAnd(valid, onEdge));
+    // most batches miss, so the division is only paid when something was hit
+    if (simdMask(valid) == 0)
+    {
+        t = u = v = zero;
+        return valid;
+    }
+    SimdFloat rcpDet = simdDiv(simdSet(1.0f), det);
+    t = simdMul(T, rcpDet);
+    u = simdMul(V, rcpDet);
+    v = simdMul(W, rcpDet);
+    // rounding of T * rcpDet may still land on tMax
+    return simdAnd(valid, simdLess(t, tMax));
+}
+#endif
+
+// Ray set up for the watertight test: the axis along which the direction is largest becomes z and the other two
+// are sheared so the direction maps to +z. Triangles are then tested in 2D on the ray's own plane, and an edge
+// shared by two triangles gives bit-identical edge values for both, so a ray on the edge hits one of them.
+struct WatertightRay {
+    int kx, ky, kz;
+    float Sx, Sy, Sz;
+    float ox, oy, oz;     // origin, permuted
+
+    WatertightRay(const glm::vec3& origin, const glm::vec3& dir)
+    {
+        glm::vec3 a = glm::abs(dir);
+        kz = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        if (dir[kz] < 0.0f)
+            swap(kx, ky); // keeps the winding, so the sign of the edge values stays meaningful
+        Sx = dir[kx] / dir[kz];
+        Sy = dir[ky] / dir[kz];
+        Sz = 1.0f / dir[kz];
+        ox = origin[kx];
+        oy = origin[ky];
+        oz = origin[kz];
+    }
+};
+
+// up to RayPacket::SIZE rays in structure of arrays form, with the reciprocal directions for the slab tests
+struct RayPacket {
+    static const unsigned int SIZE = 16;
+
+    float ox[SIZE], oy[SIZE], oz[SIZE];
+    float dx[SIZE], dy[SIZE], dz[SIZE];
+    float idx[SIZE], idy[SIZE], idz[SIZE];
+    float tMax[SIZE];
+    unsigned int count;
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+    // the shear of each ray (WatertightRay::Sx, Sy, Sz). sameAxes tells whether every ray has the axes kx, ky, kz,
+    // as the pellets of a shot nearly always do; then the triangles are permuted once for the whole packet.
+    float sx[SIZE], sy[SIZE], sz[SIZE];
+    int kx, ky, kz;
+    bool sameAxes;
+#endif
+
+    // loads n <= SIZE rays; unused lanes get a ray that misses everything
+    void Set(const glm::vec3* origins, const glm::vec3* directions, const float* tMaxs, unsigned int n)
+    {
+        count = n;
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+        WatertightRay first(glm::vec3(0.0f), n > 0 ? directions[0] : glm::vec3(0.0f, 0.0f, 1.0f));
+        kx = first.kx;
+        ky = first.ky;
+        kz = first.kz;
+        sameAxes = true;
+#endif
+        for (unsigned int i = 0; i < SIZE; i++)
+        {
+            glm::vec3 o = i < n ? origins[i] : glm::vec3(0.0f);
+            glm::vec3 d = i < n ? directions[i] : glm::vec3(1.0f);
+            ox[i] = o.x; oy[i] = o.y; oz[i] = o.z;
+            dx[i] = d.x; dy[i] = d.y; dz[i] = d.z;
+            idx[i] = 1.0f / d.x; idy[i] = 1.0f / d.y; idz[i] = 1.0f / d.z;
+            tMax[i] = i < n ? tMaxs[i] : -1.0f;
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+            WatertightRay ray(o, i < n ? d : glm::vec3(0.0f, 0.0f, 1.0f));
+            sameAxes = sameAxes && (i >= n || (ray.kx == kx && ray.ky == ky && ray.kz == kz));
+            sx[i] = ray.Sx; sy[i] = ray.Sy; sz[i] = ray.Sz;
+#endif
+        }
+    }
+
+    unsigned int AllMask() const
+    {
+        return count >= 32 ? 0xffffffffu : (1u << count) - 1u;
+    }
+};
+
+// Structure of arrays copy of a mesh's triangles, stored in BVH order so every leaf is a contiguous range.
+// With Möller–Trumbore each triangle keeps v0 and the two edges already subtracted; the watertight test needs the
+// three vertices exactly as in the vertex buffer instead. Either way the SIMD kernels test several triangles per
+// iteration with plain aligned-stride loads.
+class TriangleSoA {
+public:
+#if defined(TRIANGLE_SOA_AVX2)
+    static const unsigned int WIDTH = 8;
+#elif defined(TRIANGLE_SOA_SSE4)
+    static const unsigned int WIDTH = 4;
+#else
+    static const unsigned int WIDTH = 1;
+#endif
+    // what the nine arrays hold; stored in the BVH cache so a file written by the other kernel is rebuilt
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+    static const unsigned int FORMAT = 1;   // v0, v1, v2
+#else
+    static const unsigned int FORMAT = 0;   // v0, edge1, edge2
+#endif
+
+    // the nine arrays are consecutive blocks of Stride() floats, either in storage or in memory owned by external
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+    const float *v0x, *v0y, *v0z;
+    const float *v1x, *v1y, *v1z;
+    const float *v2x, *v2y, *v2z;
+#else
+    const float *v0x, *v0y, *v0z;
+    const float *e1x, *e1y, *e1z;
+    const float *e2x, *e2y, *e2z;
+#endif
+    unsigned int count;
+
+    // a ray prepared once per leaf for the selected kernel
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+    typedef WatertightRay PreparedRay;
+#else
+    struct PreparedRay {
+        glm::vec3 origin;
+        glm::vec3 dir;
+
+        PreparedRay(const glm::vec3& o, const glm::vec3& d) : origin(o), dir(d) {}
+    };
+#endif
+
+    TriangleSoA() : count(0), external(NULL)
+    {
+        bind(NULL);
+    }
+
+    TriangleSoA(const TriangleSoA& other)
+    {
+        *this = other;
+    }
+
+    TriangleSoA& operator=(const TriangleSoA& other)
+    {
+        if (this == &other)
+            return *this;
+        storage = other.storage;
+        owner = other.owner;
+        count = other.count;
+        external = other.external;
+        bind(external ? external : (storage.empty() ? NULL : storage.data()));
+        return *this;
+    }
+
+    // uses count triangles laid out as by Build at data without copying them; owner keeps that memory alive
+    void View(const float* data, unsigned int n, const shared_ptr<const void>& dataOwner)
+    {
+        storage.clear();
+        storage.shrink_to_fit();
+        owner = dataOwner;
+        count = n;
+        external = data;
+        bind(data);
+    }
+
+    // padded length of each of the nine arrays
+    size_t Stride() const
+    {
+        return (size_t)count + PADDING;
+    }
+
+    // start of the nine arrays, e.g. to write them to a file
+    const float* Data() const
+    {
+        return v0x;
+    }
+
+    size_t DataFloats() const
+    {
+        return count == 0 ? 0 : Stride() * 9;
+    }
+
+    // order holds the triangle ids in the order they should be stored (BVH::triIndices)
+    template <typename VertexT>
+    void Build(const vector<VertexT>& vertices, const vector<unsigned int>& indices, const vector<unsigned int>& order)
+    {
+        owner.reset();
+        external = NULL;
+        count = (unsigned int)order.size();
+        // pad by one full register so a leaf at the end of the array can be loaded in one go; padding
+        // triangles are degenerate and never reported.
+        size_t stride = Stride();
+        storage.assign(stride * 9, 0.0f);
+        float* arrays[9];
+        for (int i = 0; i < 9; i++)
+            arrays[i] = &storage[stride * i];
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            unsigned int tri = order[i] * 3;
+            const glm::vec3& p0 = vertices[indices[tri]].Position;
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+            // the vertices are copied untouched: shared edges must stay bit-identical between neighbours
+            glm::vec3 second = vertices[indices[tri + 1]].Position;
+            glm::vec3 third = vertices[indices[tri + 2]].Position;
+#else
+            glm::vec3 second = vertices[indices[tri + 1]].Position - p0;
+            glm::vec3 third = vertices[indices[tri + 2]].Position - p0;
+#endif
+            arrays[0][i] = p0.x;     arrays[1][i] = p0.y;     arrays[2][i] = p0.z;
+            arrays[3][i] = second.x; arrays[4][i] = second.y; arrays[5][i] = second.z;
+            arrays[6][i] = third.x;  arrays[7][i] = third.y;  arrays[8][i] = third.z;
+        }
+        bind(storage.data());
+    }
+
+    // the three vertices of stored triangle i, whichever FORMAT the arrays use
+    void Vertices(unsigned int i, glm::vec3& a, glm::vec3& b, glm::vec3& c) const
+    {
+        a = glm::vec3(v0x[i], v0y[i], v0z[i]);
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+        b = glm::vec3(v1x[i], v1y[i], v1z[i]);
+        c = glm::vec3(v2x[i], v2y[i], v2z[i]);
+#else
+        b = a + glm::vec3(e1x[i], e1y[i], e1z[i]);
+        c = a + glm::vec3(e2x[i], e2y[i], e2z[i]);
+#endif
+    }
+
+    // heap memory used; a view of external data owns none
+    size_t MemoryBytes() const
+    {
+        return storage.capacity() * sizeof(float);
+    }
+
+    // tests triangles [first, first + n) and returns true if any of them is hit closer than tMax
+    bool IntersectAny(const glm::vec3& origin, const glm::vec3& dir, unsigned int first, unsigned int n, float tMax) const
+    {
+        PreparedRay ray(origin, dir);
+#if defined(TRIANGLE_SOA_SIMD)
+        SimdRay simdRay(ray);
+        SimdFloat tm = simdSet(tMax);
+        for (unsigned int i = 0; i < n; i += WIDTH)
+        {
+            unsigned int j = first + i;
+            unsigned int lanes = n - i < WIDTH ? n - i : WIDTH;
+            unsigned int exact = 0;
+            SimdFloat t, u, v;
+            SimdFloat hit = intersectBatch(simdRay, j, tm, t, u, v, exact);
+            if (simdMask(hit) & ((1u << lanes) - 1u))
+                return true;
+            exact &= (1u << lanes) - 1u;
+            for (unsigned int k = 0; exact != 0; k++, exact >>= 1)
+            {
+                float tk, uk, vk;
+                if ((exact & 1u) && IntersectOne(ray, j + k, tk, uk, vk) && tk < tMax)
+                    return true;
+            }
+        }
+        return false;
+#else
+        for (unsigned int i = 0; i < n; i++)
+        {
+            float t, u, v;
+            if (IntersectOne(ray, first + i, t, u, v) && t < tMax)
+                return true;
+        }
+        return false;
+#endif
+    }
+
+    // finds the closest of triangles [first, first + n) hit nearer than tMax. On a hit tMax is lowered to the hit
+    // distance, and index (position in the SoA arrays) and the barycentrics u, v are updated.
+    bool IntersectClosest(const glm::vec3& origin, const glm::vec3& dir, unsigned int first, unsigned int n, float& tMax, unsigned int& index, float& u, float& v) const
+    {
+        PreparedRay ray(origin, dir);
+        bool found = false;
+#if defined(TRIANGLE_SOA_SIMD)
+        SimdRay simdRay(ray);
+        for (unsigned int i = 0; i < n; i += WIDTH)
+        {
+            unsigned int j = first + i;
+            unsigned int lanes = n - i < WIDTH ? n - i : WIDTH;
+            unsigned int exact = 0;
+            SimdFloat t, bu, bv;
+            SimdFloat hit = intersectBatch(simdRay, j, simdSet(tMax), t, bu, bv, exact);
+            unsigned int mask = simdMask(hit) & ((1u << lanes) - 1u);
+            exact &= (1u << lanes) - 1u;
+            if (mask == 0 && exact == 0)
+                continue;
+            float ts[WIDTH], us[WIDTH], vs[WIDTH];
+            simdStore(ts, t);
+            simdStore(us, bu);
+            simdStore(vs, bv);
+            for (unsigned int k = 0; k < lanes; k++)
+            {
+                // lanes the kernel couldn't decide get the exact scalar test
+                if ((exact & (1u << k)) && IntersectOne(ray, j + k, ts[k], us[k], vs[k]))
+                    mask |= 1u << k;
+                if ((mask & (1u << k)) && ts[k] < tMax)
+                {
+                    tMax = ts[k];
+                    index = j + k;
+                    u = us[k];
+                    v = vs[k];
+                    found = true;
+                }
+            }
+        }
+#else
+        for (unsigned int i = 0; i < n; i++)
+        {
+            float t, bu, bv;
+            if (IntersectOne(ray, first + i, t, bu, bv) && t < tMax)
+            {
+                tMax = t;
+                index = first + i;
+                u = bu;
+                v = bv;
+                found = true;
+            }
+        }
+#endif
+        return found;
+    }
+
+    // closest of triangles [first, first + n) touched by a sphere of the given radius swept along the ray, same
+    // contract as IntersectClosest. The exact test is scalar, so a register of triangles is culled first: the
+    // sphere can't touch a triangle before it is within radius of both the triangle's box and its plane. The
+    // later of those two distances bounds the contact from below, so a triangle is skipped as soon as a closer
+    // hit is known.
+    bool SweepSphere(const glm::vec3& origin, const glm::vec3& dir, float radius, unsigned int first, unsigned int n, float& tMax,
+                     unsigned int& index, float& u, float& v) const
+    {
+        bool found = false;
+#if defined(TRIANGLE_SOA_SIMD)
+        SweepRay ray(origin, dir, radius);
+        for (unsigned int i = 0; i < n; i += WIDTH)
+        {
+            unsigned int j = first + i;
+            unsigned int lanes = n - i < WIDTH ? n - i : WIDTH;
+            float bound[WIDTH];
+            unsigned int mask = sweepBound(ray, j, tMax, bound) & ((1u << lanes) - 1u);
+            for (unsigned int k = 0; mask != 0; k++, mask >>= 1)
+            {
+                if ((mask & 1u) && bound[k] < tMax)
+                    found |= sweepOne(origin, dir, radius, j + k, tMax, index, u, v);
+            }
+        }
+#else
+        glm::vec3 invDir = 1.0f / dir;
+        glm::vec3 grow(radius);
+        for (unsigned int i = first; i < first + n; i++)
+        {
+            glm::vec3 a, b, c;
+            Vertices(i, a, b, c);
+            glm::vec3 t0 = (glm::min(a, glm::min(b, c)) - grow - origin) * invDir;
+            glm::vec3 t1 = (glm::max(a, glm::max(b, c)) + grow - origin) * invDir;
+            glm::vec3 tSmall = glm::min(t0, t1), tBig = glm::max(t0, t1);
+            if (glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f)) > glm::min(glm::min(tBig.x, tBig.y), glm::min(tBig.z, tMax)))
+                continue;
+            found |= sweepOne(origin, dir, radius, i, tMax, index, u, v);
+        }
+#endif
+        return found;
+    }
+
+    // reports every triangle of [first, first + n) hit closer than tMax through onHit(index, t, u, v), which returns
+    // the distance beyond which no more hits are wanted (tMax, or less once the caller has all it needs).
+    // Returns the last such distance.
+    template <typename OnHit>
+    float IntersectAll(const glm::vec3& origin, const glm::vec3& dir, unsigned int first, unsigned int n, float tMax, OnHit& onHit) const
+    {
+        PreparedRay ray(origin, dir);
+#if defined(TRIANGLE_SOA_SIMD)
+        SimdRay simdRay(ray);
+        for (unsigned int i = 0; i < n; i += WIDTH)
+        {
+            unsigned int j = first + i;
+            unsigned int lanes = n - i < WIDTH ? n - i : WIDTH;
+            unsigned int exact = 0;
+            SimdFloat t, bu, bv;
+            SimdFloat hit = intersectBatch(simdRay, j, simdSet(tMax), t, bu, bv, exact);
+            unsigned int mask = simdMask(hit) & ((1u << lanes) - 1u);
+            exact &= (1u << lanes) - 1u;
+            if (mask == 0 && exact == 0)
+                continue;
+            float ts[WIDTH], us[WIDTH], vs[WIDTH];
+            simdStore(ts, t);
+            simdStore(us, bu);
+            simdStore(vs, bv);
+            for (unsigned int k = 0; k < lanes; k++)
+            {
+                if ((exact & (1u << k)) && IntersectOne(ray, j + k, ts[k], us[k], vs[k]))
+                    mask |= 1u << k;
+                if ((mask & (1u << k)) && ts[k] < tMax)
+                    tMax = onHit(j + k, ts[k], us[k], vs[k]);
+            }
+        }
+#else
+        for (unsigned int i = 0; i < n; i++)
+        {
+            float t, u, v;
+            if (IntersectOne(ray, first + i, t, u, v) && t < tMax)
+                tMax = onHit(first + i, t, u, v);
+        }
+#endif
+        return tMax;
+    }
+
+    // tests the rays of a packet selected by mask against triangles [first, first + n), with the rays in the SIMD
+    // lanes so every triangle is loaded once for the whole packet. Returns the mask of rays that hit.
+    // The watertight test permutes the triangles by the rays' axes, so it only runs packets whose rays all share
+    // them (RayPacket::sameAxes) that way; any other packet goes one ray at a time.
+    unsigned int IntersectAny(const RayPacket& packet, unsigned int mask, unsigned int first, unsigned int n) const
+    {
+        unsigned int hits = 0;
+        auto onHit = [&](unsigned int ray, unsigned int, float, float, float) {
+            hits |= 1u << ray;
+            return true;
+        };
+        packetHits(packet, mask, first, n, onHit);
+        return hits;
+    }
+
+    // closest hit version of the packet test: every ray selected by mask that hits one of triangles
+    // [first, first + n) closer than its packet.tMax gets it lowered to the hit distance, and index, u and v
+    // (indexed by ray) updated like IntersectClosest. Returns the mask of rays that found a closer hit.
+    unsigned int IntersectClosest(RayPacket& packet, unsigned int mask, unsigned int first, unsigned int n, unsigned int* index, float* u,
+                                  float* v) const
+    {
+        unsigned int hits = 0;
+        auto onHit = [&](unsigned int ray, unsigned int j, float t, float bu, float bv) {
+            if (t < packet.tMax[ray])
+            {
+                packet.tMax[ray] = t;
+                index[ray] = j;
+                u[ray] = bu;
+                v[ray] = bv;
+                hits |= 1u << ray;
+            }
+            return false;
+        };
+        packetHits(packet, mask, first, n, onHit);
+        return hits;
+    }
+
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+    // scalar watertight test on one stored triangle. u, v are the weights of the second and third vertex, as with
+    // Möller–Trumbore.
+    bool IntersectOne(const WatertightRay& ray, unsigned int i, float& t, float& u, float& v) const
+    {
+        const float* const x[3] = { v0x, v1x, v2x };
+        const float* const y[3] = { v0y, v1y, v2y };
+        const float* const z[3] = { v0z, v1z, v2z };
+        float p[3][3];
+        for (int k = 0; k < 3; k++)
+        {
+            float c[3] = { x[k][i], y[k][i], z[k][i] };
+            float pz = c[ray.kz] - ray.oz;
+            p[k][0] = c[ray.kx] - ray.ox - ray.Sx * pz;
+            p[k][1] = c[ray.ky] - ray.oy - ray.Sy * pz;
+            p[k][2] = pz;
+        }
+        // edge functions; each only depends on the two vertices of its edge
+        float U = p[2][0] * p[1][1] - p[2][1] * p[1][0];
+        float V = p[0][0] * p[2][1] - p[0][1] * p[2][0];
+        float W = p[1][0] * p[0][1] - p[1][1] * p[0][0];
+        if (U == 0.0f || V == 0.0f || W == 0.0f)
+        {
+            // the ray runs through an edge or vertex in float precision; the products are exact in double
+            U = (float)((double)p[2][0] * p[1][1] - (double)p[2][1] * p[1][0]);
+            V = (float)((double)p[0][0] * p[2][1] - (double)p[0][1] * p[2][0]);
+            W = (float)((double)p[1][0] * p[0][1] - (double)p[1][1] * p[0][0]);
+        }
+        if ((U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f))
+            return false;
+        float det = U + V + W;
+        if (det == 0.0f)
+            return false;
+        float T = ray.Sz * (U * p[0][2] + V * p[1][2] + W * p[2][2]);
+        float rcpDet = 1.0f / det;
+        t = T * rcpDet;
+        u = V * rcpDet;
+        v = W * rcpDet;
+        return t > 0.0f;
+    }
+#else
+    // scalar Möller–Trumbore on one stored triangle; matches intersectRayTriangle() on the original vertices
+    bool IntersectOne(const PreparedRay& ray, unsigned int i, float& t, float& u, float& v) const
+    {
+        const float EPSILON = 0.0000001f;
+        glm::vec3 edge1(e1x[i], e1y[i], e1z[i]);
+        glm::vec3 edge2(e2x[i], e2y[i], e2z[i]);
+        glm::vec3 h = glm::cross(ray.dir, edge2);
+        float a = glm::dot(edge1, h);
+        if (a > -EPSILON && a < EPSILON)
+            return false;
+        float f = 1.0f / a;
+        glm::vec3 s = ray.origin - glm::vec3(v0x[i], v0y[i], v0z[i]);
+        u = f * glm::dot(s, h);
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, edge1);
+        v = f * glm::dot(ray.dir, q);
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        t = f * glm::dot(edge2, q);
+        return t > EPSILON;
+    }
+#endif
+
+    static const unsigned int PADDING = 8;
+
+private:
+    vector<float> storage;
+    shared_ptr<const void> owner;
+    const float* external;
+
+    // exact sweep against stored triangle i; lowers tMax and records the hit like IntersectClosest
+    bool sweepOne(const glm::vec3& origin, const glm::vec3& dir, float radius, unsigned int i, float& tMax, unsigned int& index, float& u,
+                  float& v) const
+    {
+        glm::vec3 a, b, c;
+        Vertices(i, a, b, c);
+        float t, bu, bv;
+        if (!SweepSphereTriangle(origin, dir, radius, a, b, c, tMax, t, bu, bv))
+            return false;
+        tMax = t;
+        index = i;
+        u = bu;
+        v = bv;
+        return true;
+    }
+
+#if defined(TRIANGLE_SOA_SIMD)
+    // a swept sphere broadcast to every lane
+    struct SweepRay {
+        SimdFloat ox, oy, oz, dx, dy, dz, ix, iy, iz, radius;
+
+        SweepRay(const glm::vec3& origin, const glm::vec3& dir, float r)
+        {
+            ox = simdSet(origin.x); oy = simdSet(origin.y); oz = simdSet(origin.z);
+            dx = simdSet(dir.x); dy = simdSet(dir.y); dz = simdSet(dir.z);
+            ix = simdSet(1.0f / dir.x); iy = simdSet(1.0f / dir.y); iz = simdSet(1.0f / dir.z);
+            radius = simdSet(r);
+        }
+    };
+
+    // narrows [tEnter, tExit] to the slab of a register of boxes along one axis
+    static void sweepSlab(SimdFloat lo, SimdFloat hi, SimdFloat origin, SimdFloat invDir, SimdFloat& tEnter, SimdFloat& tExit)
+    {
+        SimdFloat t0 = simdMul(simdSub(lo, origin), invDir);
+        SimdFloat t1 = simdMul(simdSub(hi, origin), invDir);
+        tEnter = simdMax(tEnter, simdMin(t0, t1));
+        tExit = simdMin(tExit, simdMax(t0, t1));
+    }
+
+    // lower bound of the contact distance of the sphere with each triangle of the register at j, from the
+    // triangles' boxes and planes grown by the radius. Returns the mask of triangles it may touch before tMax.
+    unsigned int sweepBound(const SweepRay& ray, unsigned int j, float tMax, float bound[WIDTH]) const
+    {
+        SimdFloat ax = simdLoad(&v0x[j]), ay = simdLoad(&v0y[j]), az = simdLoad(&v0z[j]);
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+        SimdFloat bx = simdLoad(&v1x[j]), by = simdLoad(&v1y[j]), bz = simdLoad(&v1z[j]);
+        SimdFloat cx = simdLoad(&v2x[j]), cy = simdLoad(&v2y[j]), cz = simdLoad(&v2z[j]);
+        SimdFloat edge1x = simdSub(bx, ax), edge1y = simdSub(by, ay), edge1z = simdSub(bz, az);
+        SimdFloat edge2x = simdSub(cx, ax), edge2y = simdSub(cy, ay), edge2z = simdSub(cz, az);
+#else
+        SimdFloat edge1x = simdLoad(&e1x[j]), edge1y = simdLoad(&e1y[j]), edge1z = simdLoad(&e1z[j]);
+        SimdFloat edge2x = simdLoad(&e2x[j]), edge2y = simdLoad(&e2y[j]), edge2z = simdLoad(&e2z[j]);
+        SimdFloat bx = simdAdd(ax, edge1x), by = simdAdd(ay, edge1y), bz = simdAdd(az, edge1z);
+        SimdFloat cx = simdAdd(ax, edge2x), cy = simdAdd(ay, edge2y), cz = simdAdd(az, edge2z);
+#endif
+        SimdFloat tEnter = simdSet(0.0f);
+        SimdFloat tExit = simdSet(tMax);
+        sweepSlab(simdSub(simdMin(ax, simdMin(bx, cx)), ray.radius), simdAdd(simdMax(ax, simdMax(bx, cx)), ray.radius), ray.ox, ray.ix, tEnter, tExit);
+        sweepSlab(simdSub(simdMin(ay, simdMin(by, cy)), ray.radius), simdAdd(simdMax(ay, simdMax(by, cy)), ray.radius), ray.oy, ray.iy, tEnter, tExit);
+        sweepSlab(simdSub(simdMin(az, simdMin(bz, cz)), ray.radius), simdAdd(simdMax(az, simdMax(bz, cz)), ray.radius), ray.oz, ray.iz, tEnter, tExit);
+
+        // the plane: the center's signed distance dist0 + t * speed, with the unnormalized normal, must reach
+        // radius * |normal|
+        SimdFloat nx = simdSub(simdMul(edge1y, edge2z), simdMul(edge1z, edge2y));
+        SimdFloat ny = simdSub(simdMul(edge1z, edge2x), simdMul(edge1x, edge2z));
+        SimdFloat nz = simdSub(simdMul(edge1x, edge2y), simdMul(edge1y, edge2x));
+        SimdFloat reach = simdMul(ray.radius, simdSqrt(simdAdd(simdAdd(simdMul(nx, nx), simdMul(ny, ny)), simdMul(nz, nz))));
+        SimdFloat dist0 = simdAdd(simdAdd(simdMul(nx, simdSub(ray.ox, ax)), simdMul(ny, simdSub(ray.oy, ay))), simdMul(nz, simdSub(ray.oz, az)));
+        SimdFloat speed = simdAdd(simdAdd(simdMul(nx, ray.dx), simdMul(ny, ray.dy)), simdMul(nz, ray.dz));
+        SimdFloat t0 = simdDiv(simdSub(reach, dist0), speed);
+        SimdFloat t1 = simdDiv(simdSub(simdSet(0.0f), simdAdd(reach, dist0)), speed);
+        // moving parallel to the plane the division gives infinities or NaN: keep the box interval if the
+        // sphere starts within reach, which SweepSphereTriangle decides exactly
+        SimdFloat parallel = simdEqual(speed, simdSet(0.0f));
+        tEnter = simdSelect(parallel, tEnter, simdMax(tEnter, simdMin(t0, t1)));
+        tExit = simdSelect(parallel, tExit, simdMin(tExit, simdMax(t0, t1)));
+        simdStore(bound, tEnter);
+        return simdMask(simdLessEqual(tEnter, tExit));
+    }
+
+    // a prepared ray broadcast to every lane
+    struct SimdRay {
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+        int kx, ky, kz;
+        SimdFloat ox, oy, oz, sx, sy, sz;
+
+        SimdRay(const WatertightRay& ray) : kx(ray.kx), ky(ray.ky), kz(ray.kz)
+        {
+            ox = simdSet(ray.ox); oy = simdSet(ray.oy); oz = simdSet(ray.oz);
+            sx = simdSet(ray.Sx); sy = simdSet(ray.Sy); sz = simdSet(ray.Sz);
+        }
+#else
+        SimdFloat ox, oy, oz, dx, dy, dz;
+
+        SimdRay(const PreparedRay& ray)
+        {
+            ox = simdSet(ray.origin.x); oy = simdSet(ray.origin.y); oz = simdSet(ray.origin.z);
+            dx = simdSet(ray.dir.x); dy = simdSet(ray.dir.y); dz = simdSet(ray.dir.z);
+        }
+#endif
+    };
+
+    // tests one register of triangles starting at j and returns the lane mask of hits in (0, tMax). Lanes the
+    // float kernel can't decide (watertight test exactly on an edge) are left out of it and flagged in exact.
+    SimdFloat intersectBatch(const SimdRay& ray, unsigned int j, SimdFloat tMax, SimdFloat& t, SimdFloat& u, SimdFloat& v, unsigned int& exact) const
+    {
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+        const float* const coords[3][3] = { { v0x, v0y, v0z }, { v1x, v1y, v1z }, { v2x, v2y, v2z } };
+        SimdFloat x[3], y[3], z[3];
+        for (int k = 0; k < 3; k++)
+        {
+            x[k] = simdLoad(&coords[k][ray.kx][j]);
+            y[k] = simdLoad(&coords[k][ray.ky][j]);
+            z[k] = simdLoad(&coords[k][ray.kz][j]);
+        }
+        return simdIntersectWatertight(ray.ox, ray.oy, ray.oz, ray.sx, ray.sy, ray.sz, x, y, z, tMax, t, u, v, exact);
+#else
+        exact = 0;
+        return simdIntersectRayTriangle(ray.ox, ray.oy, ray.oz, ray.dx, ray.dy, ray.dz,
+                                        simdLoad(&v0x[j]), simdLoad(&v0y[j]), simdLoad(&v0z[j]),
+                                        simdLoad(&e1x[j]), simdLoad(&e1y[j]), simdLoad(&e1z[j]),
+                                        simdLoad(&e2x[j]), simdLoad(&e2y[j]), simdLoad(&e2z[j]), tMax, t, u, v);
+#endif
+    }
+#endif
+
+    // reports the hits of the rays of a packet selected by mask on triangles [first, first + n), closer than each
+    // ray's packet.tMax, through onHit(ray, index, t, u, v); onHit returns true when the ray needs no more hits.
+    // packet.tMax is read again for every triangle, so onHit may lower it.
+    template <typename OnHit>
+    void packetHits(const RayPacket& packet, unsigned int mask, unsigned int first, unsigned int n, OnHit& onHit) const
+    {
+#if defined(TRIANGLE_SOA_SIMD)
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+        if (packet.sameAxes)
+        {
+            // each triangle is permuted once and broadcast, the rays' own origins and shears fill the lanes
+            const float* const coords[3][3] = { { v0x, v0y, v0z }, { v1x, v1y, v1z }, { v2x, v2y, v2z } };
+            const float* const origins[3] = { packet.ox, packet.oy, packet.oz };
+            for (unsigned int i = 0; i < n && mask != 0; i++)
+            {
+                unsigned int j = first + i;
+                SimdFloat x[3], y[3], z[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    x[k] = simdSet(coords[k][packet.kx][j]);
+                    y[k] = simdSet(coords[k][packet.ky][j]);
+                    z[k] = simdSet(coords[k][packet.kz][j]);
+                }
+                for (unsigned int r = 0; r < packet.count; r += WIDTH)
+                {
+                    unsigned int lanes = (mask >> r) & ((1u << WIDTH) - 1u);
+                    if (lanes == 0)
+                        continue;
+                    unsigned int exact = 0;
+                    SimdFloat t, u, v;
+                    SimdFloat hit = simdIntersectWatertight(simdLoad(&origins[packet.kx][r]), simdLoad(&origins[packet.ky][r]),
+                                                            simdLoad(&origins[packet.kz][r]), simdLoad(&packet.sx[r]), simdLoad(&packet.sy[r]),
+                                                            simdLoad(&packet.sz[r]), x, y, z, simdLoad(&packet.tMax[r]), t, u, v, exact);
+                    reportLanes(packet, r, j, simdMask(hit) & lanes, exact & lanes, t, u, v, mask, onHit);
+                }
+            }
+            return;
+        }
+#else
+        for (unsigned int i = 0; i < n && mask != 0; i++)
+        {
+            unsigned int j = first + i;
+            SimdFloat px = simdSet(v0x[j]), py = simdSet(v0y[j]), pz = simdSet(v0z[j]);
+            SimdFloat ax = simdSet(e1x[j]), ay = simdSet(e1y[j]), az = simdSet(e1z[j]);
+            SimdFloat bx = simdSet(e2x[j]), by = simdSet(e2y[j]), bz = simdSet(e2z[j]);
+            for (unsigned int r = 0; r < packet.count; r += WIDTH)
+            {
+                unsigned int lanes = (mask >> r) & ((1u << WIDTH) - 1u);
+                if (lanes == 0)
+                    continue;
+                SimdFloat t, u, v;
+                SimdFloat hit = simdIntersectRayTriangle(simdLoad(&packet.ox[r]), simdLoad(&packet.oy[r]), simdLoad(&packet.oz[r]),
+                                                         simdLoad(&packet.dx[r]), simdLoad(&packet.dy[r]), simdLoad(&packet.dz[r]),
+                                                         px, py, pz, ax, ay, az, bx, by, bz, simdLoad(&packet.tMax[r]), t, u, v);
+                reportLanes(packet, r, j, simdMask(hit) & lanes, 0, t, u, v, mask, onHit);
+            }
+        }
+        return;
+#endif
+#endif
+        for (unsigned int r = 0; r < packet.count; r++)
+        {
+            if (!(mask & (1u << r)))
+                continue;
+            glm::vec3 origin(packet.ox[r], packet.oy[r], packet.oz[r]);
+            glm::vec3 dir(packet.dx[r], packet.dy[r], packet.dz[r]);
+            auto report = [&](unsigned int j, float t, float u, float v) {
+                return onHit(r, j, t, u, v) ? 0.0f : packet.tMax[r];
+            };
+            IntersectAll(origin, dir, first, n, packet.tMax[r], report);
+        }
+    }
+
+#if defined(TRIANGLE_SOA_SIMD)
+    // hands the lanes of one register of packet rays (starting at ray r) that hit triangle j to onHit, after the
+    // scalar test of the lanes the kernel couldn't decide; rays that are done leave mask
+    template <typename OnHit>
+    void reportLanes(const RayPacket& packet, unsigned int r, unsigned int j, unsigned int hits, unsigned int exact, SimdFloat t,
+                     SimdFloat u, SimdFloat v, unsigned int& mask, OnHit& onHit) const
+    {
+        if (hits == 0 && exact == 0)
+            return;
+        float ts[WIDTH], us[WIDTH], vs[WIDTH];
+        simdStore(ts, t);
+        simdStore(us, u);
+        simdStore(vs, v);
+        for (unsigned int k = 0; k < WIDTH; k++)
+        {
+            unsigned int ray = r + k;
+            if ((exact & (1u << k)) &&
+                IntersectOne(PreparedRay(glm::vec3(packet.ox[ray], packet.oy[ray], packet.oz[ray]), glm::vec3(packet.dx[ray], packet.dy[ray], packet.dz[ray])),
+                             j, ts[k], us[k], vs[k]) &&
+                ts[k] < packet.tMax[ray])
+                hits |= 1u << k;
+            if ((hits & (1u << k)) && onHit(ray, j, ts[k], us[k], vs[k]))
+                mask &= ~(1u << ray);
+        }
+    }
+#endif
+
+    void bind(const float* data)
+    {
+        size_t stride = Stride();
+#if defined(TRIANGLE_SOA_WATERTIGHT)
+        const float** arrays[] = { &v0x, &v0y, &v0z, &v1x, &v1y, &v1z, &v2x, &v2y, &v2z };
+#else
+        const float** arrays[] = { &v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z };
+#endif
+        for (int i = 0; i < 9; i++)
+            *arrays[i] = data ? data + stride * i : NULL;
+    }
+};
+#endif